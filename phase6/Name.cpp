@@ -0,0 +1,358 @@
+/*
+ * File:	Name.cpp
+ *
+ * Description:	This file contains the member function definitions for
+ *		names in Simple C, along with the interning table itself.
+ *
+ *		The table is an open-addressing hash table of identifiers,
+ *		probed linearly and kept at most half full.  The spellings
+ *		live in chunks that are never moved or freed, so references
+ *		to them stay valid.  Identifier zero is reserved for the
+ *		empty string and is never entered into the hash table
+ *		itself, so a zero slot means an empty slot.
+ *
+ *		Names may be created and read on several threads at once.
+ *		Looking up a name that is already in the table takes no
+ *		lock, and only entering a new one does.  A new name has its
+ *		entry, and its chunk if it starts one, filled in before its
+ *		identifier is stored into its slot with release ordering,
+ *		so a thread that finds the identifier with an acquire load
+ *		also sees its spelling.  Growing the table makes a new array
+ *		of slots and publishes it the same way, and since a thread
+ *		may still be probing an older one, those are kept rather
+ *		than freed, which at most doubles the space for slots.  A
+ *		lookup that misses in an old array takes the lock and looks
+ *		again before entering the name.  Reading the spelling of a
+ *		name is not locked either, since its chunk was filled in
+ *		before the name could have been handed to any other thread,
+ *		and the array of chunks is allocated in full and never
+ *		grows.  Nor does the table ever shrink, so a long-running
+ *		server keeps every name it has seen, and once the chunks run
+ *		out, a new spelling is given the empty name instead of being
+ *		entered.
+ *
+ *		The table is reached through a function, rather than being
+ *		a global variable, since names are created during static
+ *		initialization in other files.
+ */
+
+# include <mutex>
+# include <atomic>
+# include <memory>
+# include <vector>
+# include "Name.h"
+
+using namespace std;
+
+struct Entry {
+    string text;
+    unsigned hash;
+};
+
+struct Slots {
+    unsigned mask;
+    unique_ptr<atomic<unsigned>[]> ids;
+
+    Slots(unsigned size) : mask(size - 1), ids(new atomic<unsigned>[size]()) {}
+};
+
+static const unsigned CHUNK_BITS = 10;
+static const unsigned CHUNK_SIZE = 1 << CHUNK_BITS;
+static const unsigned MAX_CHUNKS = 1 << 16;
+
+struct Table {
+    Entry *chunks[MAX_CHUNKS];
+    unsigned size;
+    atomic<Slots *> slots;
+    vector<unique_ptr<Slots>> arrays;
+    mutex lock;
+
+    /* The table is only ever static, so the array of chunks starts out
+       zero without being cleared here, and most of its pages are never
+       touched at all. */
+
+    Table() : size(1) {
+	chunks[0] = new Entry[CHUNK_SIZE];
+	chunks[0][0] = Entry {"", Name::basis};
+	arrays.emplace_back(new Slots(1024));
+	slots.store(arrays.back().get());
+    }
+
+    Entry &operator [](unsigned id) {
+	return chunks[id >> CHUNK_BITS][id & (CHUNK_SIZE - 1)];
+    }
+};
+
+
+/*
+ * Function:	table (private)
+ *
+ * Description:	Return the interning table, creating it on first use.
+ */
+
+static Table &table()
+{
+    static Table table;
+
+    return table;
+}
+
+
+/*
+ * Function:	probe (private)
+ *
+ * Description:	Look for the given spelling, which has the given hash, in
+ *		an array of slots.  Return its identifier, or zero if it is
+ *		not there, in which case the slot is the empty one where it
+ *		would go.
+ */
+
+static unsigned probe(Table &t, const Slots &s, string_view text, unsigned hash, unsigned &slot)
+{
+    unsigned id;
+
+
+    for (slot = hash & s.mask; (id = s.ids[slot].load(memory_order_acquire)) != 0; slot = (slot + 1) & s.mask)
+	if (t[id].hash == hash && t[id].text == text)
+	    return id;
+
+    return 0;
+}
+
+
+/*
+ * Function:	grow (private)
+ *
+ * Description:	Publish an array of twice as many slots with every
+ *		identifier reinserted using its saved hash.  The old array
+ *		is kept for any thread still probing it.
+ */
+
+static void grow(Table &t)
+{
+    Slots *s = new Slots(2 * (t.slots.load(memory_order_relaxed)->mask + 1));
+    unsigned i;
+
+
+    for (unsigned id = 1; id < t.size; id ++) {
+	for (i = t[id].hash & s->mask; s->ids[i].load(memory_order_relaxed) != 0; i = (i + 1) & s->mask)
+	    continue;
+
+	s->ids[i].store(id, memory_order_relaxed);
+    }
+
+    t.arrays.emplace_back(s);
+    t.slots.store(s, memory_order_release);
+}
+
+
+/*
+ * Function:	intern (private)
+ *
+ * Description:	Return the identifier of the given spelling, which has the
+ *		given hash, entering it into the table if necessary.  If
+ *		the table is full, return the identifier of the empty name.
+ */
+
+static unsigned intern(string_view s, unsigned hash)
+{
+    Table &t = table();
+    Slots *slots;
+    unsigned i, id;
+
+
+    if (s.empty())
+	return 0;
+
+    if ((id = probe(t, *t.slots.load(memory_order_acquire), s, hash, i)) != 0)
+	return id;
+
+    lock_guard<mutex> guard(t.lock);
+    slots = t.slots.load(memory_order_relaxed);
+
+    if ((id = probe(t, *slots, s, hash, i)) != 0)
+	return id;
+
+    id = t.size;
+
+    if ((id & (CHUNK_SIZE - 1)) == 0) {
+	if ((id >> CHUNK_BITS) >= MAX_CHUNKS)
+	    return 0;
+
+	t.chunks[id >> CHUNK_BITS] = new Entry[CHUNK_SIZE];
+    }
+
+    t.size ++;
+    t[id] = Entry {string(s), hash};
+    slots->ids[i].store(id, memory_order_release);
+
+    if (t.size * 2 > slots->mask + 1)
+	grow(t);
+
+    return id;
+}
+
+
+/*
+ * Function:	Name::hashOf
+ *
+ * Description:	Return the hash of the given spelling.
+ */
+
+unsigned Name::hashOf(string_view s)
+{
+    unsigned hash = basis;
+
+    for (auto c : s)
+	hash = mix(hash, c);
+
+    return hash;
+}
+
+
+/*
+ * Function:	Name::Name (constructor)
+ *
+ * Description:	Initialize this name to the empty string.
+ */
+
+Name::Name()
+    : _id(0)
+{
+}
+
+
+/*
+ * Function:	Name::Name (constructor)
+ *
+ * Description:	Initialize this name, interning the spelling if necessary.
+ */
+
+Name::Name(const char *s)
+    : _id(intern(s, hashOf(s)))
+{
+}
+
+Name::Name(const string &s)
+    : _id(intern(s, hashOf(s)))
+{
+}
+
+Name::Name(string_view s)
+    : _id(intern(s, hashOf(s)))
+{
+}
+
+
+/*
+ * Function:	Name::Name (constructor)
+ *
+ * Description:	Initialize this name, whose hash has already been computed
+ *		by the caller.
+ */
+
+Name::Name(string_view s, unsigned hash)
+    : _id(intern(s, hash))
+{
+}
+
+
+/*
+ * Function:	Name::operator ==
+ *
+ * Description:	Check if two names are equal.
+ */
+
+bool Name::operator ==(const Name &rhs) const
+{
+    return _id == rhs._id;
+}
+
+
+/*
+ * Function:	Name::operator !=
+ *
+ * Description:	Check if two names are not equal.
+ */
+
+bool Name::operator !=(const Name &rhs) const
+{
+    return _id != rhs._id;
+}
+
+
+/*
+ * Function:	Name::operator <
+ *
+ * Description:	Order two names by when they were first interned, which is
+ *		not alphabetical but is the same from run to run.
+ */
+
+bool Name::operator <(const Name &rhs) const
+{
+    return _id < rhs._id;
+}
+
+
+/*
+ * Function:	Name::id (accessor)
+ *
+ * Description:	Return the identifier of this name.
+ */
+
+unsigned Name::id() const
+{
+    return _id;
+}
+
+
+/*
+ * Function:	Name::hash (accessor)
+ *
+ * Description:	Return the hash of this name.
+ */
+
+unsigned Name::hash() const
+{
+    return table()[_id].hash;
+}
+
+
+/*
+ * Function:	Name::str (accessor)
+ *
+ * Description:	Return the spelling of this name.
+ */
+
+const string &Name::str() const
+{
+    return table()[_id].text;
+}
+
+
+/*
+ * Function:	Name::count
+ *
+ * Description:	Return the number of distinct names, including the empty
+ *		name.
+ */
+
+unsigned Name::count()
+{
+    Table &t = table();
+    lock_guard<mutex> guard(t.lock);
+
+    return t.size;
+}
+
+
+/*
+ * Function:	operator <<
+ *
+ * Description:	Write the spelling of a name to the specified stream.
+ */
+
+ostream &operator <<(ostream &ostr, const Name &name)
+{
+    return ostr << name.str();
+}
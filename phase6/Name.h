@@ -0,0 +1,73 @@
+/*
+ * File:	Name.h
+ *
+ * Description:	This file contains the class definition for names in
+ *		Simple C.  A name is an interned string: every distinct
+ *		spelling is entered once into a global table and is given a
+ *		small integer identifier, which is all that a name holds.
+ *		Two names are therefore equal exactly when their
+ *		identifiers are, and comparing them costs one integer
+ *		comparison no matter how long the spelling is.
+ *
+ *		The hash of each spelling is kept in the table alongside
+ *		it.  The lexer computes the hash of an identifier as it
+ *		scans the characters, using the same mix() function, so
+ *		interning an identifier never reads it twice.
+ *
+ *		Names are never removed from the table, so the spelling
+ *		returned by str() remains valid for the life of the
+ *		program.  The default name is the empty string, which is
+ *		also what any other spelling becomes once the table is
+ *		full, so whoever makes names from a unit can check for it
+ *		and report it as an error in that unit.
+ */
+
+# ifndef NAME_H
+# define NAME_H
+# include <string>
+# include <ostream>
+# include <string_view>
+
+class Name {
+    typedef std::string string;
+    typedef std::string_view string_view;
+
+    unsigned _id;
+
+public:
+    static const unsigned basis = 2166136261u;
+
+    static unsigned mix(unsigned hash, char c) {
+	return (hash ^ (unsigned char) c) * 16777619u;
+    }
+
+    static unsigned hashOf(string_view s);
+
+    Name();
+    Name(const char *s);
+    Name(const string &s);
+    Name(string_view s);
+    Name(string_view s, unsigned hash);
+
+    bool operator ==(const Name &rhs) const;
+    bool operator !=(const Name &rhs) const;
+    bool operator <(const Name &rhs) const;
+
+    unsigned id() const;
+    unsigned hash() const;
+    const string &str() const;
+
+    static unsigned count();
+};
+
+std::ostream &operator <<(std::ostream &ostr, const Name &name);
+
+namespace std {
+    template<> struct hash<Name> {
+	size_t operator ()(const Name &name) const {
+	    return name.hash();
+	}
+    };
+}
+
+# endif /* NAME_H */
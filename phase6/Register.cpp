@@ -16,8 +16,8 @@ using namespace std;
  * Description:	Initialize this register with its correct operand names.
  */
 
-Register::Register(const string &name, const string &byte)
-    : _name(name), _byte(byte), _node(nullptr)
+Register::Register(const string &name, const string &byte, int number)
+    : _name(name), _byte(byte), _number(number), _node(nullptr)
 {
 }
 
@@ -43,6 +43,17 @@ const string &Register::byte() const
     return _byte;
 }
 
+/*
+ * Function:	Register::number (accessor)
+ *
+ * Description:	Return the number of this register in the assembly code.
+ */
+
+int Register::number() const
+{
+    return _number;
+}
+
 /*
  * Function:	operator <<
  *
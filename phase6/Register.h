@@ -3,7 +3,8 @@
  *
  * Description:	This file contains the class definition for registers on
  *		the Intel 32-bit processor.  Each integer register has two
- *		operand names depending upon the access size.
+ *		operand names depending upon the access size, and a number
+ *		by which the assembly code refers to it.
  */
 
 #ifndef REGISTER_H
@@ -16,14 +17,16 @@ class Register
     typedef std::string string;
     string _name;
     string _byte;
+    int _number;
 
 public:
     class Expression *_node;
 
-    Register(const string &name, const string &byte = "");
+    Register(const string &name, const string &byte, int number);
 
     const string &name(unsigned size = 0) const;
     const string &byte() const;
+    int number() const;
 };
 
 std::ostream &operator<<(std::ostream &ostr, const Register *reg);
@@ -11,11 +11,15 @@
  *
  *		Extra functionality:
  *		- retrieving the vector of symbols
+ *		- hashed searching of large scopes
+ *		- replacing a symbol in place
  */
 
 # include <cassert>
 # include "Scope.h"
 
+static const unsigned LINEAR_LIMIT = 8;
+
 
 /*
  * Function:	Scope::Scope (constructor)
@@ -29,6 +33,59 @@ Scope::Scope(Scope *enclosing)
 }
 
 
+/*
+ * Function:	Scope::slot (private)
+ *
+ * Description:	Return the slot in the hash table holding the symbol with
+ *		the given name, or else the empty slot where it would go.
+ *		Each slot holds one more than the index of its symbol, so
+ *		that zero means empty.
+ */
+
+unsigned Scope::slot(const Name &name) const
+{
+    unsigned mask = _slots.size() - 1;
+    unsigned i = name.hash() & mask;
+
+
+    while (_slots[i] != 0 && _symbols[_slots[i] - 1]->name() != name)
+	i = (i + 1) & mask;
+
+    return i;
+}
+
+
+/*
+ * Function:	Scope::rehash (private)
+ *
+ * Description:	Rebuild the hash table from the list of symbols, with at
+ *		least four slots for every symbol, so that it starts out no
+ *		more than a quarter full.  Inserting rebuilds it again once
+ *		it would be more than half full, so a search never probes
+ *		a table fuller than that.  A scope that is small enough to
+ *		search linearly has no table at all.
+ */
+
+void Scope::rehash()
+{
+    unsigned size = 16;
+
+
+    _slots.clear();
+
+    if (_symbols.size() <= LINEAR_LIMIT)
+	return;
+
+    while (size < 4 * _symbols.size())
+	size *= 2;
+
+    _slots.resize(size, 0);
+
+    for (unsigned i = 0; i < _symbols.size(); i ++)
+	_slots[slot(_symbols[i]->name())] = i + 1;
+}
+
+
 /*
  * Function:	Scope::insert
  *
@@ -41,6 +98,42 @@ void Scope::insert(Symbol *symbol)
 {
     assert(find(symbol->name()) == nullptr);
     _symbols.push_back(symbol);
+
+    if (_slots.size() < 2 * _symbols.size())
+	rehash();
+    else
+	_slots[slot(symbol->name())] = _symbols.size();
+}
+
+
+/*
+ * Function:	Scope::replace
+ *
+ * Description:	Replace the symbol with the same name as the given symbol,
+ *		keeping its place in the list, or insert the given symbol
+ *		if there is none.
+ */
+
+void Scope::replace(Symbol *symbol)
+{
+    unsigned i;
+
+
+    if (!_slots.empty()) {
+	if ((i = _slots[slot(symbol->name())]) != 0) {
+	    _symbols[i - 1] = symbol;
+	    return;
+	}
+
+    } else {
+	for (auto &old : _symbols)
+	    if (old->name() == symbol->name()) {
+		old = symbol;
+		return;
+	    }
+    }
+
+    insert(symbol);
 }
 
 
@@ -51,13 +144,21 @@ void Scope::insert(Symbol *symbol)
  *		scope.  If no such symbol is found, return a null pointer.
  */
 
-Symbol *Scope::find(const string &name) const
+Symbol *Scope::find(const Name &name) const
 {
-    for (auto symbol : _symbols)
-	if (name == symbol->name())
-	    return symbol;
+    unsigned i;
 
-    return nullptr;
+
+    if (_slots.empty()) {
+	for (auto symbol : _symbols)
+	    if (name == symbol->name())
+		return symbol;
+
+	return nullptr;
+    }
+
+    i = _slots[slot(name)];
+    return i != 0 ? _symbols[i - 1] : nullptr;
 }
 
 
@@ -65,14 +166,16 @@ Symbol *Scope::find(const string &name) const
  * Function:	Scope::remove
  *
  * Description:	Remove the symbol with the given name from this scope.
- *		And, yes, I didn't use an iterator.  So sue me.
+ *		Since this shifts the later symbols down, the hash table
+ *		has to be rebuilt, so use replace() where possible.
  */
 
-void Scope::remove(const string &name)
+void Scope::remove(const Name &name)
 {
     for (unsigned i = 0; i < _symbols.size(); i ++)
 	if (name == _symbols[i]->name()) {
 	    _symbols.erase(_symbols.begin() + i);
+	    rehash();
 	    break;
 	}
 }
@@ -87,15 +190,16 @@ void Scope::remove(const string &name)
  *		null pointer.
  */
 
-Symbol *Scope::lookup(const string &name) const
+Symbol *Scope::lookup(const Name &name) const
 {
     Symbol *symbol;
 
 
-    if ((symbol = find(name)) != nullptr)
-	return symbol;
+    for (const Scope *scope = this; scope != nullptr; scope = scope->_enclosing)
+	if ((symbol = scope->find(name)) != nullptr)
+	    return symbol;
 
-    return _enclosing != nullptr ? _enclosing->lookup(name) : nullptr;
+    return nullptr;
 }
 
 
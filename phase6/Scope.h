@@ -2,10 +2,15 @@
  * File:	Scope.h
  *
  * Description:	This file contains the class definition for scopes in
- *		Simple C.  A scope consists simply of a list of symbols.
- *		We use a vector rather than a map because we want to keep
- *		the symbols in insertion order, and we expect the number of
- *		symbols inserted to be small.
+ *		Simple C.  A scope consists of a list of symbols, kept in a
+ *		vector because we want the symbols in insertion order.
+ *
+ *		Most scopes are small and are simply searched linearly.
+ *		Once a scope grows past a few symbols, however, it also
+ *		gets an open-addressing hash table of indices into the
+ *		vector, keyed on the hash of each name.  The outermost
+ *		scope of a large file can hold many thousands of symbols,
+ *		so this keeps each search constant time.
  *
  *		Each scope has a link to its enclosing scope.  By
  *		convention, a null scope is used if there is no enclosing
@@ -18,22 +23,26 @@
 # define SCOPE_H
 # include "Symbol.h"
 # include <vector>
+# include "arena.h"
 
 typedef std::vector<Symbol *> Symbols;
 
-class Scope {
-    typedef std::string string;
-
+class Scope : public Allocated<Scope> {
     Scope *_enclosing;
     Symbols _symbols;
+    std::vector<unsigned> _slots;
+
+    unsigned slot(const Name &name) const;
+    void rehash();
 
 public:
     Scope(Scope *enclosing = nullptr);
 
     void insert(Symbol *symbol);
-    void remove(const string &name);
-    Symbol *find(const string &name) const;
-    Symbol *lookup(const string &name) const;
+    void replace(Symbol *symbol);
+    void remove(const Name &name);
+    Symbol *find(const Name &name) const;
+    Symbol *lookup(const Name &name) const;
 
     Scope *enclosing() const;
     const Symbols &symbols() const;
@@ -2,25 +2,29 @@
  * File:	Symbol.h
  *
  * Description:	This file contains the class definition for symbols in
- *		Simple C.  At this point, a symbol merely consists of a
- *		name and a type, neither of which you can change.
+ *		Simple C.  A symbol consists of a name and a type, neither
+ *		of which you can change, and its storage: an offset in the
+ *		frame or a register.  A symbol whose address is taken must
+ *		live in memory.
  */
 
 # ifndef SYMBOL_H
 # define SYMBOL_H
-# include <string>
+# include "Name.h"
 # include "Type.h"
+# include "arena.h"
 
-class Symbol {
-    typedef std::string string;
-    string _name;
+class Symbol : public Allocated<Symbol> {
+    Name _name;
     Type _type;
 
 public:
     int _offset;
+    bool _addressed;
+    class Register *_register;
 
-    Symbol(const string &name, const Type &type);
-    const string &name() const;
+    Symbol(const Name &name, const Type &type);
+    const Name &name() const;
     const Type &type() const;
 };
 
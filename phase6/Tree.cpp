@@ -33,7 +33,7 @@ using namespace std;
  */
 
 Expression::Expression(const Type &type)
-    : _type(type), _lvalue(false), _offset(0), _hasCall(false), _register(nullptr)
+    : _type(type), _lvalue(false), _offset(0), _hasCall(false), _size(1), _register(nullptr)
 {
 }
 
@@ -70,6 +70,7 @@ Binary::Binary(Expression *left, Expression *right, const Type &type)
     : Expression(type), _left(left), _right(right)
 {
     _hasCall = left->_hasCall | right->_hasCall;
+    _size = 1 + left->_size + right->_size;
 }
 
 /*
@@ -83,6 +84,7 @@ Unary::Unary(Expression *expr, const Type &type)
     : Expression(type), _expr(expr)
 {
     _hasCall = expr->_hasCall;
+    _size = 1 + expr->_size;
 }
 
 /*
@@ -91,8 +93,8 @@ Unary::Unary(Expression *expr, const Type &type)
  * Description:	Initialize this string literal.
  */
 
-String::String(const string &value)
-    : Expression(Array("char", 0, value.size() + 1)), _value(value)
+String::String(const Name &value)
+    : Expression(Array("char", 0, value.str().size() + 1)), _value(value)
 {
 }
 
@@ -102,7 +104,7 @@ String::String(const string &value)
  * Description:	Return the value of this string.
  */
 
-const string &String::value() const
+const Name &String::value() const
 {
     return _value;
 }
@@ -114,7 +116,7 @@ const string &String::value() const
  *		lvalue if its type is a scalar type or a callback type.
  */
 
-Identifier::Identifier(const Symbol *symbol)
+Identifier::Identifier(Symbol *symbol)
     : Expression(symbol->type()), _symbol(symbol)
 {
     _lvalue = symbol->type().isScalar() || _symbol->type().isCallback();
@@ -190,6 +192,7 @@ Field::Field(Expression *expr, Symbol *id, const Type &type)
     : Expression(type), _expr(expr), _id(id)
 {
     _lvalue = expr->lvalue() && !id->type().isArray();
+    _size = 1 + expr->_size;
 }
 
 /*
@@ -536,6 +539,29 @@ bool Dereference::isDereference(Expression *&pointer) const
     return true;
 }
 
+/*
+ * Function:	Expression::isIdentifier (accessor)
+ *
+ * Description:	Return false since most expressions are not identifiers.
+ */
+
+bool Expression::isIdentifier(Symbol *&symbol) const
+{
+    return false;
+}
+
+/*
+ * Function:	Identifier::isIdentifier (accessor)
+ *
+ * Description:	Return true since an identifier is in fact an identifier.
+ */
+
+bool Identifier::isIdentifier(Symbol *&symbol) const
+{
+    symbol = _symbol;
+    return true;
+}
+
 /*
  * Function:	Expression::isField (accessor)
  *
@@ -555,9 +581,130 @@ bool Expression::isField(Expression *&structure, int &offset) const
 
 bool Field::isField(Expression *&structure, int &offset) const
 {
-    _expr->type().size(); /* computing the size assigns field offsets */
-
     structure = _expr;
     offset = _id->_offset;
     return true;
 }
+
+/*
+ * Function:	Expression::isAddress (accessor)
+ *
+ * Description:	Return false since most expressions are not addresses.
+ */
+
+bool Expression::isAddress(Expression *&expr) const
+{
+    return false;
+}
+
+/*
+ * Function:	Address::isAddress (accessor)
+ *
+ * Description:	Return true since an address is in fact an address.
+ */
+
+bool Address::isAddress(Expression *&expr) const
+{
+    expr = _expr;
+    return true;
+}
+
+/*
+ * Function:	Expression::isAdd (accessor)
+ *
+ * Description:	Return false since most expressions are not additions.
+ */
+
+bool Expression::isAdd(Expression *&left, Expression *&right) const
+{
+    return false;
+}
+
+/*
+ * Function:	Add::isAdd (accessor)
+ *
+ * Description:	Return true since an addition is in fact an addition.
+ */
+
+bool Add::isAdd(Expression *&left, Expression *&right) const
+{
+    left = _left;
+    right = _right;
+    return true;
+}
+
+/*
+ * Function:	Expression::isMultiply (accessor)
+ *
+ * Description:	Return false since most expressions are not
+ *		multiplications.
+ */
+
+bool Expression::isMultiply(Expression *&left, Expression *&right) const
+{
+    return false;
+}
+
+/*
+ * Function:	Multiply::isMultiply (accessor)
+ *
+ * Description:	Return true since a multiplication is in fact a
+ *		multiplication.
+ */
+
+bool Multiply::isMultiply(Expression *&left, Expression *&right) const
+{
+    left = _left;
+    right = _right;
+    return true;
+}
+
+/*
+ * Function:	Expression::isNot (accessor)
+ *
+ * Description:	Return false since most expressions are not logical
+ *		negations.
+ */
+
+bool Expression::isNot(Expression *&expr) const
+{
+    return false;
+}
+
+/*
+ * Function:	Not::isNot (accessor)
+ *
+ * Description:	Return true since a logical negation is in fact a logical
+ *		negation.
+ */
+
+bool Not::isNot(Expression *&expr) const
+{
+    expr = _expr;
+    return true;
+}
+
+/*
+ * Function:	Expression::isNegate (accessor)
+ *
+ * Description:	Return false since most expressions are not arithmetic
+ *		negations.
+ */
+
+bool Expression::isNegate(Expression *&expr) const
+{
+    return false;
+}
+
+/*
+ * Function:	Negate::isNegate (accessor)
+ *
+ * Description:	Return true since an arithmetic negation is in fact an
+ *		arithmetic negation.
+ */
+
+bool Negate::isNegate(Expression *&expr) const
+{
+    expr = _expr;
+    return true;
+}
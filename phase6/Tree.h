@@ -6,7 +6,8 @@
  *
  *		The base class Node cannot not be instantiated (the
  *		constructor is protected).  It provides empty functions
- *		for storage allocation and code generation.
+ *		for storage allocation and code generation.  Nodes are
+ *		allocated in the current arena and are never deleted.
  *
  *		A Node is either a Procedure, representing a function
  *		definition, a Statement, or an Expression, which also
@@ -22,6 +23,7 @@
  *		Tree.cpp - constructors and accessors
  *		allocator.cpp - member functions to do storage allocation
  *		generator.cpp - member functions to do code generation
+ *		lower.cpp - member functions to lower to the SSA form
  *		writer.cpp - member functions to write the tree to a stream
  */
 
@@ -33,13 +35,15 @@
 #include "Scope.h"
 #include "Register.h"
 #include "label.h"
+#include "arena.h"
+#include "assembly.h"
 
 typedef std::vector<class Statement *> Statements;
 typedef std::vector<class Expression *> Expressions;
 
 /* The base class */
 
-class Node
+class Node : public Allocated<Node>
 {
 protected:
     typedef std::string string;
@@ -51,6 +55,7 @@ public:
     virtual void write(ostream &ostr) const = 0;
     virtual void allocate(int &offset) const {}
     virtual void generate() {}
+    virtual void lower() {}
 };
 
 /* Any type of statement: return, while, if, block, and expression */
@@ -73,16 +78,25 @@ protected:
 public:
     int _offset;
     bool _hasCall;
+    unsigned _size;
     Register *_register;
 
     const Type &type() const;
     bool lvalue() const;
 
-    virtual void operand(ostream &ostr) const;
+    virtual Operand operand() const;
     virtual bool isNumber(unsigned &value) const;
     virtual bool isDereference(Expression *&pointer) const;
     virtual bool isField(Expression *&structure, int &offset) const;
+    virtual bool isIdentifier(Symbol *&symbol) const;
+    virtual bool isAddress(Expression *&expr) const;
+    virtual bool isAdd(Expression *&left, Expression *&right) const;
+    virtual bool isMultiply(Expression *&left, Expression *&right) const;
+    virtual bool isNot(Expression *&expr) const;
+    virtual bool isNegate(Expression *&expr) const;
     virtual void test(const Label &label, bool ifTrue);
+    virtual int evaluate();
+    virtual void condition(int ifTrue, int ifFalse);
 };
 
 /* A binary operator */
@@ -107,26 +121,28 @@ protected:
 
 class String : public Expression
 {
-    string _value;
+    Name _value;
 
 public:
-    String(const string &value);
-    const string &value() const;
+    String(const Name &value);
+    const Name &value() const;
     virtual void write(ostream &ostr) const;
-    virtual void operand(ostream &ostr) const;
+    virtual Operand operand() const;
 };
 
 /* An identifier expression */
 
 class Identifier : public Expression
 {
-    const Symbol *_symbol;
+    Symbol *_symbol;
 
 public:
-    Identifier(const Symbol *symbol);
+    Identifier(Symbol *symbol);
     const Symbol *symbol() const;
     virtual void write(ostream &ostr) const;
-    virtual void operand(ostream &ostr) const;
+    virtual Operand operand() const;
+    virtual bool isIdentifier(Symbol *&symbol) const;
+    virtual int evaluate();
 };
 
 /* An number (i.e., integer literal) */
@@ -140,8 +156,9 @@ public:
     Number(const string &value);
     const string &value() const;
     virtual void write(ostream &ostr) const;
-    virtual void operand(ostream &ostr) const;
+    virtual Operand operand() const;
     virtual bool isNumber(unsigned &value) const;
+    virtual int evaluate();
 };
 
 /* A function call expression: expr ( args ) */
@@ -155,6 +172,7 @@ public:
     Call(Expression *expr, const Expressions &args, const Type &type);
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual int evaluate();
 };
 
 /* A logical negation expression: ! expr */
@@ -163,8 +181,12 @@ class Not : public Unary
 {
 public:
     Not(Expression *expr, const Type &type);
+    virtual bool isNot(Expression *&expr) const;
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual void test(const Label &label, bool ifTrue);
+    virtual int evaluate();
+    virtual void condition(int ifTrue, int ifFalse);
 };
 
 /* A field reference: expr . id */
@@ -187,8 +209,10 @@ class Negate : public Unary
 {
 public:
     Negate(Expression *expr, const Type &type);
+    virtual bool isNegate(Expression *&expr) const;
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual int evaluate();
 };
 
 /* A dereference expression: * expr */
@@ -208,8 +232,10 @@ class Address : public Unary
 {
 public:
     Address(Expression *expr, const Type &type);
+    virtual bool isAddress(Expression *&expr) const;
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual int evaluate();
 };
 
 /* A cast expression: (type) expr */
@@ -220,6 +246,7 @@ public:
     Cast(Expression *expr, const Type &type);
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual int evaluate();
 };
 
 /* A multiply expression: left * right */
@@ -228,8 +255,10 @@ class Multiply : public Binary
 {
 public:
     Multiply(Expression *left, Expression *right, const Type &type);
+    virtual bool isMultiply(Expression *&left, Expression *&right) const;
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual int evaluate();
 };
 
 /* A divide expression: left / right */
@@ -240,6 +269,7 @@ public:
     Divide(Expression *left, Expression *right, const Type &type);
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual int evaluate();
 };
 
 /* A remainder expression: left % right */
@@ -250,6 +280,7 @@ public:
     Remainder(Expression *left, Expression *right, const Type &type);
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual int evaluate();
 };
 
 /* An addition expression: left + right */
@@ -258,8 +289,10 @@ class Add : public Binary
 {
 public:
     Add(Expression *left, Expression *right, const Type &type);
+    virtual bool isAdd(Expression *&left, Expression *&right) const;
     virtual void write(ostream &ostr) const;
     virtual void generate() override;
+    virtual int evaluate();
 };
 
 /* A subtraction expression: left - right */
@@ -270,6 +303,7 @@ public:
     Subtract(Expression *left, Expression *right, const Type &type);
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual int evaluate();
 };
 
 /* A less-than expression: left < right */
@@ -281,6 +315,7 @@ public:
     virtual void write(ostream &ostr) const;
     virtual void generate();
     virtual void test(const Label &label, bool ifTrue);
+    virtual int evaluate();
 };
 
 /* A greater-than expression: left > right */
@@ -291,6 +326,8 @@ public:
     GreaterThan(Expression *left, Expression *right, const Type &type);
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual void test(const Label &label, bool ifTrue);
+    virtual int evaluate();
 };
 
 /* A less-than-or-equal expression: left <= right */
@@ -301,6 +338,8 @@ public:
     LessOrEqual(Expression *left, Expression *right, const Type &type);
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual void test(const Label &label, bool ifTrue);
+    virtual int evaluate();
 };
 
 /* A greater-than-or-equal expression: left >= right */
@@ -311,6 +350,8 @@ public:
     GreaterOrEqual(Expression *left, Expression *right, const Type &type);
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual void test(const Label &label, bool ifTrue);
+    virtual int evaluate();
 };
 
 /* An equality expression: left == right */
@@ -321,6 +362,8 @@ public:
     Equal(Expression *left, Expression *right, const Type &type);
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual void test(const Label &label, bool ifTrue);
+    virtual int evaluate();
 };
 
 /* An inequality expression: left != right */
@@ -331,6 +374,8 @@ public:
     NotEqual(Expression *left, Expression *right, const Type &type);
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual void test(const Label &label, bool ifTrue);
+    virtual int evaluate();
 };
 
 /* A logical-and expression: left && right */
@@ -341,6 +386,9 @@ public:
     LogicalAnd(Expression *left, Expression *right, const Type &type);
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual void test(const Label &label, bool ifTrue);
+    virtual int evaluate();
+    virtual void condition(int ifTrue, int ifFalse);
 };
 
 /* A logical-or expression: left || right */
@@ -351,6 +399,9 @@ public:
     LogicalOr(Expression *left, Expression *right, const Type &type);
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual void test(const Label &label, bool ifTrue);
+    virtual int evaluate();
+    virtual void condition(int ifTrue, int ifFalse);
 };
 
 /* An assignment statement: left = right */
@@ -363,6 +414,7 @@ public:
     Assignment(Expression *left, Expression *right);
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual void lower();
 };
 
 /* A return statement: return expr */
@@ -375,6 +427,7 @@ public:
     Return(Expression *expr);
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual void lower();
 };
 
 /* A block (compound) statement: { decls stmts } */
@@ -390,6 +443,7 @@ public:
     virtual void write(ostream &ostr) const;
     virtual void allocate(int &offset) const;
     virtual void generate();
+    virtual void lower();
 };
 
 /* A while statement: while ( expr ) stmt */
@@ -404,6 +458,7 @@ public:
     virtual void write(ostream &ostr) const;
     virtual void allocate(int &offset) const;
     virtual void generate();
+    virtual void lower();
 };
 
 /* A for statement: for ( init ; expr ; incr ) stmt */
@@ -420,6 +475,7 @@ public:
     virtual void write(ostream &ostr) const;
     virtual void allocate(int &offset) const;
     virtual void generate();
+    virtual void lower();
 };
 
 /* An if-then or if-then-else statement: if ( expr ) thenStmt else elseStmt */
@@ -434,6 +490,7 @@ public:
     virtual void write(ostream &ostr) const;
     virtual void allocate(int &offset) const;
     virtual void generate();
+    virtual void lower();
 };
 
 /* A simple (expression) statement */
@@ -446,6 +503,7 @@ public:
     Simple(Expression *expr);
     virtual void write(ostream &ostr) const;
     virtual void generate();
+    virtual void lower();
 };
 
 /* A function definition: id() { body } */
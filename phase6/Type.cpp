@@ -17,14 +17,100 @@
  *		- predicate functions such as isArray()
  *		- stream operator
  *		- the error type
+ *		- the type and parameter list tables
  */
 
+# include <deque>
+# include <mutex>
 # include <cassert>
+# include <unordered_set>
 # include "Type.h"
 
 using namespace std;
 
 
+/* The tables of types and parameter lists.  The entries live in deques,
+   which never move their elements, so pointers to them remain valid.
+   Since the types in a parameter list are themselves entered in the
+   table, two lists are equal exactly when their entries are.  Each
+   thread keeps its own sets of the entries and lists it has found, so
+   that only finding one for the first time on a thread takes the lock. */
+
+struct Type::Table {
+    struct Hash {
+	size_t operator ()(const Entry *entry) const {
+	    size_t hash = entry->specifier.hash();
+
+	    hash = hash * 31 + entry->kind;
+	    hash = hash * 31 + entry->indirection;
+	    hash = hash * 31 + entry->length;
+	    return hash * 31 + (size_t) entry->parameters;
+	}
+    };
+
+    struct Equal {
+	bool operator ()(const Entry *a, const Entry *b) const {
+	    return a->kind == b->kind && a->specifier == b->specifier
+		&& a->indirection == b->indirection
+		&& a->length == b->length && a->parameters == b->parameters;
+	}
+    };
+
+    struct ListHash {
+	size_t operator ()(const Parameters *params) const {
+	    size_t hash = params->size();
+
+	    for (auto &type : *params)
+		hash = hash * 31 + (size_t) type._entry;
+
+	    return hash;
+	}
+    };
+
+    struct ListEqual {
+	bool operator ()(const Parameters *a, const Parameters *b) const {
+	    if (a->size() != b->size())
+		return false;
+
+	    for (unsigned i = 0; i < a->size(); i ++)
+		if ((*a)[i]._entry != (*b)[i]._entry)
+		    return false;
+
+	    return true;
+	}
+    };
+
+    struct Sets {
+	unordered_set<const Entry *, Hash, Equal> types;
+	unordered_set<Parameters *, ListHash, ListEqual> parameters;
+    };
+
+    mutex lock;
+    deque<Entry> entries;
+    deque<Parameters> lists;
+    Sets sets;
+    Name integer, character;
+
+    Table() : integer("int"), character("char") {}
+};
+
+
+/*
+ * Function:	Type::table (private)
+ *
+ * Description:	Return the tables, creating them on first use.  Types are
+ *		created during static initialization in other files, so the
+ *		tables can't simply be global variables.
+ */
+
+Type::Table &Type::table()
+{
+    static Table table;
+
+    return table;
+}
+
+
 /*
  * Function:	Type::Type (constructor)
  *
@@ -32,56 +118,121 @@ using namespace std;
  */
 
 Type::Type()
-    : Type(ERROR, "-error-", 0)
 {
+    static const Type error(ERROR, "-error-", 0);
+
+    _entry = error._entry;
 }
 
 
 /*
  * Function:	Type::Type (constructor)
  *
- * Description:	Initialize this type object.
+ * Description:	Initialize this type object by finding its entry in the
+ *		table, or creating one.  The parameter list, if any, is
+ *		replaced by the equal list from its own table.  Either is
+ *		looked for first among those this thread has already found,
+ *		without taking the lock.
  */
 
-Type::Type(int kind, const string &specifier, unsigned indirection)
-    : _kind(kind), _specifier(specifier), _indirection(indirection)
+Type::Type(int kind, const Name &specifier, unsigned indirection,
+	unsigned length, Parameters *params)
+{
+    static thread_local Table::Sets found;
+    Table &t = table();
+    Entry key;
+
+
+    if (params != nullptr) {
+	auto list = found.parameters.find(params);
+
+	if (list == found.parameters.end()) {
+	    lock_guard<mutex> guard(t.lock);
+	    auto shared = t.sets.parameters.find(params);
+
+	    if (shared == t.sets.parameters.end()) {
+		t.lists.push_back(*params);
+		shared = t.sets.parameters.insert(&t.lists.back()).first;
+	    }
+
+	    list = found.parameters.insert(*shared).first;
+	}
+
+	params = *list;
+    }
+
+    key.kind = kind;
+    key.specifier = specifier;
+    key.indirection = indirection;
+    key.length = length;
+    key.parameters = params;
+
+    auto entry = found.types.find(&key);
+
+    if (entry == found.types.end()) {
+	lock_guard<mutex> guard(t.lock);
+	auto shared = t.sets.types.find(&key);
+
+	if (shared == t.sets.types.end()) {
+	    Entry &e = t.entries.emplace_back();
+
+	    e.kind = kind;
+	    e.specifier = specifier;
+	    e.indirection = indirection;
+	    e.length = length;
+	    e.parameters = params;
+	    e.structure = kind != ERROR && specifier != t.integer && specifier != t.character;
+	    e.promoted = e.deref = nullptr;
+	    e.size = e.alignment = 0;
+
+	    shared = t.sets.types.insert(&e).first;
+	}
+
+	entry = found.types.insert(*shared).first;
+    }
+
+    _entry = *entry;
+}
+
+
+/*
+ * Function:	Type::Type (constructor)
+ *
+ * Description:	Initialize this type object from an existing entry.
+ */
+
+Type::Type(const Entry *entry)
+    : _entry(entry)
 {
-    _parameters = nullptr;
 }
 
 
 /*
  * Function:	Type::operator ==
  *
- * Description:	Return whether another type is equal to this type.  The
- *		parameter lists are checked for function types, which C++
- *		makes so easy.  (At least, it makes something easy!)
+ * Description:	Return whether another type is equal to this type.  Equal
+ *		types share an entry, with one exception: an unspecified
+ *		parameter list is equal to any parameter list.
  */
 
 bool Type::operator ==(const Type &rhs) const
 {
-    if (_kind != rhs._kind)
-	return false;
-
-    if (_kind == ERROR)
+    if (_entry == rhs._entry)
 	return true;
 
-    if (_specifier != rhs._specifier)
+    if (_entry->kind != FUNCTION && _entry->kind != CALLBACK)
 	return false;
 
-    if (_indirection != rhs._indirection)
+    if (_entry->kind != rhs._entry->kind)
 	return false;
 
-    if (_kind == SCALAR)
-	return true;
-
-    if (_kind == ARRAY)
-	return _length == rhs._length;
+    if (_entry->specifier != rhs._entry->specifier)
+	return false;
 
-    if (!_parameters || !rhs._parameters)
-	return true;
+    if (_entry->indirection != rhs._entry->indirection)
+	return false;
 
-    return *_parameters == *rhs._parameters;
+    return !_entry->parameters || !rhs._entry->parameters;
 }
 
 
@@ -107,7 +258,7 @@ bool Type::operator !=(const Type &rhs) const
 
 bool Type::isArray() const
 {
-    return _kind == ARRAY;
+    return _entry->kind == ARRAY;
 }
 
 
@@ -119,7 +270,7 @@ bool Type::isArray() const
 
 bool Type::isScalar() const
 {
-    return _kind == SCALAR;
+    return _entry->kind == SCALAR;
 }
 
 
@@ -131,7 +282,7 @@ bool Type::isScalar() const
 
 bool Type::isCallback() const
 {
-    return _kind == CALLBACK;
+    return _entry->kind == CALLBACK;
 }
 
 
@@ -143,7 +294,7 @@ bool Type::isCallback() const
 
 bool Type::isFunction() const
 {
-    return _kind == FUNCTION;
+    return _entry->kind == FUNCTION;
 }
 
 
@@ -155,7 +306,7 @@ bool Type::isFunction() const
 
 bool Type::isError() const
 {
-    return _kind == ERROR;
+    return _entry->kind == ERROR;
 }
 
 
@@ -165,9 +316,9 @@ bool Type::isError() const
  * Description:	Return the specifier of this type.
  */
 
-const string &Type::specifier() const
+const Name &Type::specifier() const
 {
-    return _specifier;
+    return _entry->specifier;
 }
 
 
@@ -179,7 +330,7 @@ const string &Type::specifier() const
 
 unsigned Type::indirection() const
 {
-    return _indirection;
+    return _entry->indirection;
 }
 
 
@@ -193,8 +344,8 @@ unsigned Type::indirection() const
 
 unsigned Type::length() const
 {
-    assert(_kind == ARRAY);
-    return _length;
+    assert(_entry->kind == ARRAY);
+    return _entry->length;
 }
 
 
@@ -207,8 +358,8 @@ unsigned Type::length() const
 
 Parameters *Type::parameters() const
 {
-    assert(_kind == FUNCTION || _kind == CALLBACK);
-    return _parameters;
+    assert(_entry->kind == FUNCTION || _entry->kind == CALLBACK);
+    return _entry->parameters;
 }
 
 
@@ -220,7 +371,7 @@ Parameters *Type::parameters() const
 
 bool Type::isStruct() const
 {
-    return _kind != ERROR && _specifier != "int" && _specifier != "char";
+    return _entry->structure;
 }
 
 
@@ -232,7 +383,7 @@ bool Type::isStruct() const
 
 bool Type::isValue() const
 {
-    return !(_kind == SCALAR && _indirection == 0 && isStruct());
+    return !(_entry->kind == SCALAR && _entry->indirection == 0 && isStruct());
 }
 
 
@@ -244,7 +395,7 @@ bool Type::isValue() const
 
 bool Type::isInteger() const
 {
-    return _kind == SCALAR && _indirection == 0 && !isStruct();
+    return _entry->kind == SCALAR && _entry->indirection == 0 && !isStruct();
 }
 
 
@@ -256,7 +407,7 @@ bool Type::isInteger() const
 
 bool Type::isPointer() const
 {
-    return (_kind == SCALAR && _indirection > 0) || _kind == ARRAY;
+    return (_entry->kind == SCALAR && _entry->indirection > 0) || _entry->kind == ARRAY;
 }
 
 
@@ -280,21 +431,29 @@ bool Type::isCompatibleWith(const Type &that) const
  * Description:	Return the result of performing type promotion on this
  *		type.  In Simple C, a characcter is promoted to an integer,
  *		an array is promoted to a pointer, and a function is
- *		promoted to a callback.
+ *		promoted to a callback.  The result is cached.
  */
 
 Type Type::promote() const
 {
-    if (_kind == FUNCTION)
-	return Callback(_specifier, _indirection);
+    const Entry *e = _entry;
+    Type t = *this;
 
-    if (_kind == ARRAY)
-	return Scalar(_specifier, _indirection + 1);
 
-    if (_kind == SCALAR && _indirection == 0 && _specifier == "char")
-	return Scalar("int");
+    if (e->promoted == nullptr) {
+	if (e->kind == FUNCTION)
+	    t = Callback(e->specifier, e->indirection);
 
-    return *this;
+	else if (e->kind == ARRAY)
+	    t = Scalar(e->specifier, e->indirection + 1);
+
+	else if (e->kind == SCALAR && e->indirection == 0 && e->specifier == table().character)
+	    t = Scalar(table().integer);
+
+	e->promoted = t._entry;
+    }
+
+    return Type(e->promoted);
 }
 
 
@@ -302,13 +461,19 @@ Type Type::promote() const
  * Function:	Type::deref
  *
  * Description:	Return the result of dereferencing this type, which must be
- *		a pointer type.
+ *		a pointer type.  The result is cached.
  */
 
 Type Type::deref() const
 {
-    assert(_kind == SCALAR && _indirection > 0);
-    return Scalar(_specifier, _indirection - 1);
+    assert(_entry->kind == SCALAR && _entry->indirection > 0);
+
+    if (_entry->deref == nullptr) {
+	Type t = Scalar(_entry->specifier, _entry->indirection - 1);
+	_entry->deref = t._entry;
+    }
+
+    return Type(_entry->deref);
 }
 
 
@@ -318,7 +483,7 @@ Type Type::deref() const
  * Description:	Initialize a scalar type object.
  */
 
-Scalar::Scalar(const string &specifier, unsigned indirection)
+Scalar::Scalar(const Name &specifier, unsigned indirection)
     : Type(SCALAR, specifier, indirection)
 {
 }
@@ -330,10 +495,9 @@ Scalar::Scalar(const string &specifier, unsigned indirection)
  * Description:	Initialize an array type object.
  */
 
-Array::Array(const string &specifier, unsigned indirection, unsigned length)
-    : Type(ARRAY, specifier, indirection)
+Array::Array(const Name &specifier, unsigned indirection, unsigned length)
+    : Type(ARRAY, specifier, indirection, length)
 {
-    _length = length;
 }
 
 
@@ -343,10 +507,9 @@ Array::Array(const string &specifier, unsigned indirection, unsigned length)
  * Description:	Initialize a function type object.
  */
 
-Function::Function(const string &specifier, unsigned indirection, Parameters *params)
-    : Type(FUNCTION, specifier, indirection)
+Function::Function(const Name &specifier, unsigned indirection, Parameters *params)
+    : Type(FUNCTION, specifier, indirection, 0, params)
 {
-    _parameters = params;
 }
 
 
@@ -356,7 +519,7 @@ Function::Function(const string &specifier, unsigned indirection, Parameters *pa
  * Description:	Initialize a callback type object.
  */
 
-Callback::Callback(const string &specifier, unsigned indirection)
+Callback::Callback(const Name &specifier, unsigned indirection)
     : Type(CALLBACK, specifier, indirection)
 {
 }
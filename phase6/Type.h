@@ -21,13 +21,31 @@
  *		As we've designed them, types are essentially immutable,
  *		since we haven't included any mutators.  In practice, we'll
  *		be creating new types rather than changing existing types.
+ *
+ *		Since types are immutable, each distinct type is entered
+ *		just once into a table, and a type object is merely a
+ *		pointer to its entry.  Types are thus cheap to copy, and
+ *		two types are identical exactly when their entries are.
+ *		An entry also caches the size, the alignment, and the
+ *		promoted and dereferenced types, so each is computed at
+ *		most once.  Parameter lists are entered into a table as
+ *		well, so equal lists share one vector.
+ *
+ *		The tables are shared by every translation unit, and so by
+ *		every thread.  Entries are added under a lock, and once
+ *		added are never changed except to fill in the caches, which
+ *		any thread may do since each always gets the same value.
+ *		Each thread also remembers the entries it has found, so
+ *		looking up a type it has seen before takes no lock.
  */
 
 # ifndef TYPE_H
 # define TYPE_H
+# include <atomic>
 # include <string>
 # include <vector>
 # include <ostream>
+# include "Name.h"
 
 typedef std::vector<class Type> Parameters;
 
@@ -36,16 +54,26 @@ protected:
     typedef std::string string;
     enum { ARRAY, CALLBACK, ERROR, FUNCTION, SCALAR };
 
-    int _kind;
-    string _specifier;
-    unsigned _indirection;
+    struct Entry {
+	int kind;
+	Name specifier;
+	unsigned indirection;
+	unsigned length;
+	Parameters *parameters;
+	bool structure;
 
-    union {
-	unsigned _length;
-	Parameters *_parameters;
+	mutable std::atomic<const Entry *> promoted, deref;
+	mutable std::atomic<unsigned> size, alignment;
     };
 
-    Type(int kind, const string &specifier, unsigned indirection);
+    const Entry *_entry;
+
+    struct Table;
+    static Table &table();
+
+    Type(int kind, const Name &specifier, unsigned indirection,
+	    unsigned length = 0, Parameters *params = nullptr);
+    Type(const Entry *entry);
 
 public:
     Type();
@@ -59,7 +87,7 @@ public:
     bool isCallback() const;
     bool isError() const;
 
-    const string &specifier() const;
+    const Name &specifier() const;
     unsigned indirection() const;
     unsigned length() const;
     Parameters *parameters() const;
@@ -78,20 +106,20 @@ public:
 };
 
 struct Scalar : public Type {
-    Scalar(const string &specifier, unsigned indirection = 0);
+    Scalar(const Name &specifier, unsigned indirection = 0);
 };
 
 struct Array : public Type {
-    Array(const string &specifier, unsigned indirection, unsigned length);
+    Array(const Name &specifier, unsigned indirection, unsigned length);
 };
 
 struct Function : public Type {
-    Function(const string &specifier, unsigned indirection,
+    Function(const Name &specifier, unsigned indirection,
 	    Parameters *params = nullptr);
 };
 
 struct Callback : public Type {
-    Callback(const string &specifier, unsigned indirection = 0);
+    Callback(const Name &specifier, unsigned indirection = 0);
 };
 
 std::ostream &operator <<(std::ostream &ostr, const Type &type);
@@ -9,104 +9,102 @@
  *		- maintaining minimum offset in nested blocks
  *		- allocation of structure types
  *		- allocation within statements
+ *		- allocation of registers to variables
  */
 
-# include <map>
 # include <cassert>
 # include <iostream>
 # include "checker.h"
+# include "generator.h"
 # include "machine.h"
 # include "Tree.h"
 
 using namespace std;
 
-static map<string,unsigned>sizes;
+static const Name char_name("char");
 
 
 /*
  * Function:	Type::size
  *
- * Description:	Return the size of a type in bytes.
+ * Description:	Return the size of a type in bytes.  The size is cached in
+ *		the type's entry once it is known, except for a structure,
+ *		whose layout belongs to the translation unit defining it.
+ *		Structures are laid out by the checker as soon as they are
+ *		defined.
  */
 
 unsigned Type::size() const
 {
-    unsigned count;
+    const Entry *e = _entry;
+    unsigned count, size;
 
 
-    assert(_kind != FUNCTION && _kind != ERROR);
-    count = (_kind == ARRAY ? _length : 1);
+    if (e->size != 0)
+	return e->size;
 
-    if (_indirection > 0 || _kind == CALLBACK)
-	return count * SIZEOF_PTR;
+    assert(e->kind != FUNCTION && e->kind != ERROR);
+    count = (e->kind == ARRAY ? e->length : 1);
 
-    if (_specifier == "char")
-	return count * SIZEOF_CHAR;
+    if (e->indirection > 0 || e->kind == CALLBACK)
+	size = SIZEOF_PTR;
+    else if (e->structure)
+	return count * getLayout(e->specifier).size;
+    else if (e->specifier == char_name)
+	size = SIZEOF_CHAR;
+    else
+	size = SIZEOF_INT;
 
-    if (_specifier == "int")
-	return count * SIZEOF_INT;
-
-    if (sizes.count(_specifier) > 0)
-	return count * sizes[_specifier];
-
-
-    /* The size of a structure is the size of all of its fields, but with
-       each field aligned and the entire structure aligned as well.  Since
-       this is rather expensive to compute, we cache the result. */
-
-    unsigned align, size = 0;
-    const Symbols &symbols = getFields(_specifier)->symbols();
-
-    for (unsigned i = 0; i < symbols.size(); i ++) {
-	align = symbols[i]->type().alignment();
-
-	if (size % align != 0)
-	    size += (align - size % align);
-
-	symbols[i]->_offset = size;
-	size += symbols[i]->type().size();
-    }
-
-    align = alignment();
-
-    if (size % align != 0)
-	size += (align - size % align);
-
-    sizes[_specifier] = size;
-    return count * size;
+    e->size = count * size;
+    return e->size;
 }
 
 
 /*
  * Function:	Type::alignment
  *
- * Description:	Return the alignment of a type in bytes.
+ * Description:	Return the alignment of a type in bytes.  Like the size,
+ *		it is cached in the type's entry except for a structure.
  */
 
 unsigned Type::alignment() const
 {
-    assert(_kind != FUNCTION && _kind != ERROR);
+    const Entry *e = _entry;
+    unsigned align;
 
-    if (_indirection > 0 || _kind == CALLBACK)
-	return ALIGNOF_PTR;
 
-    if (_specifier == "char")
-	return ALIGNOF_CHAR;
+    if (e->alignment != 0)
+	return e->alignment;
 
-    if (_specifier == "int")
-	return ALIGNOF_INT;
+    assert(e->kind != FUNCTION && e->kind != ERROR);
 
+    if (e->indirection > 0 || e->kind == CALLBACK)
+	align = ALIGNOF_PTR;
+    else if (e->structure)
+	return getLayout(e->specifier).alignment;
+    else if (e->specifier == char_name)
+	align = ALIGNOF_CHAR;
+    else
+	align = ALIGNOF_INT;
+
+    e->alignment = align;
+    return align;
+}
 
-    /* The alignment of a structure is the maximum alignment of its fields. */
 
-    unsigned align = 0;
-    const Symbols &symbols = getFields(_specifier)->symbols();
+/*
+ * Function:	promotable
+ *
+ * Description:	Return whether a variable can be kept in a register for
+ *		the whole function, which is the case for a scalar whose
+ *		address is never taken.
+ */
 
-    for (unsigned i = 0; i < symbols.size(); i ++)
-	if (symbols[i]->type().alignment() > align)
-	    align = symbols[i]->type().alignment();
+static bool promotable(const Symbol *symbol)
+{
+    const Type &t = symbol->type();
 
-    return align;
+    return promoteVariables && !symbol->_addressed && t.isScalar() && t.isValue();
 }
 
 
@@ -118,7 +116,8 @@ unsigned Type::alignment() const
  *		then for all symbols declared within any nested block.
  *		Only symbols that have not already been allocated an offset
  *		will be assigned one, since the parameters are already
- *		assigned special offsets.
+ *		assigned special offsets.  A symbol that can live in a
+ *		register is given a virtual register of its own instead.
  */
 
 void Block::allocate(int &offset) const
@@ -128,7 +127,12 @@ void Block::allocate(int &offset) const
 
 
     for (auto symbol : symbols)
-	if (symbol->_offset == 0) {
+	if (symbol->_offset == 0 && symbol->_register == nullptr) {
+	    if (promotable(symbol)) {
+		symbol->_register = getreg();
+		continue;
+	    }
+
 	    offset -= symbol->type().size();
 	    symbol->_offset = offset;
 	}
@@ -200,7 +204,9 @@ void If::allocate(int &offset) const
  *
  * Description:	Allocate storage for this function and return the number of
  *		bytes required.  The parameters are allocated offsets as
- *		well, starting with the given offset.
+ *		well, starting with the given offset, and any that can live
+ *		in a register are given one, into which the prologue loads
+ *		them.
  */
 
 void Procedure::allocate(int &offset) const
@@ -211,6 +217,9 @@ void Procedure::allocate(int &offset) const
     for (unsigned i = 0; i < params->size(); i ++) {
 	symbols[i]->_offset = offset;
 	offset += (*params)[i].promote().size();
+
+	if (promotable(symbols[i]))
+	    symbols[i]->_register = getreg();
     }
 
     offset = 0;
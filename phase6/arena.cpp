@@ -0,0 +1,183 @@
+/*
+ * File:	arena.cpp
+ *
+ * Description:	This file contains the member function definitions for
+ *		the memory arenas of Simple C, along with the current arena
+ *		of each thread.
+ *
+ *		Chunks are never returned to the system until the arena
+ *		itself is destroyed.  Releasing an arena simply starts
+ *		handing out its first chunk again.
+ */
+
+# include <cstdlib>
+# include "arena.h"
+
+using namespace std;
+
+static const size_t CHUNK_SIZE = 1 << 16;
+static const size_t ALIGNMENT = alignof(max_align_t);
+
+thread_local Arena *arena;
+
+
+/*
+ * Function:	Arena::Arena (constructor)
+ *
+ * Description:	Initialize an empty arena.  No memory is obtained until
+ *		the first allocation.
+ */
+
+Arena::Arena()
+    : _chunk(0), _next(nullptr), _limit(nullptr), _used(0), _peak(0)
+{
+}
+
+
+/*
+ * Function:	Arena::~Arena (destructor)
+ *
+ * Description:	Run the finalizers and return all the chunks to the
+ *		system.
+ */
+
+Arena::~Arena()
+{
+    release();
+
+    for (auto &chunk : _chunks)
+	free(chunk.first);
+}
+
+
+/*
+ * Function:	Arena::allocate
+ *
+ * Description:	Return SIZE bytes of memory, suitably aligned for any type.
+ */
+
+void *Arena::allocate(size_t size)
+{
+    char *p = _next;
+
+
+    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+    if (p == nullptr || (size_t) (_limit - p) < size)
+	return grow(size);
+
+    _next = p + size;
+    _used += size;
+    return p;
+}
+
+
+/*
+ * Function:	Arena::grow (private)
+ *
+ * Description:	Move on to the next chunk that can hold SIZE bytes,
+ *		reusing a chunk from before the last release if possible,
+ *		and allocate from it.  A chunk that is too small for the
+ *		request is skipped; its space is lost only until the next
+ *		release.
+ */
+
+void *Arena::grow(size_t size)
+{
+    size_t capacity;
+    char *p;
+
+
+    if (_next != nullptr)
+	_chunk ++;
+
+    while (_chunk < _chunks.size() && _chunks[_chunk].second < size)
+	_chunk ++;
+
+    if (_chunk == _chunks.size()) {
+	capacity = size > CHUNK_SIZE ? size : CHUNK_SIZE;
+
+	if ((p = (char *) malloc(capacity)) == nullptr)
+	    throw bad_alloc();
+
+	_chunks.push_back({p, capacity});
+    }
+
+    p = _chunks[_chunk].first;
+    _next = p + size;
+    _limit = p + _chunks[_chunk].second;
+    _used += size;
+
+    if (_used > _peak)
+	_peak = _used;
+
+    return p;
+}
+
+
+/*
+ * Function:	Arena::release
+ *
+ * Description:	Destroy every object that registered a finalizer, in the
+ *		reverse order of their allocation, and make all of the
+ *		memory available again.
+ */
+
+void Arena::release()
+{
+    while (!_finalizers.empty()) {
+	_finalizers.back().destroy(_finalizers.back().object);
+	_finalizers.pop_back();
+    }
+
+    if (_used > _peak)
+	_peak = _used;
+
+    _chunk = 0;
+    _used = 0;
+    _next = _chunks.empty() ? nullptr : _chunks[0].first;
+    _limit = _chunks.empty() ? nullptr : _chunks[0].first + _chunks[0].second;
+}
+
+
+/*
+ * Function:	Arena::used (accessor)
+ *
+ * Description:	Return the number of bytes currently allocated.
+ */
+
+size_t Arena::used() const
+{
+    return _used;
+}
+
+
+/*
+ * Function:	Arena::peak (accessor)
+ *
+ * Description:	Return the largest number of bytes ever allocated at once.
+ */
+
+size_t Arena::peak() const
+{
+    return _used > _peak ? _used : _peak;
+}
+
+
+/*
+ * Function:	Arena::statistics
+ *
+ * Description:	Write the memory statistics of this arena to the given
+ *		stream.
+ */
+
+void Arena::statistics(ostream &ostr) const
+{
+    size_t reserved = 0;
+
+    for (auto &chunk : _chunks)
+	reserved += chunk.second;
+
+    ostr << used() << " bytes in use, " << peak() << " bytes at peak, ";
+    ostr << reserved << " bytes in " << _chunks.size() << " chunks" << endl;
+}
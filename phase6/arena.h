@@ -0,0 +1,115 @@
+/*
+ * File:	arena.h
+ *
+ * Description:	This file contains the class definition for the memory
+ *		arenas of Simple C.  An arena hands out memory by bumping a
+ *		pointer through large chunks, and releases everything it
+ *		handed out all at once.  Objects with destructors register
+ *		a finalizer, which is run when the arena is released.
+ *
+ *		Each compilation has two arenas.  The permanent arena holds
+ *		whatever must outlive a single function: global symbols,
+ *		structure fields, function types, and the outermost scope.
+ *		The transient arena holds the trees, scopes, and local
+ *		symbols of the function being compiled, and is released once
+ *		the code for the function has been generated.  Its chunks
+ *		are kept for the next function, so memory use is bounded by
+ *		the largest function rather than by the whole file.
+ *
+ *		The classes that derive from Allocated are placed in the
+ *		current arena of the thread by a plain new, or in a given
+ *		arena by new (arena).  They must never be deleted.
+ */
+
+# ifndef ARENA_H
+# define ARENA_H
+# include <new>
+# include <cstddef>
+# include <vector>
+# include <utility>
+# include <ostream>
+# include <type_traits>
+
+class Arena {
+    struct Finalizer {
+	void *object;
+	void (*destroy)(void *);
+    };
+
+    std::vector<std::pair<char *, size_t>> _chunks;
+    std::vector<Finalizer> _finalizers;
+    unsigned _chunk;
+    char *_next, *_limit;
+    size_t _used, _peak;
+
+    Arena(const Arena &);
+    Arena &operator =(const Arena &);
+
+    void *grow(size_t size);
+
+    template<class T>
+    static void destroy(void *object) {
+	static_cast<T *>(object)->~T();
+    }
+
+public:
+    Arena();
+    ~Arena();
+
+    void *allocate(size_t size);
+    void release();
+
+    size_t used() const;
+    size_t peak() const;
+    void statistics(std::ostream &ostr) const;
+
+
+    /* Register the object of type T at the given address to be destroyed
+       when this arena is released, unless it doesn't need to be. */
+
+    template<class T>
+    void finalize(T *object) {
+	if (!std::is_trivially_destructible<T>::value)
+	    _finalizers.push_back({object, destroy<T>});
+    }
+
+
+    /* Construct a new object of any type T in this arena. */
+
+    template<class T, class... Args>
+    T *make(Args &&... args) {
+	T *object = new (allocate(sizeof(T))) T(std::forward<Args>(args)...);
+
+	finalize(object);
+	return object;
+    }
+};
+
+extern thread_local Arena *arena;
+
+
+/* A base class for objects that live in an arena.  Since an object is
+   finalized through a pointer to T, a class hierarchy needs a virtual
+   destructor in T.  The memory of a deleted object isn't reclaimed, and
+   its destructor would run a second time when the arena is released,
+   which is why delete must never be used. */
+
+template<class T>
+class Allocated {
+public:
+    static void *operator new(size_t size) {
+	return operator new(size, *arena);
+    }
+
+    static void *operator new(size_t size, Arena &arena) {
+	void *p = arena.allocate(size);
+
+	arena.finalize(static_cast<T *>(p));
+	return p;
+    }
+
+    static void operator delete(void *p) {}
+    static void operator delete(void *p, Arena &arena) {}
+};
+
+# endif /* ARENA_H */
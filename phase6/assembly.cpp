@@ -0,0 +1,883 @@
+/*
+ * File:	assembly.cpp
+ *
+ * Description:	This file contains the member function definitions for
+ *		the in-memory assembly code of Simple C, along with the
+ *		printer that writes it out in AT&T syntax.
+ *
+ *		A new basic block is started at every label and after every
+ *		jump or return, so a block has at most one label at its
+ *		start and at most one branch at its end.
+ */
+
+# include <cassert>
+# include <cstring>
+# include "assembly.h"
+# include "Register.h"
+# include "machine.h"
+
+using namespace std;
+
+static const char *mnemonics[] = {
+    "movl", "movb", "movsbl", "movzbl", "leal",
+    "addl", "subl", "imull", "negl", "shll", "sarl", "shrl",
+    "cltd", "idivl", "cmpl", "testl", "testb",
+    "sete", "setne", "setl", "setg", "setle", "setge",
+    "jmp", "je", "jne", "jl", "jg", "jle", "jge",
+    "pushl", "popl", "call", "ret",
+};
+
+static const char *registers[][2] = {
+    {"%eax", "%al"}, {"%ecx", "%cl"}, {"%edx", "%dl"}, {"%ebx", "%bl"},
+    {"%esp", ""}, {"%ebp", ""}, {"%esi", ""}, {"%edi", ""},
+};
+
+
+/*
+ * Function:	Operand::Operand (constructor)
+ *
+ * Description:	Initialize an empty operand.
+ */
+
+Operand::Operand()
+    : kind(NONE), size(SIZEOF_REG), scale(1), base(NOREG), index(NOREG),
+      value(0), label(-1)
+{
+}
+
+
+/*
+ * Function:	Operand::Operand (constructor)
+ *
+ * Description:	Initialize a register operand with the given access size.
+ */
+
+Operand::Operand(const Register *reg, unsigned size)
+    : Operand()
+{
+    kind = REGISTER;
+    base = reg->number();
+    this->size = size;
+}
+
+
+/*
+ * Function:	Operand::operator ==
+ *
+ * Description:	Return whether two operands refer to the same thing.  The
+ *		access size matters only for registers.
+ */
+
+bool Operand::operator ==(const Operand &rhs) const
+{
+    if (kind != rhs.kind || base != rhs.base || value != rhs.value)
+	return false;
+
+    if (kind == REGISTER)
+	return size == rhs.size;
+
+    return index == rhs.index && scale == rhs.scale && label == rhs.label
+	&& symbol == rhs.symbol;
+}
+
+
+/*
+ * Function:	Operand::operator !=
+ *
+ * Description:	Return whether two operands differ.
+ */
+
+bool Operand::operator !=(const Operand &rhs) const
+{
+    return !operator ==(rhs);
+}
+
+
+/*
+ * Function:	Immediate::Immediate (constructor)
+ *
+ * Description:	Initialize an immediate operand with a constant value.
+ */
+
+Immediate::Immediate(int value)
+{
+    kind = IMMEDIATE;
+    this->value = value;
+}
+
+
+/*
+ * Function:	Immediate::Immediate (constructor)
+ *
+ * Description:	Initialize an immediate operand with the value of a
+ *		symbol, which is resolved by the assembler.
+ */
+
+Immediate::Immediate(const Name &symbol)
+{
+    kind = IMMEDIATE;
+    this->symbol = symbol;
+}
+
+
+/*
+ * Function:	Memory::Memory (constructor)
+ *
+ * Description:	Initialize a memory operand at the given displacement from
+ *		the address in a base register.
+ */
+
+Memory::Memory(const Register *base, int disp)
+{
+    kind = MEMORY;
+    this->base = base->number();
+    value = disp;
+}
+
+
+/*
+ * Function:	Memory::Memory (constructor)
+ *
+ * Description:	Initialize a memory operand that adds a scaled index
+ *		register to the base register.
+ */
+
+Memory::Memory(const Register *base, const Register *index, unsigned scale, int disp)
+{
+    kind = MEMORY;
+    this->base = base->number();
+    this->index = index->number();
+    this->scale = scale;
+    value = disp;
+}
+
+
+/*
+ * Function:	Memory::Memory (constructor)
+ *
+ * Description:	Initialize a memory operand at the address of a global.
+ */
+
+Memory::Memory(const Name &symbol)
+{
+    kind = MEMORY;
+    this->symbol = symbol;
+}
+
+
+/*
+ * Function:	Memory::Memory (constructor)
+ *
+ * Description:	Initialize a memory operand at the address of a label.
+ */
+
+Memory::Memory(const Label &label)
+{
+    kind = MEMORY;
+    this->label = label.number();
+}
+
+
+/*
+ * Function:	Target::Target (constructor)
+ *
+ * Description:	Initialize the target of a jump or call by its name.
+ */
+
+Target::Target(const Name &symbol)
+{
+    kind = TARGET;
+    this->symbol = symbol;
+}
+
+
+/*
+ * Function:	Target::Target (constructor)
+ *
+ * Description:	Initialize the target of a jump by its label.
+ */
+
+Target::Target(const Label &label)
+{
+    kind = TARGET;
+    this->label = label.number();
+}
+
+
+/*
+ * Function:	Assembly::Assembly (constructor)
+ *
+ * Description:	Initialize an empty function.
+ */
+
+Assembly::Assembly()
+    : _frame(0), _current(nullptr)
+{
+}
+
+
+/*
+ * Function:	Assembly::nameable
+ *
+ * Description:	Return whether the labels of a function with the given
+ *		name can be named, which they can't if the table of names
+ *		is full.
+ */
+
+bool Assembly::nameable(const Name &name)
+{
+    return Name(name.str() + ".exit") != Name() && Name(name.str() + ".size") != Name();
+}
+
+
+/*
+ * Function:	Assembly::begin
+ *
+ * Description:	Discard any previous code and start a new function with the
+ *		given name.  The first block is labeled with the name.
+ */
+
+void Assembly::begin(const Name &name)
+{
+    _name = name;
+    _exit = Target(name.str() + ".exit");
+    _size = Immediate(name.str() + ".size");
+    _frame = 0;
+
+    while (!_blocks.empty()) {
+	_blocks.back().instructions.clear();
+	_spare.push_back(std::move(_blocks.back()));
+	_blocks.pop_back();
+    }
+
+    label(Target(name));
+}
+
+
+/*
+ * Function:	Assembly::block (private)
+ *
+ * Description:	Start a new unlabeled basic block.  The blocks of earlier
+ *		functions are reused, so that their instruction lists need
+ *		not grow again from nothing.
+ */
+
+BasicBlock &Assembly::block()
+{
+    if (_spare.empty())
+	_blocks.emplace_back();
+    else {
+	_blocks.push_back(std::move(_spare.back()));
+	_spare.pop_back();
+	_blocks.back().label = Operand();
+    }
+
+    _blocks.back().aligned = false;
+
+    _current = &_blocks.back();
+    return *_current;
+}
+
+
+/*
+ * Function:	Assembly::label
+ *
+ * Description:	Start a new basic block with the given label.  The label
+ *		of a loop is aligned, so that the processor fetches its
+ *		body in as few lines as possible.
+ */
+
+void Assembly::label(const Operand &target, bool aligned)
+{
+    assert(target.kind == Operand::TARGET);
+    block().label = target;
+    _current->aligned = aligned;
+}
+
+
+/*
+ * Function:	Assembly::emit
+ *
+ * Description:	Append an instruction to the current basic block, starting
+ *		an unlabeled block if the last one ended in a branch.
+ */
+
+void Assembly::emit(Opcode opcode, const Operand &src, const Operand &dst)
+{
+    if (_current == nullptr)
+	block();
+
+    Instruction instruction = {opcode, src, dst};
+
+    _current->instructions.push_back(instruction);
+
+    if ((opcode >= JMP && opcode <= JGE) || opcode == RET)
+	_current = nullptr;
+}
+
+
+/*
+ * Function:	Assembly::frame
+ *
+ * Description:	Set the size of the stack frame of this function.
+ */
+
+void Assembly::frame(int size)
+{
+    _frame = size;
+}
+
+
+/*
+ * Function:	Assembly::frame (accessor)
+ *
+ * Description:	Return the size of the stack frame of this function.
+ */
+
+int Assembly::frame() const
+{
+    return _frame;
+}
+
+
+/*
+ * Function:	Assembly::name (accessor)
+ *
+ * Description:	Return the name of this function.
+ */
+
+const Name &Assembly::name() const
+{
+    return _name;
+}
+
+
+/*
+ * Function:	Assembly::exit (accessor)
+ *
+ * Description:	Return the target of the epilogue of this function.
+ */
+
+const Operand &Assembly::exit() const
+{
+    return _exit;
+}
+
+
+/*
+ * Function:	Assembly::size (accessor)
+ *
+ * Description:	Return an immediate operand for the size of the stack
+ *		frame, which isn't known until the body has been generated.
+ */
+
+const Operand &Assembly::size() const
+{
+    return _size;
+}
+
+
+/*
+ * Function:	Assembly::blocks (accessor)
+ *
+ * Description:	Return the basic blocks of this function.
+ */
+
+BasicBlocks &Assembly::blocks()
+{
+    return _blocks;
+}
+
+const BasicBlocks &Assembly::blocks() const
+{
+    return _blocks;
+}
+
+
+/* A function is saved in a compact binary form, in which each number is
+   written as its bytes and each symbol as its length and characters.
+   The form is only ever read back by the same compiler on the same
+   machine, so no attempt is made to make it portable. */
+
+
+/*
+ * Function:	save (private)
+ *
+ * Description:	Append a number, symbol, or operand to the given data.
+ */
+
+template<class T>
+static void save(string &data, T value)
+{
+    data.append((const char *) &value, sizeof(value));
+}
+
+static void save(string &data, const Name &name)
+{
+    const string &s = name.id() != 0 ? name.str() : string();
+
+    save<unsigned>(data, s.size());
+    data.append(s);
+}
+
+static void save(string &data, const Operand &operand)
+{
+    save(data, operand.kind);
+    save(data, operand.size);
+    save(data, operand.scale);
+    save(data, operand.base);
+    save(data, operand.index);
+    save(data, operand.value);
+    save(data, operand.label);
+    save(data, operand.symbol);
+}
+
+
+/*
+ * Function:	load (private)
+ *
+ * Description:	Read back a number, symbol, or operand that was saved at
+ *		the given position in the data, and advance the position
+ *		past it.  Return false if the data ends first.
+ */
+
+template<class T>
+static bool load(const string &data, size_t &pos, T &value)
+{
+    if (data.size() - pos < sizeof(value))
+	return false;
+
+    memcpy(&value, data.data() + pos, sizeof(value));
+    pos += sizeof(value);
+    return true;
+}
+
+static bool load(const string &data, size_t &pos, Name &name)
+{
+    unsigned length;
+
+
+    if (!load(data, pos, length) || data.size() - pos < length)
+	return false;
+
+    name = length > 0 ? Name(string_view(data.data() + pos, length)) : Name();
+    pos += length;
+    return length == 0 || name != Name();
+}
+
+static bool load(const string &data, size_t &pos, Operand &operand)
+{
+    return load(data, pos, operand.kind) && load(data, pos, operand.size)
+	&& load(data, pos, operand.scale) && load(data, pos, operand.base)
+	&& load(data, pos, operand.index) && load(data, pos, operand.value)
+	&& load(data, pos, operand.label) && load(data, pos, operand.symbol)
+	&& operand.kind <= Operand::TARGET;
+}
+
+
+/*
+ * Function:	Assembly::save
+ *
+ * Description:	Append this function, once it is finished, to the given
+ *		data so that it can later be loaded instead of generated.
+ */
+
+void Assembly::save(string &data) const
+{
+    ::save(data, _name);
+    ::save(data, _frame);
+    ::save<unsigned>(data, _blocks.size());
+
+    for (auto &block : _blocks) {
+	::save(data, block.label);
+	::save(data, block.aligned);
+	::save<unsigned>(data, block.instructions.size());
+
+	for (auto &instruction : block.instructions) {
+	    ::save(data, instruction.opcode);
+	    ::save(data, instruction.src);
+	    ::save(data, instruction.dst);
+	}
+    }
+}
+
+
+/*
+ * Function:	Assembly::load
+ *
+ * Description:	Discard any previous code and load a finished function
+ *		saved at the given position in the data, advancing the
+ *		position past it.  Return false if the data is not a whole
+ *		function, in which case the code is left empty.
+ */
+
+bool Assembly::load(const string &data, size_t &pos)
+{
+    unsigned numBlocks, numInsns;
+    bool ok;
+    Name name;
+    int frame;
+
+
+    if (!::load(data, pos, name) || !::load(data, pos, frame)
+	    || name.id() == 0 || !::load(data, pos, numBlocks))
+	return false;
+
+    begin(name);
+    _blocks.clear();
+    _frame = frame;
+    ok = true;
+
+    for (unsigned i = 0; ok && i < numBlocks; i ++) {
+	BasicBlock &block = this->block();
+
+	ok = ::load(data, pos, block.label) && ::load(data, pos, block.aligned)
+	    && ::load(data, pos, numInsns);
+
+	for (unsigned j = 0; ok && j < numInsns; j ++) {
+	    Instruction instruction;
+
+	    ok = ::load(data, pos, instruction.opcode) && instruction.opcode <= RET
+		&& ::load(data, pos, instruction.src)
+		&& ::load(data, pos, instruction.dst);
+
+	    if (ok)
+		block.instructions.push_back(instruction);
+	}
+    }
+
+    _current = nullptr;
+
+    if (!ok)
+	_blocks.clear();
+
+    return ok;
+}
+
+
+/* The printer formats each line directly into a buffer of its own and
+   hands it to the stream buffer in large pieces, since formatting each
+   piece of an operand through the stream itself costs more than
+   generating the code in the first place.  Before each line, the printer
+   reserves enough space for the longest line it could possibly write. */
+
+class Output {
+    streambuf *_sb;
+    char *_data;
+    size_t _capacity, _used;
+    char _buffer[8192];
+    vector<char> _large;
+
+public:
+    Output(streambuf *sb)
+	: _sb(sb), _data(_buffer), _capacity(sizeof(_buffer)), _used(0) {}
+
+    ~Output() { _sb->sputn(_data, _used); }
+
+    char *reserve(size_t n) {
+	if (_used + n > _capacity) {
+	    _sb->sputn(_data, _used);
+	    _used = 0;
+
+	    if (n > _capacity) {
+		_large.resize(n);
+		_data = _large.data();
+		_capacity = n;
+	    }
+	}
+
+	return _data + _used;
+    }
+
+    void commit(char *p) {
+	_used = p - _data;
+    }
+};
+
+static const size_t LINE_SIZE = 128;
+
+
+/*
+ * Function:	length (private)
+ *
+ * Description:	Return an upper bound on the length of the symbol of an
+ *		operand beyond what a line always has room for.
+ */
+
+static size_t length(const Operand &operand)
+{
+    return operand.symbol.id() != 0 ? operand.symbol.str().size() : 0;
+}
+
+
+/*
+ * Function:	put (private)
+ *
+ * Description:	Copy a string to the given position and return the
+ *		position after it.
+ */
+
+static char *put(char *p, const char *s)
+{
+    size_t n = strlen(s);
+
+    memcpy(p, s, n);
+    return p + n;
+}
+
+static char *put(char *p, const string &s)
+{
+    memcpy(p, s.data(), s.size());
+    return p + s.size();
+}
+
+
+/*
+ * Function:	put (private)
+ *
+ * Description:	Write a signed integer to the given position, with a
+ *		leading plus sign if requested, and return the position
+ *		after it.
+ */
+
+static char *put(char *p, int value, bool sign = false)
+{
+    char buf[16], *q = buf + sizeof(buf);
+    unsigned n = value < 0 ? -(unsigned) value : value;
+
+    do {
+	*--q = '0' + n % 10;
+	n /= 10;
+    } while (n > 0);
+
+    if (value < 0)
+	*p ++ = '-';
+    else if (sign)
+	*p ++ = '+';
+
+    while (q < buf + sizeof(buf))
+	*p ++ = *q ++;
+
+    return p;
+}
+
+
+/*
+ * Function:	reg (private)
+ *
+ * Description:	Write the name of a register to the given position and
+ *		return the position after it.  Virtual registers are only
+ *		ever written when debugging.
+ */
+
+static char *reg(char *p, int number, bool byte = false)
+{
+    if (number < NUM_REGS)
+	return put(p, registers[number][byte]);
+
+    p = put(put(p, "%v"), number);
+    return byte ? put(p, "b") : p;
+}
+
+
+/*
+ * Function:	symbol (private)
+ *
+ * Description:	Write the symbol of an operand, if any, to the given
+ *		position.  Return the position after it, or a null pointer
+ *		if there was no symbol.
+ */
+
+static char *symbol(char *p, const Operand &operand)
+{
+    if (operand.label >= 0)
+	return put(put(p, label_prefix), operand.label);
+
+    if (operand.symbol.id() != 0)
+	return put(put(p, global_prefix), operand.symbol.str());
+
+    return nullptr;
+}
+
+
+/*
+ * Function:	put (private)
+ *
+ * Description:	Write an operand in AT&T syntax to the given position and
+ *		return the position after it.
+ */
+
+static char *put(char *p, const Operand &operand)
+{
+    char *q;
+
+
+    switch (operand.kind) {
+    case Operand::REGISTER:
+	return reg(p, operand.base, operand.size == 1);
+
+    case Operand::IMMEDIATE:
+	*p ++ = '$';
+
+	if ((q = symbol(p, operand)) == nullptr)
+	    return put(p, operand.value);
+
+	return operand.value != 0 ? put(q, operand.value, true) : q;
+
+    case Operand::MEMORY:
+	if ((q = symbol(p, operand)) == nullptr) {
+	    if (operand.value != 0 || operand.base == NOREG)
+		p = put(p, operand.value);
+	} else
+	    p = operand.value != 0 ? put(q, operand.value, true) : q;
+
+	if (operand.base != NOREG || operand.index != NOREG) {
+	    *p ++ = '(';
+
+	    if (operand.base != NOREG)
+		p = reg(p, operand.base);
+
+	    if (operand.index != NOREG) {
+		*p ++ = ',';
+		p = reg(p, operand.index);
+		*p ++ = ',';
+		p = put(p, operand.scale);
+	    }
+
+	    *p ++ = ')';
+	}
+
+	return p;
+
+    case Operand::TARGET:
+	return symbol(p, operand);
+
+    default:
+	return p;
+    }
+}
+
+
+/*
+ * Function:	write (private)
+ *
+ * Description:	Write an instruction in AT&T syntax to the output.  The
+ *		target of an indirect jump or call is marked with a star.
+ */
+
+static void write(Output &out, const Instruction &instruction)
+{
+    const Operand &src = instruction.src, &dst = instruction.dst;
+    char *p = out.reserve(LINE_SIZE + length(src) + length(dst));
+
+
+    *p ++ = '\t';
+    p = put(p, mnemonics[instruction.opcode]);
+
+    if (src.kind != Operand::NONE) {
+	*p ++ = '\t';
+
+	if (instruction.opcode == CALL || instruction.opcode == JMP)
+	    if (src.kind != Operand::TARGET)
+		*p ++ = '*';
+
+	p = put(p, src);
+    }
+
+    if (dst.kind != Operand::NONE) {
+	p = put(p, src.kind != Operand::NONE ? ", " : "\t");
+	p = put(p, dst);
+    }
+
+    *p ++ = '\n';
+    out.commit(p);
+}
+
+
+/*
+ * Function:	write (private)
+ *
+ * Description:	Write a label followed by a colon to the output.
+ */
+
+static void write(Output &out, const Operand &label)
+{
+    char *p = out.reserve(LINE_SIZE + length(label));
+
+    p = put(p, label);
+    *p ++ = ':';
+    *p ++ = '\n';
+    out.commit(p);
+}
+
+
+/*
+ * Function:	Assembly::write
+ *
+ * Description:	Write this function to the given stream.  Named blocks
+ *		after the first, such as the epilogue, are set apart with a
+ *		blank line.  Aligned labels are padded to a 16-byte boundary
+ *		unless that would take more than ten bytes of padding.  The
+ *		frame size is given to the assembler as a symbol after the
+ *		code.
+ */
+
+void Assembly::write(ostream &ostr) const
+{
+    Output out(ostr.rdbuf());
+    char *p;
+
+
+    for (unsigned i = 0; i < _blocks.size(); i ++) {
+	const BasicBlock &block = _blocks[i];
+
+	if (block.label.kind != Operand::NONE) {
+	    if (i > 0 && block.label.label < 0)
+		out.commit(put(out.reserve(1), "\n"));
+
+	    if (block.aligned)
+		out.commit(put(out.reserve(LINE_SIZE), "\t.p2align\t4,,10\n"));
+
+	    ::write(out, block.label);
+	}
+
+	for (auto &instruction : block.instructions)
+	    ::write(out, instruction);
+    }
+
+    p = out.reserve(LINE_SIZE + length(_size) + length(Target(_name)));
+    p = put(put(p, "\n\t.set\t"), Target(_size.symbol));
+    p = put(put(p, ", "), _frame);
+    p = put(put(p, "\n\t.globl\t"), Target(_name));
+    out.commit(put(p, "\n\n"));
+}
+
+
+/*
+ * Function:	operator <<
+ *
+ * Description:	Write an operand to a stream in AT&T syntax.
+ */
+
+ostream &operator <<(ostream &ostr, const Operand &operand)
+{
+    Output out(ostr.rdbuf());
+
+    out.commit(put(out.reserve(LINE_SIZE + length(operand)), operand));
+    return ostr;
+}
+
+
+/*
+ * Function:	operator <<
+ *
+ * Description:	Write an instruction to a stream in AT&T syntax.
+ */
+
+ostream &operator <<(ostream &ostr, const Instruction &instruction)
+{
+    Output out(ostr.rdbuf());
+
+    write(out, instruction);
+    return ostr;
+}
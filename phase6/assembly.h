@@ -0,0 +1,127 @@
+/*
+ * File:	assembly.h
+ *
+ * Description:	This file contains the definitions for the in-memory
+ *		assembly code of Simple C.  Rather than writing text as it
+ *		goes, the code generator builds a list of basic blocks of
+ *		instructions for each function, which can then be revisited
+ *		before the printer finally writes them out in AT&T syntax.
+ *
+ *		An operand is a register, an immediate value, a memory
+ *		reference of the form symbol+disp(base,index,scale), or
+ *		the target of a jump or call.  A symbol is either a global
+ *		name or a numbered label.  Registers are identified by
+ *		their number in the instruction encoding.  Numbers from
+ *		NUM_REGS on are virtual registers, which the register
+ *		allocator replaces before the code is written.
+ *
+ *		An imull without a destination is the one-operand form,
+ *		which multiplies %eax by its operand into %edx:%eax.
+ *
+ *		A finished function may also be saved in a compact form and
+ *		loaded back later, so that it can be kept in the cache of
+ *		functions rather than generated again.
+ */
+
+# ifndef ASSEMBLY_H
+# define ASSEMBLY_H
+# include <string>
+# include <vector>
+# include <ostream>
+# include "Name.h"
+# include "label.h"
+
+enum { EAX, ECX, EDX, EBX, ESP, EBP, ESI, EDI, NUM_REGS, NOREG = -1 };
+
+enum Opcode : unsigned char {
+    MOVL, MOVB, MOVSBL, MOVZBL, LEAL,
+    ADDL, SUBL, IMULL, NEGL, SHLL, SARL, SHRL, CLTD, IDIVL, CMPL, TESTL, TESTB,
+    SETE, SETNE, SETL, SETG, SETLE, SETGE,
+    JMP, JE, JNE, JL, JG, JLE, JGE,
+    PUSHL, POPL, CALL, RET,
+};
+
+struct Operand {
+    enum Kind : unsigned char { NONE, REGISTER, IMMEDIATE, MEMORY, TARGET };
+
+    Kind kind;
+    unsigned char size;
+    unsigned char scale;
+    int base, index;
+    int value;
+    int label;
+    Name symbol;
+
+    Operand();
+    Operand(const class Register *reg, unsigned size);
+
+    bool operator ==(const Operand &rhs) const;
+    bool operator !=(const Operand &rhs) const;
+};
+
+struct Immediate : public Operand {
+    Immediate(int value);
+    Immediate(const Name &symbol);
+};
+
+struct Memory : public Operand {
+    Memory(const class Register *base, int disp = 0);
+    Memory(const class Register *base, const class Register *index, unsigned scale, int disp = 0);
+    Memory(const Name &symbol);
+    Memory(const Label &label);
+};
+
+struct Target : public Operand {
+    Target(const Name &symbol);
+    Target(const Label &label);
+};
+
+struct Instruction {
+    Opcode opcode;
+    Operand src, dst;
+};
+
+typedef std::vector<Instruction> Instructions;
+
+struct BasicBlock {
+    Operand label;
+    Instructions instructions;
+    bool aligned;			/* label starts a loop */
+};
+
+typedef std::vector<BasicBlock> BasicBlocks;
+
+class Assembly {
+    Name _name;
+    Operand _exit, _size;
+    int _frame;
+    BasicBlock *_current;
+    BasicBlocks _blocks, _spare;
+
+    BasicBlock &block();
+
+public:
+    Assembly();
+
+    static bool nameable(const Name &name);
+    void begin(const Name &name);
+    void label(const Operand &target, bool aligned = false);
+    void emit(Opcode opcode, const Operand &src = Operand(), const Operand &dst = Operand());
+    void frame(int size);
+    int frame() const;
+
+    const Name &name() const;
+    const Operand &exit() const;
+    const Operand &size() const;
+    BasicBlocks &blocks();
+    const BasicBlocks &blocks() const;
+
+    void write(std::ostream &ostr) const;
+    void save(std::string &data) const;
+    bool load(const std::string &data, size_t &pos);
+};
+
+std::ostream &operator <<(std::ostream &ostr, const Operand &operand);
+std::ostream &operator <<(std::ostream &ostr, const Instruction &instruction);
+
+# endif /* ASSEMBLY_H */
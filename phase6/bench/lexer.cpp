@@ -0,0 +1,56 @@
+/*
+ * File:	lexer.cpp
+ *
+ * Description:	This file contains a driver that only tokenizes its input,
+ *		for measuring the throughput of the lexer.  The named file
+ *		is mapped, or the standard input is read in bulk if none is
+ *		given, just as by the compiler, and the time to make the
+ *		source available is included.  The number of bytes, tokens,
+ *		and the time taken are written to the standard output.
+ */
+
+# include <cerrno>
+# include <chrono>
+# include <cstdlib>
+# include <cstring>
+# include <iostream>
+# include "../context.h"
+# include "../lexer.h"
+# include "../source.h"
+# include "../tokens.h"
+
+using namespace std;
+using namespace std::chrono;
+
+
+int main(int argc, char *argv[])
+{
+    CompilerContext unit;
+    unsigned long tokens;
+    string_view lexeme;
+    Source source;
+    double seconds;
+    bool ok;
+    Name name;
+
+
+    auto start = steady_clock::now();
+    ok = argc > 1 ? source.open(argv[1]) : source.open(0);
+
+    if (!ok) {
+	cerr << argv[0] << ": " << (argc > 1 ? argv[1] : "stdin") << ": ";
+	cerr << strerror(errno) << endl;
+	exit(EXIT_FAILURE);
+    }
+
+    context = &unit;
+    lexinit(source.begin(), source.end());
+
+    for (tokens = 0; lexan(lexeme, name) != DONE; tokens ++)
+	;
+
+    seconds = duration<double>(steady_clock::now() - start).count();
+    cout << source.size() << " bytes, " << tokens << " tokens, ";
+    cout << seconds << " s, " << source.size() / seconds / 1e6 << " MB/s" << endl;
+    exit(EXIT_SUCCESS);
+}
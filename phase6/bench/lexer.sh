@@ -0,0 +1,51 @@
+#!/bin/sh
+#
+# File:		lexer.sh
+#
+# Description:	Measure the throughput of the lexer on a generated program
+#		of the given size in megabytes, 32 by default, when the
+#		source is a mapped file and when it is read in bulk from a
+#		pipe.  The compiler is built with optimization in a scratch
+#		directory, and the best of five runs of each is reported.
+#
+#		usage: bench/lexer.sh [megabytes]
+#
+
+dir=$(cd "$(dirname "$0")/.." && pwd)
+size=${1:-32}
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' 0
+
+cp "$dir"/*.cpp "$dir"/*.h "$dir"/Makefile "$work" || exit 1
+make -s -j4 -C "$work" CXXFLAGS="-O2 -pthread" scc || exit 1
+objs=$(cd "$work" && ls *.o | grep -v -e '^parser\.o$' -e '^server\.o$')
+(cd "$work" && g++ -std=c++17 -O2 -pthread -o lexer "$dir/bench/lexer.cpp" $objs) || exit 1
+
+awk -v size="$size" 'BEGIN {
+    print "int printf();"
+    print "struct rec { int a, b; char c; struct rec *next; };"
+
+    for (n = 0; bytes < size * 1048576; n ++) {
+	text = sprintf("/* function %d: a block comment the lexer skips in bulk,\n" \
+	    "   with * stars * and / slashes / along the way */\n" \
+	    "int g%d, h%d[8];\n\n" \
+	    "int func%d(int a, int b)\n{\n    int i, s, t;\n    s = 0;\n\n" \
+	    "    for (i = 0; i < a; i = i + 1) {\n" \
+	    "\ts = s + i * %d + b / 4 - h%d[i %% 8] + 0x%x;\n" \
+	    "\tif (s >= 1000 && b != 0 || s <= -1000) s = s - %d;\n    }\n\n" \
+	    "    if (s < 0) printf(\"negative result in func%d: %%d\\n\", s);\n" \
+	    "    g%d = s + a;\n    return s + g%d;\n}\n\n",
+	    n, n, n, n, n % 13 + 1, n, n, n % 97, n, n, n)
+	printf "%s", text
+	bytes += length(text)
+    }
+}' > "$work/input.c"
+
+best() {
+    for run in 1 2 3 4 5; do
+	"$@"
+    done | sort -t, -k3 -n | head -1
+}
+
+echo "mapped file: $(best "$work/lexer" "$work/input.c")"
+echo "piped input: $(best sh -c "cat '$work/input.c' | '$work/lexer'")"
@@ -0,0 +1,40 @@
+#!/bin/sh
+#
+# File:		scope.sh
+#
+# Description:	Measure how the time to compile grows with the number of
+#		symbols in the outermost scope.  Each program has N globals
+#		and N/10 functions, each of which makes ten references to
+#		globals spread over the whole scope, so nearly all of the
+#		time goes to declaring and looking up names.  The time to
+#		compile should double along with N.
+#
+#		usage: bench/scope.sh [scc] [N ...]
+#
+
+dir=$(cd "$(dirname "$0")/.." && pwd)
+scc=${1:-$dir/scc}
+[ $# -gt 0 ] && shift
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' 0
+
+for n in ${*:-12500 25000 50000 100000}; do
+    awk -v n="$n" 'BEGIN {
+	for (i = 0; i < n; i ++)
+	    printf "int g%d;\n", i
+
+	for (i = 0; i < n / 10; i ++) {
+	    printf "int f%d(void) {", i
+
+	    for (k = 0; k < 10; k ++)
+		printf " g%d = g%d + 1;", (i * 7 + k * 13) % n, (i * 7 + (k + 1) % 10 * 13) % n
+
+	    printf " return 0; }\n"
+	}
+    }' > "$work/input.c"
+
+    start=$(date +%s.%N)
+    "$scc" < "$work/input.c" > /dev/null || exit 1
+    end=$(date +%s.%N)
+    echo "$n $start $end" | awk '{ printf "%7d globals  %6.2f s\n", $1, $3 - $2 }'
+done
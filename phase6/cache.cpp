@@ -0,0 +1,440 @@
+/*
+ * File:	cache.cpp
+ *
+ * Description:	This file contains the function definitions for the cache
+ *		of generated functions in Simple C.  The cache is a
+ *		directory of entries, each holding the finished code of a
+ *		function, and may be shared by any number of compilations
+ *		at once, in this process or in others.
+ *
+ *		An entry is found by its key, which describes everything
+ *		the code of a function depends upon, and is stored in a
+ *		file named by a digest of the key.  The key itself is kept
+ *		at the start of the entry and compared when it is read, so
+ *		two keys with the same digest can only ever cost a miss.
+ *		Every key begins with the settings of the compiler and a
+ *		stamp of the compiler itself, so that a different compiler,
+ *		or different options, never use each other's entries.
+ *
+ *		Entries are spread over sixteen directories by the first
+ *		digit of their digest.  An entry is written to a temporary
+ *		file and then renamed into place, so that nobody ever reads
+ *		part of one.  Reading an entry touches it, so the time it
+ *		was last modified is the time it was last used.  Each
+ *		directory may hold a sixteenth of the limit on the size of
+ *		the cache, and each one that has been added to is trimmed
+ *		back under its share by removing the entries least recently
+ *		used, which keeps trimming cheap no matter how large the
+ *		cache grows.
+ *
+ *		Since the keys are easily predicted, anyone who could write
+ *		to the cache could have their own code spliced into our
+ *		output.  The directories are made private to the user, a
+ *		directory that is already there is only used if it is our
+ *		own and nobody else may write to it, and only entries of
+ *		our own are read.
+ */
+
+# include <mutex>
+# include <atomic>
+# include <cerrno>
+# include <cstdint>
+# include <cstdlib>
+# include <cstring>
+# include <ctime>
+# include <vector>
+# include <algorithm>
+# include <fcntl.h>
+# include <dirent.h>
+# include <unistd.h>
+# include <sys/stat.h>
+# include "cache.h"
+
+using namespace std;
+
+struct Record {
+    struct timespec used;
+    off_t size;
+    string name;
+};
+
+static const char digits[] = "0123456789abcdef";
+static const unsigned NUM_DIRS = 16;
+static const unsigned LOW_WATER = 80;		/* percent left by trimming */
+static const time_t STALE = 3600;		/* seconds before a temporary
+						   file is taken as abandoned */
+
+bool cacheFunctions = false;
+
+static string directory, prefix;
+static unsigned long limit;
+
+static atomic<unsigned> dirty, sequence;
+static atomic<unsigned long> numHits, numMisses, numStores, numEvictions;
+static mutex trimLock;
+
+
+/*
+ * Function:	defaultCache
+ *
+ * Description:	Return the directory of the cache to use if none is given,
+ *		which is taken from the environment if it is set there, and
+ *		is otherwise in the cache directory of the user.
+ */
+
+string defaultCache()
+{
+    const char *path = getenv("SCC_CACHE");
+
+
+    if (path != nullptr && *path != '\0')
+	return path;
+
+    if ((path = getenv("XDG_CACHE_HOME")) != nullptr && *path != '\0')
+	return string(path) + "/scc";
+
+    if ((path = getenv("HOME")) != nullptr && *path != '\0')
+	return string(path) + "/.cache/scc";
+
+    return "/tmp/scc-" + to_string(getuid()) + ".cache";
+}
+
+
+/*
+ * Function:	owned (private)
+ *
+ * Description:	Return whether the given path is a directory of our own
+ *		that nobody else may write to, since anything in it might
+ *		end up in our output.  Return false otherwise, with errno
+ *		set.
+ */
+
+static bool owned(const string &path)
+{
+    struct stat st;
+
+
+    if (lstat(path.c_str(), &st) < 0)
+	return false;
+
+    if (!S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 022) != 0) {
+	errno = EACCES;
+	return false;
+    }
+
+    return true;
+}
+
+
+/*
+ * Function:	makeDirectory (private)
+ *
+ * Description:	Make a directory private to the user, along with any
+ *		missing directories above it.  A directory that is already
+ *		there must be our own.  Return false on failure, with errno
+ *		set.
+ */
+
+static bool makeDirectory(const string &path)
+{
+    size_t slash = 0;
+
+
+    while ((slash = path.find('/', slash + 1)) != string::npos)
+	if (mkdir(path.substr(0, slash).c_str(), 0700) < 0 && errno != EEXIST)
+	    return false;
+
+    if (mkdir(path.c_str(), 0700) == 0)
+	return true;
+
+    return errno == EEXIST && owned(path);
+}
+
+
+/*
+ * Function:	digest (private)
+ *
+ * Description:	Return a digest of the given key as thirty-two hexadecimal
+ *		digits.  Two different hashes are taken over the key and
+ *		each is mixed thoroughly at the end, so that keys that
+ *		differ in any way are very unlikely to share a digest.
+ */
+
+static string digest(const string &key)
+{
+    uint64_t hash[2] = {0xcbf29ce484222325, 0x9e3779b97f4a7c15};
+    string result;
+
+
+    for (unsigned char c : key) {
+	hash[0] = (hash[0] ^ c) * 0x100000001b3;
+	hash[1] = ((hash[1] << 5 | hash[1] >> 59) ^ c) * 0xff51afd7ed558ccd;
+    }
+
+    for (auto h : hash) {
+	h ^= key.size();
+	h = (h ^ h >> 33) * 0xff51afd7ed558ccd;
+	h = (h ^ h >> 33) * 0xc4ceb9fe1a85ec53;
+	h ^= h >> 33;
+
+	for (unsigned i = 0; i < 16; i ++, h >>= 4)
+	    result += digits[h & 15];
+    }
+
+    return result;
+}
+
+
+/*
+ * Function:	openCache
+ *
+ * Description:	Start caching functions in the given directory, which is
+ *		made if need be, without letting it grow beyond the given
+ *		number of bytes.  The settings are those options that
+ *		affect the code generated.  Return false if the directory
+ *		can't be made, or if it or any directory in it is not our
+ *		own, with errno set.
+ */
+
+bool openCache(const string &path, unsigned long size, const string &settings)
+{
+    struct stat st;
+
+
+    if (!makeDirectory(path))
+	return false;
+
+    for (unsigned i = 0; i < NUM_DIRS; i ++)
+	if (lstat((path + '/' + digits[i]).c_str(), &st) == 0 && !owned(path + '/' + digits[i]))
+	    return false;
+
+    directory = path;
+    limit = size;
+    prefix = settings + '\n';
+
+    if (stat("/proc/self/exe", &st) == 0) {
+	prefix += to_string(st.st_size) + ' ' + to_string(st.st_mtim.tv_sec);
+	prefix += '.' + to_string(st.st_mtim.tv_nsec) + '\n';
+    } else
+	prefix += __DATE__ " " __TIME__ "\n";
+
+    cacheFunctions = true;
+    return true;
+}
+
+
+/*
+ * Function:	fetchCache
+ *
+ * Description:	Look up the entry with the given key and fill in its data.
+ *		Return false if there is no such entry, or if it is not our
+ *		own.
+ */
+
+bool fetchCache(const string &key, string &data)
+{
+    string name = digest(prefix + key);
+    string path = directory + '/' + name[0] + '/' + name.substr(1);
+    size_t length, header;
+    struct stat st;
+    ssize_t n;
+    int fd;
+
+
+    if ((fd = open(path.c_str(), O_RDONLY | O_CLOEXEC)) < 0) {
+	numMisses ++;
+	return false;
+    }
+
+    header = sizeof(length) + prefix.size() + key.size();
+
+    if (fstat(fd, &st) < 0 || st.st_uid != getuid() || (size_t) st.st_size < header) {
+	close(fd);
+	numMisses ++;
+	return false;
+    }
+
+    data.resize(st.st_size);
+
+    for (size_t done = 0; done < data.size(); ) {
+	n = read(fd, &data[done], data.size() - done);
+
+	if (n < 0 && errno == EINTR)
+	    continue;
+
+	if (n <= 0) {
+	    close(fd);
+	    numMisses ++;
+	    return false;
+	}
+
+	done += n;
+    }
+
+    memcpy(&length, data.data(), sizeof(length));
+
+    if (length != prefix.size() + key.size()
+	    || data.compare(sizeof(length), prefix.size(), prefix) != 0
+	    || data.compare(sizeof(length) + prefix.size(), key.size(), key) != 0) {
+	close(fd);
+	numMisses ++;
+	return false;
+    }
+
+    futimens(fd, nullptr);
+    close(fd);
+
+    data.erase(0, header);
+    numHits ++;
+    return true;
+}
+
+
+/*
+ * Function:	storeCache
+ *
+ * Description:	Store an entry with the given key and data, replacing any
+ *		entry with the same digest.  The cache is only an aid, so a
+ *		failure to store an entry is not an error.
+ */
+
+void storeCache(const string &key, const string &data)
+{
+    string name = digest(prefix + key);
+    string dir = directory + '/' + name[0];
+    string temp, entry;
+    size_t length;
+    int fd;
+
+
+    temp = dir + "/.tmp." + to_string(getpid()) + '.' + to_string(sequence ++);
+    fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+
+    if (fd < 0 && errno == ENOENT && makeDirectory(dir))
+	fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+
+    if (fd < 0)
+	return;
+
+    length = prefix.size() + key.size();
+    entry.reserve(sizeof(length) + length + data.size());
+    entry.append((const char *) &length, sizeof(length));
+    entry += prefix;
+    entry += key;
+    entry += data;
+
+    for (size_t done = 0; done < entry.size(); ) {
+	ssize_t n = write(fd, entry.data() + done, entry.size() - done);
+
+	if (n < 0 && errno == EINTR)
+	    continue;
+
+	if (n <= 0) {
+	    close(fd);
+	    unlink(temp.c_str());
+	    return;
+	}
+
+	done += n;
+    }
+
+    if (close(fd) < 0 || rename(temp.c_str(), (dir + '/' + name.substr(1)).c_str()) < 0) {
+	unlink(temp.c_str());
+	return;
+    }
+
+    dirty |= 1u << (strchr(digits, name[0]) - digits);
+    numStores ++;
+}
+
+
+/*
+ * Function:	trim (private)
+ *
+ * Description:	Trim one directory of the cache, if it holds more than its
+ *		share, by removing its least recently used entries until
+ *		it is comfortably under.  Any temporary file left behind by
+ *		a compilation that never finished is removed as well.
+ */
+
+static void trim(const string &dir)
+{
+    unsigned long share = limit / NUM_DIRS, total;
+    vector<Record> entries;
+    struct dirent *dp;
+    struct stat st;
+    time_t now;
+    DIR *dirp;
+
+
+    if ((dirp = opendir(dir.c_str())) == nullptr)
+	return;
+
+    now = time(nullptr);
+    total = 0;
+
+    while ((dp = readdir(dirp)) != nullptr) {
+	if (fstatat(dirfd(dirp), dp->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0
+		|| !S_ISREG(st.st_mode))
+	    continue;
+
+	if (dp->d_name[0] == '.') {
+	    if (st.st_mtime + STALE < now)
+		unlinkat(dirfd(dirp), dp->d_name, 0);
+
+	} else {
+	    entries.push_back({st.st_mtim, st.st_blocks * 512, dp->d_name});
+	    total += st.st_blocks * 512;
+	}
+    }
+
+    if (total > share) {
+	sort(entries.begin(), entries.end(), [](const Record &a, const Record &b) {
+	    if (a.used.tv_sec != b.used.tv_sec)
+		return a.used.tv_sec < b.used.tv_sec;
+
+	    return a.used.tv_nsec < b.used.tv_nsec;
+	});
+
+	for (unsigned i = 0; i < entries.size() && total > share / 100 * LOW_WATER; i ++)
+	    if (unlinkat(dirfd(dirp), entries[i].name.c_str(), 0) == 0) {
+		total -= entries[i].size;
+		numEvictions ++;
+	    }
+    }
+
+    closedir(dirp);
+}
+
+
+/*
+ * Function:	trimCache
+ *
+ * Description:	Trim each directory of the cache that has had entries
+ *		stored in it since it was last trimmed.
+ */
+
+void trimCache()
+{
+    lock_guard<mutex> guard(trimLock);
+    unsigned dirs = dirty.exchange(0);
+
+
+    for (unsigned i = 0; i < NUM_DIRS; i ++)
+	if (dirs & 1u << i)
+	    trim(directory + '/' + digits[i]);
+}
+
+
+/*
+ * Function:	cacheStatistics
+ *
+ * Description:	Write the number of hits, misses, stores, and evictions to
+ *		the given stream.
+ */
+
+void cacheStatistics(ostream &ostr)
+{
+    ostr << "cache: " << numHits << " hits, " << numMisses << " misses, ";
+    ostr << numStores << " stores, " << numEvictions << " evictions" << endl;
+}
@@ -0,0 +1,25 @@
+/*
+ * File:	cache.h
+ *
+ * Description:	This file contains the function declarations for the cache
+ *		of generated functions in Simple C, which is kept on disk so
+ *		that a function that has not changed need not be generated
+ *		again by a later compilation.
+ */
+
+# ifndef CACHE_H
+# define CACHE_H
+# include <string>
+# include <ostream>
+
+extern bool cacheFunctions;
+
+std::string defaultCache();
+bool openCache(const std::string &directory, unsigned long limit,
+	const std::string &settings);
+bool fetchCache(const std::string &key, std::string &data);
+void storeCache(const std::string &key, const std::string &data);
+void trimCache();
+void cacheStatistics(std::ostream &ostr);
+
+# endif /* CACHE_H */
@@ -8,14 +8,18 @@
  *		- inserting an undeclared symbol with the error type
  *		- scaling the operands and results of pointer arithmetic
  *		- explicit type promotions
+ *		- laying out structures when they are defined
+ *		- folding constants and simplifying identities
  */
 
-# include <map>
-# include <set>
+# include <unordered_map>
+# include <unordered_set>
 # include <cassert>
+# include <climits>
 # include <iostream>
 # include "lexer.h"
 # include "checker.h"
+# include "context.h"
 # include "Symbol.h"
 # include "Scope.h"
 # include "Type.h"
@@ -23,9 +27,6 @@
 
 using namespace std;
 
-static set<string> functions;
-static map<string,Scope *> fields;
-static Scope *outermost, *toplevel;
 static const Type error;
 static const Scalar integer("int"), character("char");
 
@@ -84,15 +85,122 @@ static Expression *scale(Expression *expr, unsigned size)
     if (size == 1)
 	return expr;
 
-    if (expr->isNumber(value)) {
-	delete expr;
+    if (expr->isNumber(value))
 	return new Number(value * size);
-    }
 
     return new Multiply(expr, new Number(size), integer);
 }
 
 
+/*
+ * Function:	constants
+ *
+ * Description:	Return whether both operands are numbers, and if so, their
+ *		values as signed integers.
+ */
+
+static bool constants(Expression *left, Expression *right, int &x, int &y)
+{
+    unsigned a, b;
+
+
+    if (!left->isNumber(a) || !right->isNumber(b))
+	return false;
+
+    x = a;
+    y = b;
+    return true;
+}
+
+
+/*
+ * Function:	isConstant
+ *
+ * Description:	Return whether an expression is the given number.
+ */
+
+static bool isConstant(Expression *expr, unsigned value)
+{
+    unsigned n;
+
+
+    return expr->isNumber(n) && n == value;
+}
+
+
+/*
+ * Function:	rvalue
+ *
+ * Description:	Return an operand that stands for a simplified expression.
+ *		An lvalue is wrapped in a cast of its own type, so that
+ *		"x + 0" cannot be assigned to or have its address taken.
+ */
+
+static Expression *rvalue(Expression *expr)
+{
+    if (expr->lvalue())
+	return new Cast(expr, expr->type());
+
+    return expr;
+}
+
+
+/*
+ * Function:	truth
+ *
+ * Description:	Return the truth value of an expression as an int.
+ */
+
+static Expression *truth(Expression *expr)
+{
+    unsigned n;
+
+
+    if (expr->isNumber(n))
+	return new Number(n != 0);
+
+    return new NotEqual(expr, new Number(0), integer);
+}
+
+
+/*
+ * Function:	add
+ *
+ * Description:	Create an addition, folding constants.  A constant added to
+ *		an addition that already has a constant operand on the
+ *		right is merged with it, so "p + i + 1 + 2" becomes a
+ *		single displacement.  All arithmetic is done on unsigned
+ *		values so that it wraps as in 32 bits.
+ */
+
+static Expression *add(Expression *left, Expression *right, const Type &result)
+{
+    Expression *expr, *number;
+    unsigned x, y;
+
+
+    if (left->isNumber(x) && right->isNumber(y))
+	return new Number(x + y);
+
+    if (right->isNumber(y)) {
+	if (y == 0)
+	    return rvalue(left);
+
+	if (left->isAdd(expr, number) && number->isNumber(x)) {
+	    if (x + y == 0)
+		return rvalue(expr);
+
+	    return new Add(expr, new Number(x + y), result);
+	}
+    }
+
+    if (isConstant(left, 0))
+	return rvalue(right);
+
+    return new Add(left, right, result);
+}
+
+
 /*
  * Function:	isIncompletePointer
  *
@@ -105,7 +213,22 @@ static bool isIncompletePointer(const Type &type)
     if (!type.isScalar() || type.indirection() != 1)
 	return false;
 
-    return type.isStruct() && fields.count(type.specifier()) == 0;
+    return type.isStruct() && context->structs.count(type.specifier()) == 0;
+}
+
+
+/*
+ * Function:	fieldsOf
+ *
+ * Description:	Return the fields of the structure with the specified name,
+ *		or a null pointer if there is no such structure.
+ */
+
+static Scope *fieldsOf(const Name &name)
+{
+    auto it = context->structs.find(name);
+
+    return it != context->structs.end() ? it->second.fields : nullptr;
 }
 
 
@@ -117,12 +240,12 @@ static bool isIncompletePointer(const Type &type)
 
 Scope *openScope()
 {
-    toplevel = new Scope(toplevel);
+    context->toplevel = new Scope(context->toplevel);
 
-    if (outermost == nullptr)
-	outermost = toplevel;
+    if (context->outermost == nullptr)
+	context->outermost = context->toplevel;
 
-    return toplevel;
+    return context->toplevel;
 }
 
 
@@ -135,9 +258,9 @@ Scope *openScope()
 
 Scope *closeScope()
 {
-    Scope *old = toplevel;
+    Scope *old = context->toplevel;
 
-    toplevel = toplevel->enclosing();
+    context->toplevel = context->toplevel->enclosing();
     return old;
 }
 
@@ -146,15 +269,14 @@ Scope *closeScope()
  * Function:	openStruct
  *
  * Description:	Open a scope for a structure with the specified name.  If a
- *		structure with the same name is already defined, delete it.
+ *		structure with the same name is already defined, forget it.
  */
 
-void openStruct(const string &name)
+void openStruct(const Name &name)
 {
-    if (fields.count(name) > 0) {
-	delete fields[name];
-	fields.erase(name);
-	report(redefined, name);
+    if (context->structs.count(name) > 0) {
+	context->structs.erase(name);
+	report(redefined, name.str());
     }
 
     openScope();
@@ -164,25 +286,55 @@ void openStruct(const string &name)
 /*
  * Function:	closeStruct
  *
- * Description:	Close the scope for the structure with the specified name.
+ * Description:	Close the scope for the structure with the specified name,
+ *		and lay out the structure.  Each field is aligned, and is
+ *		assigned its offset, and the entire structure is aligned as
+ *		well.  The alignment of a structure is the maximum
+ *		alignment of its fields.  A field of incomplete type has
+ *		already been reported, so it is given no space.
  */
 
-void closeStruct(const string &name)
+void closeStruct(const Name &name)
 {
-    fields[name] = closeScope();
+    Layout layout = {0, 1, closeScope()};
+    unsigned align;
+
+
+    for (auto symbol : layout.fields->symbols()) {
+	const Type &t = symbol->type();
+
+	if (isStructure(t) && !t.isCallback() && context->structs.count(t.specifier()) == 0)
+	    continue;
+
+	align = t.alignment();
+
+	if (layout.size % align != 0)
+	    layout.size += (align - layout.size % align);
+
+	if (align > layout.alignment)
+	    layout.alignment = align;
+
+	symbol->_offset = layout.size;
+	layout.size += t.size();
+    }
+
+    if (layout.size % layout.alignment != 0)
+	layout.size += (layout.alignment - layout.size % layout.alignment);
+
+    context->structs[name] = layout;
 }
 
 
 /*
- * Function:	getFields
+ * Function:	getLayout
  *
- * Description:	Return the fields associated with the specified structure.
+ * Description:	Return the layout of the specified structure.
  */
 
-Scope *getFields(const string &name)
+const Layout &getLayout(const Name &name)
 {
-    assert(fields.count(name) > 0);
-    return fields[name];
+    assert(context->structs.count(name) > 0);
+    return context->structs[name];
 }
 
 
@@ -196,25 +348,25 @@ Scope *getFields(const string &name)
  *		if desired, the final "else".
  */
 
-void declareSymbol(const string &name, const Type &type, bool isParameter)
+void declareSymbol(const Name &name, const Type &type, bool isParameter)
 {
-    Symbol *symbol = toplevel->find(name);
+    Symbol *symbol = context->toplevel->find(name);
 
     if (symbol == nullptr)
-	toplevel->insert(new Symbol(name, type));
-    else if (toplevel != outermost) {
-	report(redeclared, name);
+	context->toplevel->insert(new Symbol(name, type));
+    else if (context->toplevel != context->outermost) {
+	report(redeclared, name.str());
 	return;
     } else if (type != symbol->type()) {
-	report(conflicting, name);
+	report(conflicting, name.str());
     	return;
     }
 
     if (isStructure(type)) {
 	if (isParameter || type.isCallback() || type.isFunction())
-	    report(nonpointer, name);
-	else if (fields.count(type.specifier()) == 0)
-	    report(incomplete, name);
+	    report(nonpointer, name.str());
+	else if (context->structs.count(type.specifier()) == 0)
+	    report(incomplete, name.str());
     }
 }
 
@@ -227,27 +379,25 @@ void declareSymbol(const string &name, const Type &type, bool isParameter)
  *		definition always replaces any previous definition or
  *		declaration.  In the case of multiple errors, only the
  *		first error is reported.  To report multiple errors, remove
- *		the "else"s.
+ *		the "else"s.  The symbol must outlive the function body, so
+ *		it is always allocated in the permanent arena.
  */
 
-Symbol *defineFunction(const string &name, const Type &type)
+Symbol *defineFunction(const Name &name, const Type &type)
 {
-    Symbol *symbol = outermost->find(name);
+    Symbol *symbol = context->outermost->find(name);
 
-    if (functions.count(name) > 0)
-	report(redefined, name);
+    if (context->functions.count(name) > 0)
+	report(redefined, name.str());
     else if (symbol != nullptr && type != symbol->type())
-	report(conflicting, name);
+	report(conflicting, name.str());
     else if (isStructure(type))
-	report(nonpointer, name);
-
-    outermost->remove(name);
-    delete symbol;
+	report(nonpointer, name.str());
 
-    symbol = new Symbol(name, type);
-    outermost->insert(symbol);
+    symbol = new (context->permanent) Symbol(name, type);
+    context->outermost->replace(symbol);
 
-    functions.insert(name);
+    context->functions.insert(name);
     return symbol;
 }
 
@@ -260,14 +410,14 @@ Symbol *defineFunction(const string &name, const Type &type)
  *		future error messages.
  */
 
-Symbol *checkIdentifier(const string &name)
+Symbol *checkIdentifier(const Name &name)
 {
-    Symbol *symbol = toplevel->lookup(name);
+    Symbol *symbol = context->toplevel->lookup(name);
 
     if (symbol == nullptr) {
-	report(undeclared, name);
+	report(undeclared, name.str());
 	symbol = new Symbol(name, error);
-	toplevel->insert(symbol);
+	context->toplevel->insert(symbol);
     }
 
     return symbol;
@@ -363,22 +513,26 @@ Expression *checkArray(Expression *left, Expression *right)
  *		be a field of that structure, and the result has the type
  *		of the field.  If the identifier is not a member of the
  *		structure, we go ahead and declare it and give it the error
- *		type, so we only get the error once.
+ *		type, so we only get the error once.  The structure
+ *		outlives the function, so the new field is permanent.
  */
 
-Expression *checkDirectField(Expression *expr, const std::string &id)
+Expression *checkDirectField(Expression *expr, const Name &id)
 {
     const Type &t = expr->type();
     Symbol *symbol = nullptr;
+    Scope *fields;
 
 
     if (t != error) {
-	if (t.isStruct() && !t.indirection() && fields.count(t.specifier())) {
-	    symbol = fields[t.specifier()]->find(id);
+	fields = t.isStruct() ? fieldsOf(t.specifier()) : nullptr;
+
+	if (fields != nullptr && !t.indirection()) {
+	    symbol = fields->find(id);
 
 	    if (symbol == nullptr) {
-		symbol = new Symbol(id, error);
-		fields[t.specifier()]->insert(symbol);
+		symbol = new (context->permanent) Symbol(id, error);
+		fields->insert(symbol);
 		report(invalid_operands, ".");
 	    }
 
@@ -405,10 +559,11 @@ Expression *checkDirectField(Expression *expr, const std::string &id)
  *		type, so we only get the error once.
  */
 
-Expression *checkIndirectField(Expression *expr, const std::string &id)
+Expression *checkIndirectField(Expression *expr, const Name &id)
 {
     Type t = promote(expr);
     Symbol *symbol = nullptr;
+    Scope *fields;
 
 
     if (t != error) {
@@ -416,12 +571,13 @@ Expression *checkIndirectField(Expression *expr, const std::string &id)
 	    report(incomplete_type);
 
 	else if (t.isStruct() && t.indirection() == 1) {
-	    symbol = fields[t.specifier()]->find(id);
+	    fields = fieldsOf(t.specifier());
+	    symbol = fields->find(id);
 	    t = t.deref();
 
 	    if (symbol == nullptr) {
-		symbol = new Symbol(id, error);
-		fields[t.specifier()]->insert(symbol);
+		symbol = new (context->permanent) Symbol(id, error);
+		fields->insert(symbol);
 		report(invalid_operands, "->");
 	    }
 
@@ -456,6 +612,17 @@ Expression *checkNot(Expression *expr)
 	    report(invalid_operand, "!");
     }
 
+    if (result != error) {
+	Expression *inner;
+	unsigned n;
+
+	if (expr->isNumber(n))
+	    return new Number(n == 0);
+
+	if (expr->isNot(inner))
+	    return truth(inner);
+    }
+
     return new Not(expr, result);
 }
 
@@ -480,6 +647,17 @@ Expression *checkNegate(Expression *expr)
 	    report(invalid_operand, "-");
     }
 
+    if (result != error) {
+	Expression *inner;
+	unsigned n;
+
+	if (expr->isNumber(n))
+	    return new Number(-n);
+
+	if (expr->isNegate(inner))
+	    return rvalue(inner);
+    }
+
     return new Negate(expr, result);
 }
 
@@ -516,13 +694,15 @@ Expression *checkDereference(Expression *expr)
  *
  * Description:	Check an address expression: & expr.  The operand must be
  *		an lvalue, and if it has type T, then the result has type
- *		"pointer to T," where T cannot be a callback.
+ *		"pointer to T," where T cannot be a callback.  A variable
+ *		whose address is taken escapes, and must live in memory.
  */
 
 Expression *checkAddress(Expression *expr)
 {
     const Type &t = expr->type();
     Type result = error;
+    Symbol *symbol;
 
 
     if (t != error) {
@@ -534,6 +714,9 @@ Expression *checkAddress(Expression *expr)
 	    result = Scalar(t.specifier(), t.indirection() + 1);
     }
 
+    if (expr->isIdentifier(symbol))
+	symbol->_addressed = true;
+
     return new Address(expr, result);
 }
 
@@ -553,7 +736,7 @@ Expression *checkSizeof(const Type &type)
     }
 
     if (type.isStruct() && type.indirection() == 0)
-	if (fields.count(type.specifier()) == 0) {
+	if (context->structs.count(type.specifier()) == 0) {
 	    report(invalid_operand, "sizeof");
 	    return new Number(0);
 	}
@@ -624,6 +807,26 @@ Type checkMultiplicative(Expression *&left, Expression *&right, const string &op
 Expression *checkMultiply(Expression *left, Expression *right)
 {
     Type t = checkMultiplicative(left, right, "*");
+    unsigned x, y;
+
+
+    if (t != error) {
+	if (left->isNumber(x) && right->isNumber(y))
+	    return new Number(x * y);
+
+	if (isConstant(right, 1))
+	    return rvalue(left);
+
+	if (isConstant(left, 1))
+	    return rvalue(right);
+
+	if (isConstant(right, 0) && !left->_hasCall)
+	    return right;
+
+	if (isConstant(left, 0) && !right->_hasCall)
+	    return left;
+    }
+
     return new Multiply(left, right, t);
 }
 
@@ -637,6 +840,17 @@ Expression *checkMultiply(Expression *left, Expression *right)
 Expression *checkDivide(Expression *left, Expression *right)
 {
     Type t = checkMultiplicative(left, right, "/");
+    int x, y;
+
+
+    if (t != error) {
+	if (constants(left, right, x, y) && y != 0 && (x != INT_MIN || y != -1))
+	    return new Number(x / y);
+
+	if (isConstant(right, 1))
+	    return rvalue(left);
+    }
+
     return new Divide(left, right, t);
 }
 
@@ -650,6 +864,17 @@ Expression *checkDivide(Expression *left, Expression *right)
 Expression *checkRemainder(Expression *left, Expression *right)
 {
     Type t = checkMultiplicative(left, right, "%");
+    int x, y;
+
+
+    if (t != error) {
+	if (constants(left, right, x, y) && y != 0 && (x != INT_MIN || y != -1))
+	    return new Number(x % y);
+
+	if (isConstant(right, 1) && !left->_hasCall)
+	    return new Number(0);
+    }
+
     return new Remainder(left, right, t);
 }
 
@@ -690,6 +915,9 @@ Expression *checkAdd(Expression *left, Expression *right)
 	    report(invalid_operands, "+");
     }
 
+    if (result != error)
+	return add(left, right, result);
+
     return new Add(left, right, result);
 }
 
@@ -712,6 +940,7 @@ Expression *checkSubtract(Expression *left, Expression *right)
     const Type &t2 = promote(right);
     Type result = error;
     Type deref;
+    unsigned value;
 
 
     if (t1 != error && t2 != error) {
@@ -732,6 +961,9 @@ Expression *checkSubtract(Expression *left, Expression *right)
 	    report(invalid_operands, "-");
     }
 
+    if (result != error && right->isNumber(value))
+	return add(left, new Number(-value), result);
+
     tree = new Subtract(left, right, result);
 
     if (t1.isPointer() && t1 == t2 && t1.deref().size() != 1)
@@ -777,6 +1009,12 @@ static Type checkComparative(Expression *&left, Expression *&right,
 Expression *checkEqual(Expression *left, Expression *right)
 {
     Type t = checkComparative(left, right, "==");
+    int x, y;
+
+
+    if (t != error && constants(left, right, x, y))
+	return new Number(x == y);
+
     return new Equal(left, right, t);
 }
 
@@ -790,6 +1028,12 @@ Expression *checkEqual(Expression *left, Expression *right)
 Expression *checkNotEqual(Expression *left, Expression *right)
 {
     Type t = checkComparative(left, right, "!=");
+    int x, y;
+
+
+    if (t != error && constants(left, right, x, y))
+	return new Number(x != y);
+
     return new NotEqual(left, right, t);
 }
 
@@ -803,6 +1047,12 @@ Expression *checkNotEqual(Expression *left, Expression *right)
 Expression *checkLessThan(Expression *left, Expression *right)
 {
     Type t = checkComparative(left, right, "<");
+    int x, y;
+
+
+    if (t != error && constants(left, right, x, y))
+	return new Number(x < y);
+
     return new LessThan(left, right, t);
 }
 
@@ -816,6 +1066,12 @@ Expression *checkLessThan(Expression *left, Expression *right)
 Expression *checkGreaterThan(Expression *left, Expression *right)
 {
     Type t = checkComparative(left, right, ">");
+    int x, y;
+
+
+    if (t != error && constants(left, right, x, y))
+	return new Number(x > y);
+
     return new GreaterThan(left, right, t);
 }
 
@@ -829,6 +1085,12 @@ Expression *checkGreaterThan(Expression *left, Expression *right)
 Expression *checkLessOrEqual(Expression *left, Expression *right)
 {
     Type t = checkComparative(left, right, "<=");
+    int x, y;
+
+
+    if (t != error && constants(left, right, x, y))
+	return new Number(x <= y);
+
     return new LessOrEqual(left, right, t);
 }
 
@@ -842,6 +1104,12 @@ Expression *checkLessOrEqual(Expression *left, Expression *right)
 Expression *checkGreaterOrEqual(Expression *left, Expression *right)
 {
     Type t = checkComparative(left, right, ">=");
+    int x, y;
+
+
+    if (t != error && constants(left, right, x, y))
+	return new Number(x >= y);
+
     return new GreaterOrEqual(left, right, t);
 }
 
@@ -882,6 +1150,17 @@ Type checkLogical(Expression *&left, Expression *&right, const string &op)
 Expression *checkLogicalAnd(Expression *left, Expression *right)
 {
     Type t = checkLogical(left, right, "&&");
+    unsigned x;
+
+
+    if (t != error) {
+	if (left->isNumber(x))
+	    return x != 0 ? truth(right) : left;
+
+	if (right->isNumber(x) && x != 0)
+	    return truth(left);
+    }
+
     return new LogicalAnd(left, right, t);
 }
 
@@ -895,6 +1174,17 @@ Expression *checkLogicalAnd(Expression *left, Expression *right)
 Expression *checkLogicalOr(Expression *left, Expression *right)
 {
     Type t = checkLogical(left, right, "||");
+    unsigned x;
+
+
+    if (t != error) {
+	if (left->isNumber(x))
+	    return x != 0 ? new Number(1) : truth(right);
+
+	if (right->isNumber(x) && x == 0)
+	    return truth(left);
+    }
+
     return new LogicalOr(left, right, t);
 }
 
@@ -2,30 +2,38 @@
  * File:	checker.h
  *
  * Description:	This file contains the public function declarations for the
- *		semantic checker for Simple C.
+ *		semantic checker for Simple C.  The layout of a structure
+ *		gives its size and alignment, and its fields, each of which
+ *		has its offset within the structure.
  */
 
 # ifndef CHECKER_H
 # define CHECKER_H
-# include <string>
+# include "Name.h"
 # include "Scope.h"
 # include "Tree.h"
 
+struct Layout {
+    unsigned size;
+    unsigned alignment;
+    Scope *fields;
+};
+
 Scope *openScope();
 Scope *closeScope();
 
-void openStruct(const std::string &name);
-void closeStruct(const std::string &name);
-Scope *getFields(const std::string &name);
+void openStruct(const Name &name);
+void closeStruct(const Name &name);
+const Layout &getLayout(const Name &name);
 
-void declareSymbol(const std::string &name, const Type &type, bool = false);
-Symbol *defineFunction(const std::string &name, const Type &type);
-Symbol *checkIdentifier(const std::string &name);
+void declareSymbol(const Name &name, const Type &type, bool = false);
+Symbol *defineFunction(const Name &name, const Type &type);
+Symbol *checkIdentifier(const Name &name);
 
 Expression *checkCall(Expression *expr, Expressions &args);
 Expression *checkArray(Expression *left, Expression *right);
-Expression *checkDirectField(Expression *expr, const std::string &id);
-Expression *checkIndirectField(Expression *expr, const std::string &id);
+Expression *checkDirectField(Expression *expr, const Name &id);
+Expression *checkIndirectField(Expression *expr, const Name &id);
 Expression *checkNot(Expression *expr);
 Expression *checkNegate(Expression *expr);
 Expression *checkDereference(Expression *expr);
@@ -0,0 +1,31 @@
+/*
+ * File:	context.cpp
+ *
+ * Description:	This file contains the member function definitions for
+ *		the context of a compilation in Simple C, along with the
+ *		context of each thread.
+ */
+
+# include <cstdio>
+# include <iostream>
+# include "context.h"
+
+using namespace std;
+
+thread_local CompilerContext *context;
+
+
+/*
+ * Function:	CompilerContext::CompilerContext (constructor)
+ *
+ * Description:	Initialize a context for compiling a new translation unit,
+ *		which writes to the standard output unless its emitter is
+ *		opened on a file, and reports errors to the standard error.
+ */
+
+CompilerContext::CompilerContext()
+    : errors(&cerr), cp(nullptr), limit(nullptr), c(EOF), lineno(1), numerrors(0),
+      lookahead(0), outermost(nullptr), toplevel(nullptr), offset(0),
+      numLabels(0), numStrings(0)
+{
+}
@@ -0,0 +1,95 @@
+/*
+ * File:	context.h
+ *
+ * Description:	This file contains the class definition for the context
+ *		of a compilation in Simple C, which holds everything that
+ *		belongs to a single translation unit: the position of the
+ *		lexer, the lookahead of the parser, the scopes and
+ *		structures of the checker, the strings and unwritten
+ *		functions of the code generator, the key of the function
+ *		being cached, and the arenas and the emitter.
+ *
+ *		Each thread compiles in the context it is given, so any
+ *		number of units may be compiled one after another, or at
+ *		once on different threads, by giving each its own context.
+ *		The tables of names and types, the options, and the
+ *		statistics are shared by every context.
+ */
+
+# ifndef CONTEXT_H
+# define CONTEXT_H
+# include <deque>
+# include <ostream>
+# include <string>
+# include <vector>
+# include <utility>
+# include <string_view>
+# include <unordered_map>
+# include <unordered_set>
+# include "assembly.h"
+# include "checker.h"
+# include "emitter.h"
+# include "arena.h"
+# include "label.h"
+# include "Name.h"
+# include "Type.h"
+
+struct Job;
+
+class CompilerContext {
+    CompilerContext(const CompilerContext &);
+    CompilerContext &operator =(const CompilerContext &);
+
+public:
+    CompilerContext();
+
+    /* The name of the unit, if any, the stream for its errors, and the
+       time of each pass over it */
+
+    std::string name;
+    std::ostream *errors;
+    std::vector<double> times;
+
+    /* The lexer */
+
+    const char *cp, *limit;
+    int c, lineno, numerrors;
+
+    /* The parser */
+
+    int lookahead;
+    std::string_view lexbuf;
+    Name lexname;
+    Type returnType;
+
+    /* The checker */
+
+    std::unordered_set<Name> functions;
+    std::unordered_map<Name, Layout> structs;
+    Scope *outermost, *toplevel;
+
+    /* The code generator */
+
+    int offset;
+    Assembly code;
+    std::deque<Job *> pending;
+    std::unordered_map<Name, unsigned> strings;
+    std::vector<Label> stringLabels;
+    std::vector<std::pair<Name, Label>> literals;
+    unsigned numLabels, numStrings;
+
+    /* The cache, which keys each function by its tokens and the names
+       they use */
+
+    std::string fingerprint;
+    std::vector<Name> references;
+
+    /* The memory and output */
+
+    Arena permanent, transient;
+    Emitter emitter;
+};
+
+extern thread_local CompilerContext *context;
+
+# endif /* CONTEXT_H */
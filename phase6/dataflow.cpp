@@ -0,0 +1,547 @@
+/*
+ * File:	dataflow.cpp
+ *
+ * Description:	This file contains the control-flow graph and the
+ *		bit-vector dataflow framework for Simple C.  The graph is
+ *		built from the basic blocks of the code for a function:
+ *		a block ending in a branch has its target as a successor,
+ *		and any block not ending in an unconditional jump or return
+ *		also has the block after it.  The instructions of the
+ *		function are numbered consecutively across the blocks.
+ *
+ *		A problem is solved by iterating over the blocks until
+ *		none of their sets change, visiting them in order for a
+ *		forward problem and in reverse order for a backward one,
+ *		which is nearly always the order in which the values flow.
+ *		Three problems are provided: live registers, reaching
+ *		definitions, and available expressions.
+ */
+
+# include <map>
+# include <tuple>
+# include <climits>
+# include <algorithm>
+# include "dataflow.h"
+
+using namespace std;
+
+static thread_local vector<int> labels;
+static thread_local int lowest;
+static thread_local vector<unsigned> counts;
+
+
+/*
+ * Function:	read (private)
+ *
+ * Description:	Note the registers read by an operand used as a source.
+ */
+
+static void read(const Operand &op, Effects &fx)
+{
+    if (op.kind == Operand::REGISTER)
+	fx.uses[fx.nuses ++] = op.base;
+
+    else if (op.kind == Operand::MEMORY) {
+	if (op.base != NOREG)
+	    fx.uses[fx.nuses ++] = op.base;
+
+	if (op.index != NOREG)
+	    fx.uses[fx.nuses ++] = op.index;
+    }
+}
+
+
+/*
+ * Function:	write (private)
+ *
+ * Description:	Note the registers written by an operand used as a
+ *		destination.  A memory destination reads its address.
+ */
+
+static void write(const Operand &op, Effects &fx)
+{
+    if (op.kind == Operand::REGISTER)
+	fx.defs[fx.ndefs ++] = op.base;
+    else
+	read(op, fx);
+}
+
+
+/*
+ * Function:	effects
+ *
+ * Description:	Determine the registers read and written by an
+ *		instruction, including those it uses implicitly.  The only
+ *		jump to a named label is to the epilogue, which returns the
+ *		value in %eax.  Falling off the end of a function returns
+ *		nothing, so the return itself doesn't count as a use.
+ */
+
+void effects(const Instruction &insn, Effects &fx)
+{
+    fx.nuses = fx.ndefs = 0;
+
+    switch (insn.opcode) {
+    case MOVL: case MOVB: case MOVSBL: case MOVZBL: case LEAL: case POPL:
+    case SETE: case SETNE: case SETL: case SETG: case SETLE: case SETGE:
+	read(insn.src, fx);
+	write(insn.dst, fx);
+	break;
+
+    case IMULL:
+	if (insn.dst.kind == Operand::NONE) {
+	    read(insn.src, fx);
+	    fx.uses[fx.nuses ++] = EAX;
+	    fx.defs[fx.ndefs ++] = EAX;
+	    fx.defs[fx.ndefs ++] = EDX;
+	    break;
+	}
+
+	/* fall through */
+
+    case ADDL: case SUBL: case NEGL: case SHLL: case SARL: case SHRL:
+	read(insn.src, fx);
+	read(insn.dst, fx);
+	write(insn.dst, fx);
+	break;
+
+    case CLTD:
+	fx.uses[fx.nuses ++] = EAX;
+	fx.defs[fx.ndefs ++] = EDX;
+	break;
+
+    case IDIVL:
+	read(insn.src, fx);
+	fx.uses[fx.nuses ++] = EAX;
+	fx.uses[fx.nuses ++] = EDX;
+	fx.defs[fx.ndefs ++] = EAX;
+	fx.defs[fx.ndefs ++] = EDX;
+	break;
+
+    case CALL:
+	read(insn.src, fx);
+	fx.defs[fx.ndefs ++] = EAX;
+	fx.defs[fx.ndefs ++] = ECX;
+	fx.defs[fx.ndefs ++] = EDX;
+	break;
+
+    case JMP:
+	read(insn.src, fx);
+
+	if (insn.src.kind == Operand::TARGET && insn.src.symbol.id() != 0)
+	    fx.uses[fx.nuses ++] = EAX;
+
+	break;
+
+    default:
+	read(insn.src, fx);
+	read(insn.dst, fx);
+	break;
+    }
+}
+
+
+/*
+ * Function:	target (private)
+ *
+ * Description:	Return the block at the target of a branch.  The labels of
+ *		a function are numbered consecutively, so the blocks are
+ *		indexed by their label less the lowest one.
+ */
+
+static int target(const FlowGraph &graph, const Assembly &code, const Operand &op)
+{
+    if (op.label >= 0) {
+	unsigned i = op.label - lowest;
+	return i < labels.size() ? labels[i] : -1;
+    }
+
+    return op == code.exit() ? graph.exitBlock : -1;
+}
+
+
+/*
+ * Function:	buildGraph
+ *
+ * Description:	Build the control-flow graph of the code for a function:
+ *		number its instructions, find the successors and
+ *		predecessors of every block, and count the registers used.
+ */
+
+void buildGraph(FlowGraph &graph, const Assembly &code)
+{
+    const BasicBlocks &blocks = code.blocks();
+    unsigned b, i, n = 0;
+    int highest = INT_MIN;
+
+
+    graph.numBlocks = blocks.size();
+    graph.numRegs = NUM_REGS;
+    graph.exitBlock = -1;
+    graph.first.resize(graph.numBlocks);
+    graph.last.resize(graph.numBlocks);
+    graph.succs.resize(2 * graph.numBlocks);
+    lowest = INT_MAX;
+
+    for (b = 0; b < graph.numBlocks; b ++)
+	if (blocks[b].label.label >= 0) {
+	    lowest = min(lowest, blocks[b].label.label);
+	    highest = max(highest, blocks[b].label.label);
+	}
+
+    labels.assign(lowest <= highest ? highest - lowest + 1 : 0, -1);
+
+    for (b = 0; b < graph.numBlocks; b ++) {
+	const Operand &label = blocks[b].label;
+
+	if (label.label >= 0)
+	    labels[label.label - lowest] = b;
+	else if (label.kind != Operand::NONE && label == code.exit())
+	    graph.exitBlock = b;
+
+	graph.first[b] = n;
+	n += blocks[b].instructions.size();
+	graph.last[b] = n;
+
+	for (auto &insn : blocks[b].instructions) {
+	    graph.numRegs = max(graph.numRegs, max(insn.src.base, insn.src.index) + 1);
+	    graph.numRegs = max(graph.numRegs, max(insn.dst.base, insn.dst.index) + 1);
+	}
+    }
+
+    graph.numInsns = n;
+    counts.assign(graph.numBlocks + 1, 0);
+
+    for (b = 0; b < graph.numBlocks; b ++) {
+	const Instructions &insns = blocks[b].instructions;
+	Opcode opcode = insns.empty() ? MOVL : insns.back().opcode;
+	int *succ = &graph.succs[2 * b];
+
+	succ[0] = succ[1] = -1;
+
+	if (opcode == RET)
+	    continue;
+
+	if (opcode >= JMP && opcode <= JGE)
+	    succ[0] = target(graph, code, insns.back().src);
+
+	if (opcode != JMP && b + 1 < graph.numBlocks)
+	    succ[1] = b + 1;
+
+	for (i = 0; i < 2; i ++)
+	    if (succ[i] >= 0)
+		counts[succ[i] + 1] ++;
+    }
+
+    for (b = 0; b < graph.numBlocks; b ++)
+	counts[b + 1] += counts[b];
+
+    graph.predStart.assign(counts.begin(), counts.end());
+    graph.preds.resize(counts[graph.numBlocks]);
+
+    for (b = 0; b < graph.numBlocks; b ++)
+	for (i = 0; i < 2; i ++)
+	    if (graph.succs[2 * b + i] >= 0)
+		graph.preds[counts[graph.succs[2 * b + i]] ++] = b;
+}
+
+
+/*
+ * Function:	initialize
+ *
+ * Description:	Size the sets of a problem for the blocks of a graph, with
+ *		nothing generated or killed.
+ */
+
+void initialize(Dataflow &problem, const FlowGraph &graph, unsigned numBits)
+{
+    unsigned size;
+
+
+    problem.numBits = numBits;
+    problem.numWords = (numBits + BITS - 1) / BITS;
+
+    size = graph.numBlocks * problem.numWords;
+    problem.gen.assign(size, 0);
+    problem.kill.assign(size, 0);
+}
+
+
+/*
+ * Function:	solve
+ *
+ * Description:	Solve a dataflow problem over a graph.  The sets at the
+ *		boundary, on entry to the function for a forward problem
+ *		and on exit from it for a backward one, are empty.  The
+ *		other sets start out full for an intersection, so that
+ *		loops do not lose what holds around them, and empty for a
+ *		union.
+ */
+
+void solve(Dataflow &problem, const FlowGraph &graph)
+{
+    unsigned b, i, w, n = graph.numBlocks, words = problem.numWords;
+    Word all = problem.intersect ? ~(Word) 0 : 0;
+    vector<Word> &before = problem.forward ? problem.in : problem.out;
+    vector<Word> &after = problem.forward ? problem.out : problem.in;
+    bool changed;
+
+
+    before.assign(n * words, all);
+    after.assign(n * words, all);
+
+    do {
+	changed = false;
+
+	for (unsigned k = 0; k < n; k ++) {
+	    b = problem.forward ? k : n - 1 - k;
+
+	    Word *x = &before[b * words], *y = &after[b * words];
+	    const Word *gen = &problem.gen[b * words], *kill = &problem.kill[b * words];
+	    bool first = true;
+
+	    if (problem.forward) {
+		for (i = graph.predStart[b]; i < graph.predStart[b + 1]; i ++) {
+		    const Word *s = &after[graph.preds[i] * words];
+
+		    for (w = 0; w < words; w ++)
+			x[w] = first ? s[w] : problem.intersect ? x[w] & s[w] : x[w] | s[w];
+
+		    first = false;
+		}
+
+		if (first || b == 0)
+		    fill(x, x + words, 0);
+
+	    } else {
+		for (i = 0; i < 2; i ++)
+		    if (graph.succs[2 * b + i] >= 0) {
+			const Word *s = &after[graph.succs[2 * b + i] * words];
+
+			for (w = 0; w < words; w ++)
+			    x[w] = first ? s[w] : problem.intersect ? x[w] & s[w] : x[w] | s[w];
+
+			first = false;
+		    }
+
+		if (first)
+		    fill(x, x + words, 0);
+	    }
+
+	    for (w = 0; w < words; w ++) {
+		Word z = gen[w] | (x[w] & ~kill[w]);
+
+		if (z != y[w]) {
+		    y[w] = z;
+		    changed = true;
+		}
+	    }
+	}
+    } while (changed);
+}
+
+
+/*
+ * Function:	liveness
+ *
+ * Description:	Compute the registers live on entry to and exit from
+ *		every block.  A register is live if it may be read before
+ *		it is next written.  This is a backward problem, where a
+ *		block generates the registers it reads before writing them
+ *		and kills those it writes.
+ */
+
+void liveness(Dataflow &problem, const FlowGraph &graph, const Assembly &code)
+{
+    const BasicBlocks &blocks = code.blocks();
+    unsigned b, i, words;
+    Effects fx;
+
+
+    problem.forward = false;
+    problem.intersect = false;
+    initialize(problem, graph, graph.numRegs);
+    words = problem.numWords;
+
+    for (b = 0; b < graph.numBlocks; b ++) {
+	Word *use = &problem.gen[b * words], *def = &problem.kill[b * words];
+
+	for (auto &insn : blocks[b].instructions) {
+	    effects(insn, fx);
+
+	    for (i = 0; i < fx.nuses; i ++)
+		if (!has(def, fx.uses[i]))
+		    add(use, fx.uses[i]);
+
+	    for (i = 0; i < fx.ndefs; i ++)
+		add(def, fx.defs[i]);
+	}
+    }
+
+    solve(problem, graph);
+}
+
+
+/*
+ * Function:	reaching
+ *
+ * Description:	Compute the definitions reaching the entry to and exit
+ *		from every block.  Each instruction that writes a register
+ *		is a definition, whose bit is the number of the
+ *		instruction.  A definition reaches a point if there is a
+ *		path to it along which its register is not written again.
+ */
+
+void reaching(Dataflow &problem, const FlowGraph &graph, const Assembly &code)
+{
+    const BasicBlocks &blocks = code.blocks();
+    vector<unsigned> start(graph.numRegs + 1, 0), sites;
+    unsigned b, i, j, p, words;
+    Effects fx;
+
+
+    problem.forward = true;
+    problem.intersect = false;
+    initialize(problem, graph, graph.numInsns);
+    words = problem.numWords;
+
+    for (b = 0; b < graph.numBlocks; b ++)
+	for (auto &insn : blocks[b].instructions) {
+	    effects(insn, fx);
+
+	    for (i = 0; i < fx.ndefs; i ++)
+		start[fx.defs[i] + 1] ++;
+	}
+
+    for (i = 0; i < (unsigned) graph.numRegs; i ++)
+	start[i + 1] += start[i];
+
+    sites.resize(start[graph.numRegs]);
+    vector<unsigned> next(start.begin(), start.end() - 1);
+
+    for (b = 0; b < graph.numBlocks; b ++)
+	for (p = graph.first[b]; p < graph.last[b]; p ++) {
+	    effects(blocks[b].instructions[p - graph.first[b]], fx);
+
+	    for (i = 0; i < fx.ndefs; i ++)
+		sites[next[fx.defs[i]] ++] = p;
+	}
+
+    for (b = 0; b < graph.numBlocks; b ++) {
+	Word *gen = &problem.gen[b * words], *kill = &problem.kill[b * words];
+
+	for (p = graph.first[b]; p < graph.last[b]; p ++) {
+	    effects(blocks[b].instructions[p - graph.first[b]], fx);
+
+	    for (i = 0; i < fx.ndefs; i ++)
+		for (j = start[fx.defs[i]]; j < start[fx.defs[i] + 1]; j ++) {
+		    add(kill, sites[j]);
+		    remove(gen, sites[j]);
+		}
+
+	    if (fx.ndefs > 0)
+		add(gen, p);
+	}
+    }
+
+    solve(problem, graph);
+}
+
+
+/*
+ * Function:	available
+ *
+ * Description:	Compute the expressions available on entry to and exit
+ *		from every block.  The expressions are the sources of the
+ *		loads and address computations into registers, which are
+ *		returned in the order of their bits.  An expression is
+ *		available at a point if it has been computed along every
+ *		path to it, and none of the registers it reads has been
+ *		written since.  A load is also killed by a store or a call,
+ *		either of which could change the memory it reads.
+ */
+
+void available(Dataflow &problem, const FlowGraph &graph, const Assembly &code, vector<Operand> &exprs)
+{
+    typedef tuple<int, int, int, int, int, int, unsigned> Key;
+
+    const BasicBlocks &blocks = code.blocks();
+    map<Key, unsigned> numbers;
+    vector<vector<unsigned>> readers(graph.numRegs);
+    vector<unsigned> bits, loads;
+    unsigned b, i, words;
+    Effects fx;
+
+
+    exprs.clear();
+
+    for (b = 0; b < graph.numBlocks; b ++)
+	for (auto &insn : blocks[b].instructions) {
+	    const Operand &op = insn.src;
+
+	    if (insn.dst.kind != Operand::REGISTER || op.kind != Operand::MEMORY)
+		continue;
+
+	    if (insn.opcode != MOVL && insn.opcode != MOVSBL && insn.opcode != MOVZBL && insn.opcode != LEAL)
+		continue;
+
+	    Key key(insn.opcode, op.base, op.index, op.scale, op.value, op.label, op.symbol.id());
+
+	    if (numbers.count(key) == 0) {
+		numbers[key] = exprs.size();
+		exprs.push_back(op);
+
+		if (op.base != NOREG)
+		    readers[op.base].push_back(exprs.size() - 1);
+
+		if (op.index != NOREG)
+		    readers[op.index].push_back(exprs.size() - 1);
+
+		if (insn.opcode != LEAL)
+		    loads.push_back(exprs.size() - 1);
+	    }
+	}
+
+    problem.forward = true;
+    problem.intersect = true;
+    initialize(problem, graph, exprs.size());
+    words = problem.numWords;
+
+    for (b = 0; b < graph.numBlocks; b ++) {
+	Word *gen = &problem.gen[b * words], *kill = &problem.kill[b * words];
+
+	for (auto &insn : blocks[b].instructions) {
+	    effects(insn, fx);
+	    bits.clear();
+
+	    if (insn.dst.kind == Operand::MEMORY || insn.opcode == CALL)
+		bits.insert(bits.end(), loads.begin(), loads.end());
+
+	    for (i = 0; i < fx.ndefs; i ++)
+		bits.insert(bits.end(), readers[fx.defs[i]].begin(), readers[fx.defs[i]].end());
+
+	    for (auto bit : bits) {
+		add(kill, bit);
+		remove(gen, bit);
+	    }
+
+	    if (insn.dst.kind == Operand::REGISTER && insn.src.kind == Operand::MEMORY) {
+		Key key(insn.opcode, insn.src.base, insn.src.index, insn.src.scale, insn.src.value, insn.src.label, insn.src.symbol.id());
+		auto k = numbers.find(key);
+
+		if (k != numbers.end()) {
+		    bool clobbered = false;
+
+		    for (i = 0; i < fx.ndefs; i ++)
+			if (fx.defs[i] == insn.src.base || fx.defs[i] == insn.src.index)
+			    clobbered = true;
+
+		    if (!clobbered)
+			add(gen, k->second);
+		}
+	    }
+	}
+    }
+
+    solve(problem, graph);
+}
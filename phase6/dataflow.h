@@ -0,0 +1,69 @@
+/*
+ * File:	dataflow.h
+ *
+ * Description:	This file contains the declarations for the control-flow
+ *		graph of a function and the bit-vector dataflow framework
+ *		over it.  The graph has one node for every basic block of
+ *		the code, with edges for branches and fall-throughs.  A
+ *		dataflow problem is a set of bits for each block generated
+ *		and killed by it, a direction, and a meet operator; solving
+ *		it gives the set on entry to and exit from every block.
+ */
+
+# ifndef DATAFLOW_H
+# define DATAFLOW_H
+# include <cstdint>
+# include <vector>
+# include "assembly.h"
+
+typedef std::uint64_t Word;
+
+const unsigned BITS = 64;
+
+struct Effects {
+    int uses[8], defs[4];
+    unsigned nuses, ndefs;
+};
+
+struct FlowGraph {
+    unsigned numBlocks, numInsns;
+    int numRegs, exitBlock;
+    std::vector<unsigned> first, last;	/* instructions of each block */
+    std::vector<int> succs;		/* two successors per block */
+    std::vector<int> preds;		/* predecessors of each block */
+    std::vector<unsigned> predStart;	/* first predecessor of each block */
+};
+
+struct Dataflow {
+    bool forward;			/* propagates from entry to exit */
+    bool intersect;			/* meet is intersection, not union */
+    unsigned numBits, numWords;
+    std::vector<Word> gen, kill, in, out;
+};
+
+inline bool has(const Word *set, int bit)
+{
+    return (set[bit / BITS] >> (bit % BITS)) & 1;
+}
+
+inline void add(Word *set, int bit)
+{
+    set[bit / BITS] |= (Word) 1 << (bit % BITS);
+}
+
+inline void remove(Word *set, int bit)
+{
+    set[bit / BITS] &= ~((Word) 1 << (bit % BITS));
+}
+
+void effects(const Instruction &insn, Effects &fx);
+
+void buildGraph(FlowGraph &graph, const Assembly &code);
+void initialize(Dataflow &problem, const FlowGraph &graph, unsigned numBits);
+void solve(Dataflow &problem, const FlowGraph &graph);
+
+void liveness(Dataflow &problem, const FlowGraph &graph, const Assembly &code);
+void reaching(Dataflow &problem, const FlowGraph &graph, const Assembly &code);
+void available(Dataflow &problem, const FlowGraph &graph, const Assembly &code, std::vector<Operand> &exprs);
+
+# endif /* DATAFLOW_H */
@@ -0,0 +1,195 @@
+/*
+ * File:	deadcode.cpp
+ *
+ * Description:	This file contains the removal of dead code for Simple C,
+ *		which is built upon the control-flow graph and dataflow
+ *		framework.  A block that cannot be reached from the entry
+ *		to the function is removed, as is the code after a return
+ *		statement, which always starts a block of its own.  An
+ *		instruction whose only effect is to write virtual registers
+ *		that are not live afterward is also removed.  That can
+ *		leave the instructions computing its operands dead as well,
+ *		which the backward sweep over a block finds by itself unless
+ *		they are in another block, in which case we repeat.
+ *
+ *		Real registers are left alone, since they carry the return
+ *		value and the operands of division and calls.  The
+ *		condition codes are not considered, since the code
+ *		generator always compares immediately before it branches.
+ */
+
+# include <atomic>
+# include <algorithm>
+# include "deadcode.h"
+# include "dataflow.h"
+
+using namespace std;
+
+static thread_local FlowGraph graph;
+static thread_local Dataflow live;
+static thread_local vector<char> reached, dead;
+static thread_local vector<int> pending;
+static thread_local vector<Word> alive;
+
+static atomic<unsigned long> numBlocks, numInsns;
+
+
+/*
+ * Function:	removeUnreachable
+ *
+ * Description:	Remove the blocks of a function that cannot be reached
+ *		from its entry.  The epilogue is always kept, since the
+ *		callee-saved registers are restored there.
+ */
+
+void removeUnreachable(Assembly &code)
+{
+    BasicBlocks &blocks = code.blocks();
+    unsigned b, i, n;
+    int s;
+
+
+    buildGraph(graph, code);
+    reached.assign(graph.numBlocks, 0);
+
+    if (graph.numBlocks == 0)
+	return;
+
+    pending.clear();
+    pending.push_back(0);
+    reached[0] = true;
+
+    while (!pending.empty()) {
+	b = pending.back();
+	pending.pop_back();
+
+	for (i = 0; i < 2; i ++)
+	    if ((s = graph.succs[2 * b + i]) >= 0 && !reached[s]) {
+		reached[s] = true;
+		pending.push_back(s);
+	    }
+    }
+
+    if (graph.exitBlock >= 0)
+	reached[graph.exitBlock] = true;
+
+    for (b = n = 0; b < graph.numBlocks; b ++)
+	if (reached[b]) {
+	    if (b != n)
+		blocks[n] = std::move(blocks[b]);
+
+	    n ++;
+	} else {
+	    numBlocks ++;
+	    numInsns += blocks[b].instructions.size();
+	}
+
+    blocks.resize(n);
+}
+
+
+/*
+ * Function:	removable (private)
+ *
+ * Description:	Return whether an instruction can be removed given the set
+ *		of registers live after it.
+ */
+
+static bool removable(const Instruction &insn, const Effects &fx, const Word *live)
+{
+    unsigned i;
+
+
+    if (fx.ndefs == 0 || insn.dst.kind != Operand::REGISTER)
+	return false;
+
+    switch (insn.opcode) {
+    case MOVL: case MOVB: case MOVSBL: case MOVZBL: case LEAL:
+    case ADDL: case SUBL: case IMULL: case NEGL: case SHLL: case SARL: case SHRL:
+    case SETE: case SETNE: case SETL: case SETG: case SETLE: case SETGE:
+	break;
+
+    default:
+	return false;
+    }
+
+    for (i = 0; i < fx.ndefs; i ++)
+	if (fx.defs[i] < NUM_REGS || has(live, fx.defs[i]))
+	    return false;
+
+    return true;
+}
+
+
+/*
+ * Function:	removeDeadCode
+ *
+ * Description:	Remove the instructions of a function whose results are
+ *		never used.  Each block is swept backward from the
+ *		registers live on exit from it.
+ */
+
+void removeDeadCode(Assembly &code)
+{
+    BasicBlocks &blocks = code.blocks();
+    unsigned b, i, j, words;
+    bool changed;
+    Effects fx;
+
+
+    do {
+	buildGraph(graph, code);
+	liveness(live, graph, code);
+	words = live.numWords;
+	changed = false;
+
+	for (b = 0; b < graph.numBlocks; b ++) {
+	    Instructions &insns = blocks[b].instructions;
+
+	    alive.assign(live.out.begin() + b * words, live.out.begin() + (b + 1) * words);
+	    dead.assign(insns.size(), 0);
+
+	    for (i = insns.size(); i -- > 0; ) {
+		effects(insns[i], fx);
+
+		if (removable(insns[i], fx, alive.data())) {
+		    dead[i] = true;
+
+		    for (j = 0; j < fx.nuses; j ++)
+			if (has(&live.in[b * words], fx.uses[j]))
+			    changed = true;
+
+		    continue;
+		}
+
+		for (j = 0; j < fx.ndefs; j ++)
+		    remove(alive.data(), fx.defs[j]);
+
+		for (j = 0; j < fx.nuses; j ++)
+		    add(alive.data(), fx.uses[j]);
+	    }
+
+	    for (i = j = 0; i < insns.size(); i ++)
+		if (!dead[i])
+		    insns[j ++] = insns[i];
+		else
+		    numInsns ++;
+
+	    insns.resize(j);
+	}
+    } while (changed);
+}
+
+
+/*
+ * Function:	deadCodeStatistics
+ *
+ * Description:	Write the number of blocks and instructions removed to the
+ *		given stream.
+ */
+
+void deadCodeStatistics(ostream &ostr)
+{
+    ostr << "dead code: " << numBlocks << " unreachable blocks, ";
+    ostr << numInsns << " instructions removed" << endl;
+}
@@ -0,0 +1,18 @@
+/*
+ * File:	deadcode.h
+ *
+ * Description:	This file contains the function declarations for the
+ *		removal of dead code, which is run over the code of each
+ *		function before registers are allocated.
+ */
+
+# ifndef DEADCODE_H
+# define DEADCODE_H
+# include <ostream>
+# include "assembly.h"
+
+void removeUnreachable(Assembly &code);
+void removeDeadCode(Assembly &code);
+void deadCodeStatistics(std::ostream &ostr);
+
+# endif /* DEADCODE_H */
@@ -0,0 +1,284 @@
+/*
+ * File:	emitter.cpp
+ *
+ * Description:	This file contains the member function definitions for the
+ *		assembly emitter for Simple C.
+ *
+ *		The standard streams flush on every endl, which costs at
+ *		least one system call per line of assembly.  Instead, we
+ *		keep our own put area and only hand it to the operating
+ *		system when it is full or when we are done.
+ */
+
+# include <chrono>
+# include <cerrno>
+# include <cstdlib>
+# include <new>
+# include <fcntl.h>
+# include <unistd.h>
+# include "emitter.h"
+
+using namespace std;
+
+
+/*
+ * Function:	now (private)
+ *
+ * Description:	Return the current time in seconds from a monotonic clock.
+ */
+
+static double now()
+{
+    auto t = chrono::steady_clock::now().time_since_epoch();
+    return chrono::duration<double>(t).count();
+}
+
+
+/*
+ * Function:	Emitter::Buffer::Buffer (constructor)
+ *
+ * Description:	Initialize the buffer with the given capacity and attach it
+ *		to the standard output.  Like the arenas, we throw if the
+ *		memory can't be had, rather than write through a null
+ *		pointer later.
+ */
+
+Emitter::Buffer::Buffer(size_t capacity)
+    : _fd(STDOUT_FILENO), _grow(false), _capacity(capacity),
+      _bytes(0), _writes(0), _seconds(0)
+{
+    if ((_data = (char *) malloc(_capacity)) == nullptr)
+	throw bad_alloc();
+
+    setp(_data, _data + _capacity);
+}
+
+
+/*
+ * Function:	Emitter::Buffer::~Buffer (destructor)
+ *
+ * Description:	Write out anything remaining and release the buffer.
+ */
+
+Emitter::Buffer::~Buffer()
+{
+    drain();
+    free(_data);
+}
+
+
+/*
+ * Function:	Emitter::Buffer::attach
+ *
+ * Description:	Direct all future output to the given file descriptor and
+ *		return the previous one.  If GROW is true, the buffer is
+ *		never drained until the end.
+ */
+
+int Emitter::Buffer::attach(int fd, bool grow)
+{
+    int old = _fd;
+
+    drain();
+    _fd = fd;
+    _grow = grow;
+    return old;
+}
+
+
+/*
+ * Function:	Emitter::Buffer::drain
+ *
+ * Description:	Write the contents of the put area to the file descriptor,
+ *		retrying on short writes and interrupted system calls.
+ */
+
+bool Emitter::Buffer::drain()
+{
+    const char *p = pbase();
+    size_t left = pptr() - pbase();
+    double start = now();
+    ssize_t n;
+
+
+    while (left > 0) {
+	n = ::write(_fd, p, left);
+
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+
+	    return false;
+	}
+
+	p += n;
+	left -= n;
+	_bytes += n;
+	_writes ++;
+    }
+
+    _seconds += now() - start;
+    setp(_data, _data + _capacity);
+    return true;
+}
+
+
+/*
+ * Function:	Emitter::Buffer::overflow
+ *
+ * Description:	Called by the stream when the put area is full.  We either
+ *		double the buffer or drain it, and then store the character.
+ *		If the buffer can't be doubled, we give up on writing the
+ *		output all at once, and drain it from then on instead.
+ */
+
+Emitter::Buffer::int_type Emitter::Buffer::overflow(int_type c)
+{
+    size_t used = pptr() - pbase();
+    char *data;
+
+
+    if (_grow && (data = (char *) realloc(_data, 2 * _capacity)) != nullptr) {
+	_data = data;
+	_capacity *= 2;
+	setp(_data, _data + _capacity);
+	pbump(used);
+
+    } else if (!drain())
+	return traits_type::eof();
+
+    else
+	_grow = false;
+
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+	*pptr() = traits_type::to_char_type(c);
+	pbump(1);
+    }
+
+    return traits_type::not_eof(c);
+}
+
+
+/*
+ * Function:	Emitter::Buffer::sync
+ *
+ * Description:	Called by the stream on an explicit flush.  In grow mode we
+ *		ignore the request, since the whole point is a single write.
+ */
+
+int Emitter::Buffer::sync()
+{
+    if (_grow)
+	return 0;
+
+    return drain() ? 0 : -1;
+}
+
+
+/*
+ * Function:	Emitter::Emitter (constructor)
+ *
+ * Description:	Initialize the emitter to write to the standard output.
+ */
+
+Emitter::Emitter(size_t capacity)
+    : ostream(nullptr), _buffer(capacity), _started(now())
+{
+    rdbuf(&_buffer);
+}
+
+
+/*
+ * Function:	Emitter::~Emitter (destructor)
+ *
+ * Description:	Make sure nothing is lost if we exit without closing.
+ */
+
+Emitter::~Emitter()
+{
+    close();
+}
+
+
+/*
+ * Function:	Emitter::open
+ *
+ * Description:	Redirect the output to the named file, which is created or
+ *		truncated.  Return false on failure, with errno set.
+ */
+
+bool Emitter::open(const string &path)
+{
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+    if (fd < 0)
+	return false;
+
+    _path = path;
+    _buffer.attach(fd, true);
+    return true;
+}
+
+
+/*
+ * Function:	Emitter::open
+ *
+ * Description:	Redirect the output to the given file descriptor, which is
+ *		left open when the emitter is closed.
+ */
+
+void Emitter::open(int fd)
+{
+    _buffer.attach(fd, false);
+}
+
+
+/*
+ * Function:	Emitter::close
+ *
+ * Description:	Write out any buffered output and close the file, if any.
+ *		Return false if any output could not be written.
+ */
+
+bool Emitter::close()
+{
+    bool ok = _buffer.drain();
+
+    if (!_path.empty()) {
+	ok = ::close(_buffer.attach(STDOUT_FILENO, false)) == 0 && ok;
+	_path.clear();
+    }
+
+    return ok;
+}
+
+
+/*
+ * Function:	Emitter::bytes (accessor)
+ *
+ * Description:	Return the number of bytes written so far.
+ */
+
+unsigned long long Emitter::bytes() const
+{
+    return _buffer._bytes;
+}
+
+
+/*
+ * Function:	Emitter::statistics
+ *
+ * Description:	Write the output statistics to the given stream: the total
+ *		number of bytes, the number of write calls, the time spent
+ *		in those calls, and the overall throughput.
+ */
+
+void Emitter::statistics(ostream &ostr) const
+{
+    double elapsed = now() - _started;
+    double rate = elapsed > 0 ? _buffer._bytes / elapsed : 0;
+
+    ostr << "emitter: " << _buffer._bytes << " bytes in " << _buffer._writes;
+    ostr << " writes, " << _buffer._seconds << "s writing, ";
+    ostr << rate / 1e6 << " MB/s overall" << std::endl;
+}
@@ -0,0 +1,67 @@
+/*
+ * File:	emitter.h
+ *
+ * Description:	This file contains the class definition for the assembly
+ *		emitter for Simple C.  The code generator writes the output
+ *		for a unit to the emitter in its context, which is an output
+ *		stream that buffers the assembly in large chunks rather than
+ *		flushing each line as it is written.
+ *
+ *		When writing to the standard output, the buffer is drained
+ *		whenever it fills, so memory use is bounded by the chunk
+ *		size.  When writing to a file, the buffer is grown instead
+ *		and the entire output is written with a single system call
+ *		when the emitter is closed.  An emitter may also be given a
+ *		file descriptor that is already open, such as one received
+ *		from a client, which is then drained like the standard
+ *		output.
+ */
+
+# ifndef EMITTER_H
+# define EMITTER_H
+# include <string>
+# include <ostream>
+# include <streambuf>
+
+class Emitter : public std::ostream {
+    typedef std::string string;
+
+    class Buffer : public std::streambuf {
+	int _fd;
+	bool _grow;
+	char *_data;
+	size_t _capacity;
+
+    protected:
+	virtual int_type overflow(int_type c);
+	virtual int sync();
+
+    public:
+	unsigned long long _bytes;
+	unsigned _writes;
+	double _seconds;
+
+	Buffer(size_t capacity);
+	~Buffer();
+
+	int attach(int fd, bool grow);
+	bool drain();
+    };
+
+    Buffer _buffer;
+    string _path;
+    double _started;
+
+public:
+    Emitter(size_t capacity = 1 << 20);
+    ~Emitter();
+
+    bool open(const string &path);
+    void open(int fd);
+    bool close();
+
+    unsigned long long bytes() const;
+    void statistics(std::ostream &ostr) const;
+};
+
+# endif /* EMITTER_H */
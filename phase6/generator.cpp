@@ -6,41 +6,97 @@
  *
  *		Extra functionality:
  *		- putting all the global declarations at the end
+ *		- finishing functions on a pool of threads
+ *		- caching finished functions on disk
  */
 
 #include <cassert>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <future>
 #include <iostream>
 #include <string>
 #include <map>
 #include "generator.h"
+#include "context.h"
 #include "machine.h"
+#include "peephole.h"
+#include "regalloc.h"
+#include "deadcode.h"
+#include "timing.h"
+#include "lower.h"
+#include "optimizer.h"
+#include "selector.h"
+#include "pool.h"
+#include "cache.h"
+#include "string.h"
 #include "Tree.h"
 
-static void compute(Expression *result, Expression *left, Expression *right, const std::string &opcode);
+static void compute(Expression *result, Expression *left, Expression *right, Opcode opcode);
 static void divide(Expression *result, Expression *left, Expression *right, Register *reg);
-static void compare(Expression *result, Expression *left, Expression *right, const std::string &opcode);
+static void compare(Expression *result, Expression *left, Expression *right, Opcode opcode);
 static void findBaseAndOffset(Expression *expr, Expression *&base, int &offset);
+static Operand address(Expression *pointer, int offset, Expression *&base, Expression *&index);
+static Operand location(Expression *lvalue, Expression *&base, Expression *&index);
+static void release(Expression *base, Expression *index);
 
 using namespace std;
 
-bool debug = false;
+/* A function whose trees have been translated, on its way through the
+   rest of the passes and out.  Everything that depends upon the trees
+   is done as each function is parsed, and the rest is done by the
+   pool, so that it may be done for several functions at once.  The
+   functions are written in order as they are finished. */
 
-static int offset;
-static string funcname;
-static ostream &operator<<(ostream &ostr, Expression *expr);
-
-static Register *eax = new Register("%eax", "%al");
-static Register *ecx = new Register("%ecx", "%cl");
-static Register *edx = new Register("%edx", "%dl");
-
-static map<string, Label> strings;
-static vector<Register *> registers = {eax, ecx, edx};
-
-/* These will be replaced with functions in the next phase.  They are here
-   as placeholders so that Call::generate() is finished. */
-
-// #define assign(node, reg)
-// #define load(node, reg)
+struct Job
+{
+    Assembly code;
+    Graph graph;
+    int offset;
+    unsigned labels;
+    unsigned registers;
+    unsigned strings;
+    vector<pair<Name, Label>> literals;
+    string key;
+    vector<double> times;
+    future<void> done;
+};
+
+/* Labels are numbered within each function, and renumbered as the
+   function is written so that they are numbered as they would be if
+   the functions were done one at a time.  The label of a string is
+   shared among functions, so it is numbered apart from those, by the
+   order in which the function first used it.  A finished function thus
+   depends on nothing else in its translation unit, and can be cached
+   as it is and used again in another. */
+
+static const unsigned STRING_LABELS = 1u << 30;
+static const unsigned MAX_PENDING = 4;
+static const unsigned MAX_DUPLICATED = 8;
+
+static Pool pool;
+static thread_local vector<Job *> idle;
+
+/* Everything else the generator keeps for a unit is in its context, but
+   a register that can hold an expression records which one it holds
+   while a function is being generated, and so belongs to the thread
+   generating it rather than to the unit.  Each thread thus has its own
+   registers and virtual registers, which it resets for each function. */
+
+static thread_local Register *eax = new Register("%eax", "%al", EAX);
+static thread_local Register *ecx = new Register("%ecx", "%cl", ECX);
+static thread_local Register *edx = new Register("%edx", "%dl", EDX);
+static Register *esp = new Register("%esp", "", ESP);
+static Register *ebp = new Register("%ebp", "", EBP);
+
+static thread_local vector<Register *> registers = {eax, ecx, edx};
+static thread_local vector<Register *> virtuals;
+static thread_local unsigned numVirtuals;
+
+bool promoteVariables = true;
+bool duplicateConditions = false;
+unsigned numThreads = 1;
 
 /*
  * Function:	align (private)
@@ -58,56 +114,116 @@ static int align(int offset)
 }
 
 /*
- * Function:	operator << (private)
+ * Function:	operandOf (private)
+ *
+ * Description:	Return the operand for a register.  The access size is
+ *		determined by the type of the associated expression if
+ *		present, just as when writing a register to a stream.
+ */
+
+static Operand operandOf(const Register *reg)
+{
+    if (reg->_node != nullptr)
+        return Operand(reg, reg->_node->type().size());
+
+    return Operand(reg, SIZEOF_REG);
+}
+
+/*
+ * Function:	operandOf (private)
+ *
+ * Description:	Return the operand of an expression, which is its register
+ *		if it has one.
+ */
+
+static Operand operandOf(Expression *expr)
+{
+    if (expr->_register != nullptr)
+        return operandOf(expr->_register);
+
+    return expr->operand();
+}
+
+/*
+ * Function:	operandOf (private)
  *
- * Description:	Convenience function for writing the operand of an
- *		expression using the output stream operator.
+ * Description:	Return the operand of an expression accessed with the given
+ *		size, which is either its register or an immediate that is
+ *		truncated to fit.
  */
 
-static ostream &operator<<(ostream &ostr, Expression *expr)
+static Operand operandOf(Expression *expr, unsigned size)
 {
+    unsigned value;
+
     if (expr->_register != nullptr)
-        return ostr << expr->_register;
+        return Operand(expr->_register, size);
+
+    if (size == 1 && expr->isNumber(value))
+        return Immediate(value & 0xff);
 
-    expr->operand(ostr);
-    return ostr;
+    return expr->operand();
+}
+
+/*
+ * Function:	displace (private)
+ *
+ * Description:	Return a memory operand moved by the given displacement.
+ *		A variable in a register can only be displaced by nothing.
+ */
+
+static Operand displace(Operand op, int disp)
+{
+    if (op.kind == Operand::REGISTER)
+    {
+        assert(disp == 0);
+        return op;
+    }
+
+    assert(op.kind == Operand::MEMORY);
+    op.value += disp;
+    return op;
 }
 
 /*
  * Function:	Expression::operand
  *
- * Description:	Write an expression as an operand to the specified stream.
+ * Description:	Return the operand of an expression that has been spilled.
  */
 
-void Expression::operand(ostream &ostr) const
+Operand Expression::operand() const
 {
     assert(_offset != 0);
-    ostr << _offset << "(%ebp)";
+    return Memory(ebp, _offset);
 }
 
 /*
  * Function:	Identifier::operand
  *
- * Description:	Write an identifier as an operand to the specified stream.
+ * Description:	Return the operand of an identifier, which is its register
+ *		if it has been promoted to one.
  */
 
-void Identifier::operand(ostream &ostr) const
+Operand Identifier::operand() const
 {
+    if (_symbol->_register != nullptr)
+        return Operand(_symbol->_register, _symbol->type().size());
+
     if (_symbol->_offset == 0)
-        ostr << global_prefix << _symbol->name();
-    else
-        ostr << _symbol->_offset << "(%ebp)";
+        return Memory(_symbol->name());
+
+    return Memory(ebp, _symbol->_offset);
 }
 
 /*
  * Function:	Number::operand
  *
- * Description:	Write a number as an operand to the specified stream.
+ * Description:	Return the operand of a number.
  */
 
-void Number::operand(ostream &ostr) const
+Operand Number::operand() const
 {
-    ostr << "$" << _value;
+    return Immediate(strtoul(_value.c_str(), NULL, 0));
 }
 
 /*
@@ -154,7 +270,7 @@ void Call::generate()
 
     if (align(numBytes) != 0)
     {
-        cout << "\tsubl\t$" << align(numBytes) << ", %esp" << endl;
+        context->code.emit(SUBL, Immediate(align(numBytes)), Operand(esp, SIZEOF_REG));
         numBytes += align(numBytes);
     }
 
@@ -165,15 +281,13 @@ void Call::generate()
         if (STACK_ALIGNMENT == SIZEOF_REG || !_args[i]->_hasCall)
             _args[i]->generate();
 
-        cout << "\tpushl\t" << _args[i] << endl;
+        context->code.emit(PUSHL, operandOf(_args[i]));
         assign(_args[i], nullptr);
     }
 
-    /* Call the function and then reclaim the stack space. */
-
-    load(nullptr, eax);
-    load(nullptr, ecx);
-    load(nullptr, edx);
+    /* Call the function and then reclaim the stack space.  The
+       register allocator keeps any values that live across the call
+       out of the registers that it clobbers. */
 
     if (_expr->type().isCallback())
     {
@@ -182,16 +296,17 @@ void Call::generate()
         if (_expr->_register == nullptr)
             load(_expr, getreg());
 
-        cout << "\tcall\t*" << _expr << endl;
+        context->code.emit(CALL, operandOf(_expr));
         assign(_expr, nullptr);
     }
     else
-        cout << "\tcall\t" << _expr << endl;
+        context->code.emit(CALL, Target(_expr->operand().symbol));
 
     if (numBytes > 0)
-        cout << "\taddl\t$" << numBytes << ", %esp" << endl;
+        context->code.emit(ADDL, Immediate(numBytes), Operand(esp, SIZEOF_REG));
 
-    assign(this, eax);
+    assign(this, getreg());
+    context->code.emit(MOVL, Operand(eax, SIZEOF_REG), Operand(_register, SIZEOF_REG));
 }
 
 /*
@@ -225,151 +340,477 @@ void Simple::generate()
     assign(_expr, nullptr);
 }
 
+/*
+ * Function:	save (private)
+ *
+ * Description:	Save a finished function in the cache under its key, along
+ *		with the number of labels it used and the strings it used,
+ *		each with the label it would be given if it were new.
+ */
+
+static void save(const Job *job)
+{
+    string data;
+    unsigned value;
+
+    data.append((const char *) &job->labels, sizeof(job->labels));
+    value = job->literals.size();
+    data.append((const char *) &value, sizeof(value));
+
+    for (auto &literal : job->literals)
+    {
+        const string &str = literal.first.str();
+
+        value = literal.second.number();
+        data.append((const char *) &value, sizeof(value));
+        value = str.size();
+        data.append((const char *) &value, sizeof(value));
+        data.append(str);
+    }
+
+    job->code.save(data);
+    storeCache(job->key, data);
+}
+
+/*
+ * Function:	load (private)
+ *
+ * Description:	Load a function saved in the cache into a job, which is
+ *		then just as if the function had been finished.  Return
+ *		false if the data is not a whole function, or if its names
+ *		can't be entered because the table of names is full.
+ */
+
+static bool load(Job *job, const string &data)
+{
+    unsigned count, number, length;
+    size_t pos = 0;
+
+    job->literals.clear();
+
+    if (data.size() < 2 * sizeof(unsigned))
+        return false;
+
+    memcpy(&job->labels, data.data(), sizeof(unsigned));
+    memcpy(&count, data.data() + sizeof(unsigned), sizeof(unsigned));
+    pos = 2 * sizeof(unsigned);
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (data.size() - pos < 2 * sizeof(unsigned))
+            return false;
+
+        memcpy(&number, data.data() + pos, sizeof(unsigned));
+        memcpy(&length, data.data() + pos + sizeof(unsigned), sizeof(unsigned));
+        pos += 2 * sizeof(unsigned);
+
+        if (data.size() - pos < length)
+            return false;
+
+        Name value(string_view(data.data() + pos, length));
+
+        if (length > 0 && value == Name())
+            return false;
+
+        job->literals.push_back({value, Label(number)});
+        pos += length;
+    }
+
+    if (!job->code.load(data, pos) || pos != data.size())
+        return false;
+
+    for (auto &block : job->code.blocks())
+        for (auto &insn : block.instructions)
+            for (auto op : {&insn.src, &insn.dst})
+                if (op->label >= (int) STRING_LABELS && op->label - STRING_LABELS >= count)
+                    return false;
+
+    return true;
+}
+
+/*
+ * Function:	finish (private)
+ *
+ * Description:	Finish the code for a function, by selecting instructions
+ *		from its optimized graph if there is one, emitting the
+ *		epilogue, and allocating registers, and then saving it in
+ *		the cache if it has a key.  When optimizing, dead code is
+ *		removed before allocating and the peephole optimizer is run
+ *		after.  Nothing here touches the trees, so
+ *		it may run on any thread.
+ */
+
+static void finish(Job *job)
+{
+    Assembly &assembly = job->code;
+    int offset = job->offset;
+    int param_offset = 2 * SIZEOF_REG;
+
+    restoreTiming(job->times);
+    Label::reset(job->labels);
+    numVirtuals = job->registers;
+
+    if (optimizationLevel > 0)
+    {
+        optimize(job->graph);
+        selectInstructions(job->graph, assembly);
+        stopTiming("select");
+    }
+
+    /* Generate our epilogue. */
+
+    assembly.label(assembly.exit());
+    assembly.emit(MOVL, Operand(ebp, SIZEOF_REG), Operand(esp, SIZEOF_REG));
+    assembly.emit(POPL, Operand(), Operand(ebp, SIZEOF_REG));
+    assembly.emit(RET);
+
+    offset -= align(offset - param_offset);
+    assembly.frame(-offset);
+
+    stopTiming("generate");
+
+    if (optimizationLevel > 0)
+    {
+        removeUnreachable(assembly);
+        stopTiming("unreachable");
+
+        removeDeadCode(assembly);
+        stopTiming("dead code");
+    }
+
+    allocateRegisters(assembly);
+    stopTiming("allocate");
+
+    if (optimizationLevel > 0)
+    {
+        peephole(assembly);
+        stopTiming("peephole");
+    }
+
+    job->labels = Label::count();
+
+    if (!job->key.empty())
+    {
+        save(job);
+        stopTiming("cache");
+    }
+
+    saveTiming(job->times);
+}
+
+/*
+ * Function:	renumber (private)
+ *
+ * Description:	Renumber the label of an operand, if it has one, given the
+ *		number of the first label of its function and the strings
+ *		it used.
+ */
+
+static void renumber(Operand &op, unsigned base, const vector<pair<Name, Label>> &literals)
+{
+    unsigned index;
+
+    if (op.label >= (int) STRING_LABELS)
+    {
+        index = context->strings.find(literals[op.label - STRING_LABELS].first)->second;
+        op.label = context->stringLabels[index].number();
+    }
+    else if (op.label >= 0)
+        op.label += base;
+}
+
+/*
+ * Function:	write (private)
+ *
+ * Description:	Write out a finished function, once all of the functions
+ *		before it have been written.  Its labels are numbered after
+ *		theirs, as are those of the strings it was first to use, and
+ *		its times are added to those of its translation unit.
+ */
+
+static void write(Job *job)
+{
+    unsigned base = context->numLabels;
+
+    job->done.get();
+    restoreTiming(job->times);
+    context->numLabels += job->labels;
+
+    for (; context->numStrings < job->strings; context->numStrings++)
+        context->stringLabels[context->numStrings] = Label(base + context->stringLabels[context->numStrings].number());
+
+    for (auto &block : job->code.blocks())
+    {
+        renumber(block.label, base, job->literals);
+
+        for (auto &insn : block.instructions)
+        {
+            renumber(insn.src, base, job->literals);
+            renumber(insn.dst, base, job->literals);
+        }
+    }
+
+    job->code.write(context->emitter);
+    stopTiming("write");
+    addTiming(context->times);
+
+    if (context->name.empty())
+        reportTiming(*context->errors, job->code.name().str());
+    else
+        reportTiming(*context->errors, context->name + ": " + job->code.name().str());
+}
+
+/*
+ * Function:	drain (private)
+ *
+ * Description:	Write out the functions that are finished, in order.  If
+ *		told to, or if too many are waiting, then wait for them.
+ */
+
+static void drain(bool wait)
+{
+    Job *job;
+
+    while (!context->pending.empty())
+    {
+        job = context->pending.front();
+
+        if (!wait && context->pending.size() <= MAX_PENDING * pool.size())
+            if (job->done.wait_for(chrono::seconds(0)) != future_status::ready)
+                break;
+
+        write(job);
+        context->pending.pop_front();
+        idle.push_back(job);
+    }
+}
+
+/*
+ * Function:	writeFunctions
+ *
+ * Description:	Write out every function that has been generated, waiting
+ *		for those that are still being finished.
+ */
+
+void writeFunctions()
+{
+    drain(true);
+}
+
+/*
+ * Function:	newJob (private)
+ *
+ * Description:	Return a job for the next function, reusing an idle one if
+ *		there is one.
+ */
+
+static Job *newJob()
+{
+    Job *job;
+
+    if (idle.empty())
+        return new Job();
+
+    job = idle.back();
+    idle.pop_back();
+    return job;
+}
+
+/*
+ * Function:	spliceFunction
+ *
+ * Description:	Look up the function just parsed in the cache by its key,
+ *		and if it is there, write it out in place of generating it,
+ *		once the functions before it have been written.  Any strings
+ *		it uses that are new to this translation unit are numbered
+ *		as they would have been had it been generated.  Return false
+ *		if it is not in the cache.
+ */
+
+bool spliceFunction()
+{
+    static thread_local string data;
+    promise<void> done;
+    Job *job;
+
+    startTiming();
+
+    if (!fetchCache(context->fingerprint, data))
+        return false;
+
+    job = newJob();
+
+    if (!load(job, data))
+    {
+        idle.push_back(job);
+        return false;
+    }
+
+    for (auto &literal : job->literals)
+    {
+        if (context->strings.find(literal.first) == context->strings.end())
+        {
+            context->strings.insert({literal.first, context->stringLabels.size()});
+            context->stringLabels.push_back(literal.second);
+        }
+    }
+
+    stopTiming("cache");
+
+    job->strings = context->stringLabels.size();
+    job->key.clear();
+    saveTiming(job->times);
+
+    done.set_value();
+    job->done = done.get_future();
+    context->pending.push_back(job);
+    drain(false);
+    return true;
+}
+
 /*
  * Function:	Procedure::generate
  *
  * Description:	Generate code for this function, which entails allocating
  *		space for local variables, then emitting our prologue, the
- *		body of the function, and the epilogue.
+ *		body of the function, and the epilogue.  The code is built
+ *		in memory using virtual registers, and is only written out
+ *		once the function is done, dead code has been removed,
+ *		registers have been allocated, and the peephole optimizer
+ *		has been over it.  Each of these passes is timed.
+ *
+ *		Only the passes over the trees are done here.  The function
+ *		is then handed to the pool to be finished, and written out
+ *		along with any others that are done by then.
  */
 
 void Procedure::generate()
 {
+    const Symbols &symbols = _body->declarations()->symbols();
+    Job *job;
     int param_offset;
 
-    /* Assign offsets to the parameters and local variables. */
+    if (numThreads > 1 && pool.size() == 0)
+        pool.start(numThreads);
+
+    job = newJob();
 
+    /* Assign offsets or registers to the parameters and local variables. */
+
+    startTiming();
+    context->literals.clear();
+    Label::reset();
+    numVirtuals = 0;
     param_offset = 2 * SIZEOF_REG;
-    offset = param_offset;
-    allocate(offset);
+    context->offset = param_offset;
+    allocate(context->offset);
 
-    /* Generate our prologue. */
+    /* Generate our prologue, which loads any parameters kept in registers. */
 
-    funcname = _id->name();
-    cout << global_prefix << funcname << ":" << endl;
-    cout << "\tpushl\t%ebp" << endl;
-    cout << "\tmovl\t%esp, %ebp" << endl;
-    cout << "\tsubl\t$" << funcname << ".size, %esp" << endl;
+    context->code.begin(_id->name());
+    context->code.emit(PUSHL, Operand(ebp, SIZEOF_REG));
+    context->code.emit(MOVL, Operand(esp, SIZEOF_REG), Operand(ebp, SIZEOF_REG));
+    context->code.emit(SUBL, context->code.size(), Operand(esp, SIZEOF_REG));
 
-    /* Generate the body of this function. */
+    /* Generate the body of this function, either directly or by way of
+       the optimizer, which loads the parameters itself. */
 
-    _body->generate();
+    if (optimizationLevel > 0)
+    {
+        job->graph = Graph();
+        ::lower(job->graph, _id, _body);
+        stopTiming("lower");
+    }
+    else
+    {
+        for (unsigned i = 0; i < _id->type().parameters()->size(); i++)
+        {
+            if (symbols[i]->_register != nullptr)
+                context->code.emit(MOVL, Memory(ebp, symbols[i]->_offset), Operand(symbols[i]->_register, SIZEOF_REG));
+        }
 
-    /* Generate our epilogue. */
+        _body->generate();
+        stopTiming("generate");
+    }
 
-    cout << endl
-         << global_prefix << funcname << ".exit:" << endl;
-    cout << "\tmovl\t%ebp, %esp" << endl;
-    cout << "\tpopl\t%ebp" << endl;
-    cout << "\tret" << endl
-         << endl;
+    /* Hand the function to the pool to be finished. */
 
-    offset -= align(offset - param_offset);
-    cout << "\t.set\t" << funcname << ".size, " << -offset << endl;
-    cout << "\t.globl\t" << global_prefix << funcname << endl
-         << endl;
+    job->offset = context->offset;
+    job->labels = Label::count();
+    job->registers = numVirtuals;
+    job->strings = context->stringLabels.size();
+    job->key = context->fingerprint;
+    swap(context->code, job->code);
+    swap(context->literals, job->literals);
+    saveTiming(job->times);
+
+    job->done = pool.submit([job] { finish(job); });
+    context->pending.push_back(job);
+    drain(false);
 }
 
 /*
  * Function:	generateGlobals
  *
- * Description:	Generate code for any global variable declarations.
+ * Description:	Generate code for any global variable declarations, once
+ *		the code for every function has been written.  The strings
+ *		are written in the order they were first used, rather than
+ *		in the order of their names, since names are shared with
+ *		other translation units and so are numbered differently
+ *		from run to run.
  */
 
 void generateGlobals(Scope *scope)
 {
     const Symbols &symbols = scope->symbols();
+    vector<Name> values(context->stringLabels.size());
+
+    drain(true);
 
     for (auto symbol : symbols)
         if (!symbol->type().isFunction())
         {
-            cout << "\t.comm\t" << global_prefix << symbol->name() << ", ";
-            cout << symbol->type().size() << endl;
+            context->emitter << "\t.comm\t" << global_prefix << symbol->name() << ", ";
+            context->emitter << symbol->type().size() << '\n';
         }
 
-    cout << "\t.data" << endl;
-    for (pair<string, Label> string_p : strings)
+    for (pair<Name, unsigned> string_p : context->strings)
+        values[string_p.second] = string_p.first;
+
+    context->emitter << "\t.data" << '\n';
+    for (unsigned i = 0; i < values.size(); i++)
     {
-        cout << string_p.second << ":\t.asciz\t\"";
-        for (auto &ch : string_p.first)
-        {
-            if (ch != '\n')
-            {
-                cout << ch;
-            }
-            else
-                cout << "\\n";
-        }
-        cout << "\"" << endl;
+        context->emitter << context->stringLabels[i] << ":\t.asciz\t\"";
+        context->emitter << escapeString(values[i].str()) << "\"" << '\n';
     }
 }
 
 /*
  * Function:	Assignment::generate
  *
- * Description:	Generate code for an assignment statement.
- *
- *		NOT FINISHED: Only works if the right-hand side is an
- *		integer literal and the left-hand side is an integer
- *		scalar.
+ * Description:	Generate code for an assignment statement.  The value is
+ *		stored with the size of the left-hand side, directly into
+ *		the operand for its location.
  */
 
 void Assignment::generate()
 {
-    if (debug)
-        cout << "# ASSIGNMENT::GENERATE" << endl;
-    // assert(dynamic_cast<Number *>(_right));
-    // assert(dynamic_cast<Identifier *>(_left));
-    Expression *base;
-    Expression *ptr;
-    findBaseAndOffset(_left, base, offset);
+    Expression *base, *index;
+    unsigned size = _left->type().size();
+    unsigned value;
+    Operand op;
 
-    unsigned num;
     _right->generate();
 
-    if (!_right->isNumber(num) || _right->_register == nullptr)
+    if (!_right->isNumber(value) && _right->_register == nullptr)
     {
         load(_right, getreg());
     }
 
-    if (base->isDereference(ptr))
-    {
-        ptr->generate();
+    op = location(_left, base, index);
+    context->code.emit(size == 1 ? MOVB : MOVL, operandOf(_right, size), op);
 
-        if (ptr->_register == nullptr)
-        {
-            load(ptr, getreg());
-        }
-        unsigned n = _right->type().size();
-        if (n == 1)
-        {
-            cout << "\tmovb\t" << _right->_register->name(n) << ", "
-                 << "(" << ptr << ")" << endl;
-        }
-        else
-        {
-            cout << "\tmovl\t" << _right << ", "
-                 << "(" << ptr << ")" << endl;
-        }
-        assign(ptr, nullptr);
-    }
-    else
-    {
-
-        base->generate();
-        unsigned n = _right->type().size();
-        if (n == 1)
-        {
-            cout << "\tmovb\t"
-                 << _right->_register->name(n)
-                 << ", " << offset << "+" << base << endl;
-        }
-        else
-        {
-            cout << "\tmovl\t" << _right << ", " << offset << "+" << base << endl;
-        }
-        // assign(base, nullptr);
-    }
+    release(base, index);
     assign(_right, nullptr);
 }
 
@@ -381,23 +822,19 @@ void Assignment::generate()
 
 void load(Expression *expr, Register *reg)
 {
-    if (debug)
-        cout << "# LOAD" << endl;
     if (reg->_node != expr)
     {
         if (reg->_node != nullptr)
         {
             unsigned n = reg->_node->type().size();
-            offset -= n;
-            reg->_node->_offset = offset;
-            cout << (n == 1 ? "\tmovb\t" : "\tmovl\t");
-            cout << reg << ", " << offset << "(%ebp)" << endl;
+            context->offset -= n;
+            reg->_node->_offset = context->offset;
+            context->code.emit(n == 1 ? MOVB : MOVL, operandOf(reg), Memory(ebp, context->offset));
         }
         if (expr != nullptr)
         {
             unsigned n = expr->type().size();
-            cout << (n == 1 ? "\tmovb\t" : "\tmovl\t");
-            cout << expr << ", " << reg->name(n) << endl;
+            context->code.emit(n == 1 ? MOVB : MOVL, operandOf(expr), Operand(reg, n));
         }
         assign(expr, reg);
     }
@@ -405,18 +842,23 @@ void load(Expression *expr, Register *reg)
 
 /*
  *   Function: getReg
- *   Returns the first aviable register as a ptr.
+ *   Returns a new virtual register as a ptr.  The register allocator
+ *   replaces it with a real one once the function is done.  Each
+ *   thread has its own, since a function may be finished on another
+ *   thread than the one that started it.
  *
  */
 
 Register *getreg()
 {
-    for (auto reg : registers)
-        if (reg->_node == nullptr)
-            return reg;
+    Register *reg;
+
+    while (numVirtuals >= virtuals.size())
+        virtuals.push_back(new Register("", "", NUM_REGS + virtuals.size()));
 
-    load(nullptr, registers[0]);
-    return registers[0];
+    reg = virtuals[numVirtuals++];
+    reg->_node = nullptr;
+    return reg;
 }
 
 /*
@@ -426,8 +868,6 @@ Register *getreg()
 
 void assign(Expression *expr, Register *reg)
 {
-    if (debug)
-        cout << "# ASSIGN Reg" << endl;
     if (expr != nullptr)
     {
         if (expr->_register != nullptr)
@@ -447,10 +887,8 @@ void assign(Expression *expr, Register *reg)
     }
 }
 
-static void compute(Expression *result, Expression *left, Expression *right, const string &opcode)
+static void compute(Expression *result, Expression *left, Expression *right, Opcode opcode)
 {
-    if (debug)
-        cout << "# compute HERE:" << endl;
     left->generate();
     right->generate();
 
@@ -459,7 +897,7 @@ static void compute(Expression *result, Expression *left, Expression *right, con
         load(left, getreg());
     }
 
-    cout << "\t" << opcode << "\t" << right << ", " << left << endl;
+    context->code.emit(opcode, operandOf(right), operandOf(left));
 
     assign(right, nullptr);
     assign(result, left->_register);
@@ -467,44 +905,247 @@ static void compute(Expression *result, Expression *left, Expression *right, con
 
 void Add::generate()
 {
-    if (debug)
-        cout << "# ADD::GENERATE" << endl;
-    compute(this, _left, _right, "addl");
+    compute(this, _left, _right, ADDL);
 }
 
 void Subtract::generate()
 {
-    if (debug)
-        cout << "# SUB::GENERATE" << endl;
-    compute(this, _left, _right, "subl");
+    compute(this, _left, _right, SUBL);
+}
+
+/*
+ * Function:	multiplyBy (private)
+ *
+ * Description:	Multiply a register by a constant in place.  The constant
+ *		is split into a power of two, which is a shift, and an odd
+ *		factor, which is an address computation if it is 3, 5, or 9
+ *		and otherwise left to imull.
+ */
+
+static void multiplyBy(Register *reg, unsigned value)
+{
+    unsigned odd = value, shift = 0;
+
+    while (odd != 0 && odd % 2 == 0)
+    {
+        odd /= 2;
+        shift++;
+    }
+
+    if (odd == 3 || odd == 5 || odd == 9)
+    {
+        context->code.emit(LEAL, Memory(reg, reg, odd - 1), Operand(reg, SIZEOF_REG));
+    }
+    else if (odd != 1)
+    {
+        context->code.emit(IMULL, Immediate(value), Operand(reg, SIZEOF_REG));
+        return;
+    }
+
+    if (shift > 0)
+    {
+        context->code.emit(SHLL, Immediate(shift), Operand(reg, SIZEOF_REG));
+    }
+}
+
+static void multiply(Expression *result, Expression *expr, unsigned value)
+{
+    expr->generate();
+
+    if (expr->_register == nullptr)
+    {
+        load(expr, getreg());
+    }
+
+    multiplyBy(expr->_register, value);
+    assign(result, expr->_register);
 }
 
 void Multiply::generate()
 {
-    if (debug)
-        cout << "# MULT::GENERATE" << endl;
-    compute(this, _left, _right, "imull");
+    unsigned value;
+
+    if (_right->isNumber(value))
+    {
+        multiply(this, _left, value);
+    }
+    else if (_left->isNumber(value))
+    {
+        multiply(this, _right, value);
+    }
+    else
+    {
+        compute(this, _left, _right, IMULL);
+    }
+}
+
+/*
+ * Function:	magic
+ *
+ * Description:	Compute the magic number and shift for signed division by
+ *		a constant of at least two, as given in Hacker's Delight
+ *		(section 10-4).  The quotient is the upper half of the
+ *		product of the dividend and the magic number, shifted
+ *		right, plus one if the dividend is negative.
+ */
+
+void magic(unsigned divisor, int &multiplier, unsigned &shift)
+{
+    const unsigned two31 = 0x80000000;
+    unsigned anc, delta, q1, r1, q2, r2;
+    unsigned p = 31;
+
+    anc = two31 - 1 - two31 % divisor;
+    q1 = two31 / anc;
+    r1 = two31 - q1 * anc;
+    q2 = two31 / divisor;
+    r2 = two31 - q2 * divisor;
+
+    do
+    {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+
+        if (r1 >= anc)
+        {
+            q1++;
+            r1 -= anc;
+        }
+
+        q2 *= 2;
+        r2 *= 2;
+
+        if (r2 >= divisor)
+        {
+            q2++;
+            r2 -= divisor;
+        }
+
+        delta = divisor - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    multiplier = q2 + 1;
+    shift = p - 32;
+}
+
+/*
+ * Function:	divideBy (private)
+ *
+ * Description:	Divide an expression by a positive constant without using
+ *		idivl.  A power of two is an arithmetic shift, after one
+ *		less than the divisor is added to a negative dividend so
+ *		that the quotient rounds toward zero.  Any other divisor is
+ *		a multiplication by its magic number.  The remainder is
+ *		then the dividend less the quotient times the divisor.
+ */
+
+static void divideBy(Expression *result, Expression *expr, unsigned divisor, bool remainder)
+{
+    Register *quotient = getreg(), *temp;
+    Operand dividend, q(quotient, SIZEOF_REG);
+    unsigned shift;
+    int multiplier;
+
+    expr->generate();
+
+    if (expr->_register == nullptr)
+    {
+        load(expr, getreg());
+    }
+
+    dividend = operandOf(expr);
+
+    if (divisor == 1)
+    {
+        context->code.emit(MOVL, remainder ? Immediate(0) : dividend, q);
+        remainder = false;
+    }
+    else if ((divisor & (divisor - 1)) == 0)
+    {
+        shift = 0;
+
+        while ((1u << shift) < divisor)
+        {
+            shift++;
+        }
+
+        context->code.emit(MOVL, dividend, q);
+
+        if (shift > 1)
+        {
+            context->code.emit(SARL, Immediate(31), q);
+        }
+
+        context->code.emit(SHRL, Immediate(32 - shift), q);
+        context->code.emit(ADDL, dividend, q);
+        context->code.emit(SARL, Immediate(shift), q);
+    }
+    else
+    {
+        magic(divisor, multiplier, shift);
+
+        temp = getreg();
+        context->code.emit(MOVL, dividend, Operand(eax, SIZEOF_REG));
+        context->code.emit(MOVL, Immediate(multiplier), Operand(temp, SIZEOF_REG));
+        context->code.emit(IMULL, Operand(temp, SIZEOF_REG));
+
+        if (multiplier < 0)
+        {
+            context->code.emit(ADDL, dividend, Operand(edx, SIZEOF_REG));
+        }
+
+        if (shift > 0)
+        {
+            context->code.emit(SARL, Immediate(shift), Operand(edx, SIZEOF_REG));
+        }
+
+        context->code.emit(MOVL, Operand(edx, SIZEOF_REG), q);
+
+        temp = getreg();
+        context->code.emit(MOVL, dividend, Operand(temp, SIZEOF_REG));
+        context->code.emit(SHRL, Immediate(31), Operand(temp, SIZEOF_REG));
+        context->code.emit(ADDL, Operand(temp, SIZEOF_REG), q);
+    }
+
+    if (remainder)
+    {
+        multiplyBy(quotient, divisor);
+        context->code.emit(SUBL, q, dividend);
+        quotient = expr->_register;
+    }
+
+    assign(expr, nullptr);
+
+    assign(result, quotient);
 }
 
 static void divide(Expression *result, Expression *left, Expression *right, Register *reg)
 {
     unsigned int num;
+
+    if (right->isNumber(num) && num > 0 && num <= INT_MAX)
+    {
+        divideBy(result, left, num, reg == edx);
+        return;
+    }
+
     left->generate();
     right->generate();
     load(left, eax);
     load(nullptr, edx);
     if (right->isNumber(num))
     {
-        load(right, ecx);
+        load(right, getreg());
     }
 
-    cout << "\tcltd\t" << endl;
-    cout << "\tidivl\t"
-         << right << endl;
+    context->code.emit(CLTD);
+    context->code.emit(IDIVL, operandOf(right));
 
     assign(nullptr, left->_register);
     assign(nullptr, right->_register);
-    assign(result, reg);
+    assign(result, getreg());
+    context->code.emit(MOVL, Operand(reg, SIZEOF_REG), Operand(result->_register, SIZEOF_REG));
 }
 
 void Divide::generate()
@@ -517,49 +1158,103 @@ void Remainder::generate()
     divide(this, _left, _right, edx);
 }
 
-static void compare(Expression *result, Expression *left, Expression *right, const string &opcode)
+static void compare(Expression *result, Expression *left, Expression *right, Opcode opcode)
 {
     left->generate();
     right->generate();
     if (left->_register == nullptr)
         load(left, getreg());
-    cout << "\tcmpl\t" << right << ", " << left << endl;
-    cout << "\t" << opcode << "\t" << left->_register->byte() << endl;
-    cout << "\tmovzbl\t" << left->_register->byte() << ", " << left->_register << endl;
+    context->code.emit(CMPL, operandOf(right), operandOf(left));
+    context->code.emit(opcode, Operand(), Operand(left->_register, 1));
+    context->code.emit(MOVZBL, Operand(left->_register, 1), operandOf(left->_register));
 
     assign(result, left->_register);
 }
 
 void LessThan::generate()
 {
-    compare(this, _left, _right, "setl");
+    compare(this, _left, _right, SETL);
 }
 
 void GreaterThan::generate()
 {
-    compare(this, _left, _right, "setg");
+    compare(this, _left, _right, SETG);
 }
 
 void LessOrEqual::generate()
 {
-    compare(this, _left, _right, "setle");
+    compare(this, _left, _right, SETLE);
 }
 
 void GreaterOrEqual::generate()
 {
-    compare(this, _left, _right, "setge");
+    compare(this, _left, _right, SETGE);
 }
 
 void Equal::generate()
 {
-    if (debug)
-        cout << "# EQUAL TO" << endl;
-    compare(this, _left, _right, "sete");
+    compare(this, _left, _right, SETE);
 }
 
 void NotEqual::generate()
 {
-    compare(this, _left, _right, "setne");
+    compare(this, _left, _right, SETNE);
+}
+
+/*
+ * Function:	branch (private)
+ *
+ * Description:	Compare two expressions and jump to the label on the given
+ *		condition.  A variable kept in a register can be compared
+ *		where it is.
+ */
+
+static void branch(Expression *left, Expression *right, const Label &label, Opcode jump)
+{
+    Symbol *symbol;
+
+    left->generate();
+    right->generate();
+
+    if (left->_register == nullptr)
+        if (!left->isIdentifier(symbol) || symbol->_register == nullptr)
+            load(left, getreg());
+
+    context->code.emit(CMPL, operandOf(right), operandOf(left));
+    context->code.emit(jump, Target(label));
+
+    assign(left, nullptr);
+    assign(right, nullptr);
+}
+
+void LessThan::test(const Label &label, bool ifTrue)
+{
+    branch(_left, _right, label, ifTrue ? JL : JGE);
+}
+
+void GreaterThan::test(const Label &label, bool ifTrue)
+{
+    branch(_left, _right, label, ifTrue ? JG : JLE);
+}
+
+void LessOrEqual::test(const Label &label, bool ifTrue)
+{
+    branch(_left, _right, label, ifTrue ? JLE : JG);
+}
+
+void GreaterOrEqual::test(const Label &label, bool ifTrue)
+{
+    branch(_left, _right, label, ifTrue ? JGE : JL);
+}
+
+void Equal::test(const Label &label, bool ifTrue)
+{
+    branch(_left, _right, label, ifTrue ? JE : JNE);
+}
+
+void NotEqual::test(const Label &label, bool ifTrue)
+{
+    branch(_left, _right, label, ifTrue ? JNE : JE);
 }
 
 void Cast::generate()
@@ -575,7 +1270,7 @@ void Cast::generate()
         if (_expr->type().size() == 1)
         {
 
-            cout << "\tmovsbl\t" << _expr << ", " << _expr->_register->name(4) << endl;
+            context->code.emit(MOVSBL, operandOf(_expr), Operand(_expr->_register, 4));
         }
     }
 
@@ -590,11 +1285,9 @@ void Not::generate()
         load(_expr, getreg());
     }
 
-    cout << "\tcmpl\t"
-         << "$0"
-         << ", " << _expr << endl;
-    cout << "\tsete\t" << _expr->_register->byte() << endl;
-    cout << "\tmovzbl\t" << _expr->_register->byte() << ", " << _expr << endl;
+    context->code.emit(CMPL, Immediate(0), operandOf(_expr));
+    context->code.emit(SETE, Operand(), Operand(_expr->_register, 1));
+    context->code.emit(MOVZBL, Operand(_expr->_register, 1), operandOf(_expr));
 
     assign(this, _expr->_register);
 }
@@ -607,67 +1300,64 @@ void Negate::generate()
         load(_expr, getreg());
     }
 
-    cout << "\tnegl\t" << _expr << endl;
+    context->code.emit(NEGL, Operand(), operandOf(_expr));
 
     assign(this, _expr->_register);
 }
 
 void Dereference::generate()
 {
-    _expr->generate();
-    if (_expr->_register == nullptr)
-    {
-        load(_expr, getreg());
-    }
+    Expression *base, *index;
+    Operand op = address(_expr, 0, base, index);
 
-    if (_expr->type().size() == 4)
-    {
-        cout << "\tmovl\t"
-             << "(" << _expr << "), " << _expr << endl;
-    }
-    else
-    {
-        cout << "\tmovzbl\t"
-             << "(" << _expr << "), " << _expr << endl;
-    }
-    assign(this, _expr->_register);
+    release(base, index);
+    assign(this, getreg());
+    context->code.emit(_type.size() == 1 ? MOVZBL : MOVL, op, Operand(_register, SIZEOF_REG));
 }
 
+/*
+ * Function:	Address::generate
+ *
+ * Description:	Generate code for an address expression.  The address of
+ *		a location that is already in a register is that register;
+ *		any other is computed with leal.
+ */
+
 void Address::generate()
 {
-    Expression *base;
-    findBaseAndOffset(_expr, base, offset);
+    Expression *base, *index;
+    Operand op = location(_expr, base, index);
 
-    Expression *ptr;
-    if (base->isDereference(ptr))
+    if (index == nullptr && base != nullptr && base->_register != nullptr && op.value == 0)
     {
-        ptr->generate();
-        if (ptr->_register == nullptr)
-        {
-            load(ptr, getreg());
-        }
-        assign(this, ptr->_register);
+        assign(this, base->_register);
     }
     else
     {
+        release(base, index);
         assign(this, getreg());
-        cout << "\tleal\t" << base << ", " << this << endl;
+        context->code.emit(LEAL, op, operandOf(this));
     }
 }
 
-void String::operand(ostream &ostr) const
+Operand String::operand() const
 {
     Label string;
+    unsigned i;
 
-    if (strings.find(_value) == strings.end())
-    {
-        strings.insert({_value, string});
-    }
-    else
+    for (i = 0; i < context->literals.size(); i++)
+        if (context->literals[i].first == _value)
+            break;
+
+    if (i == context->literals.size())
+        context->literals.push_back({_value, string});
+
+    if (context->strings.find(_value) == context->strings.end())
     {
-        string = strings.find(_value)->second;
+        context->strings.insert({_value, context->stringLabels.size()});
+        context->stringLabels.push_back(string);
     }
-    ostr << string;
+    return Memory(Label(STRING_LABELS + i));
 }
 
 void Expression::test(const Label &label, bool ifTrue)
@@ -677,8 +1367,8 @@ void Expression::test(const Label &label, bool ifTrue)
     if (_register == nullptr)
         load(this, getreg());
 
-    cout << "\tcmpl\t$0, " << this << endl;
-    cout << (ifTrue ? "\tjne\t" : "\tje\t") << label << endl;
+    context->code.emit(CMPL, Immediate(0), operandOf(this));
+    context->code.emit(ifTrue ? JNE : JE, Target(label));
 
     assign(this, nullptr);
 }
@@ -694,133 +1384,310 @@ static void findBaseAndOffset(Expression *expr, Expression *&base, int &offset)
         offset += field;
 }
 
-void Field::generate()
+/*
+ * Function:	registerOf (private)
+ *
+ * Description:	Generate an expression and return the register holding its
+ *		value.  A variable kept in a register is used where it is.
+ */
+
+static Register *registerOf(Expression *expr)
 {
-    Expression *base;
-    int offset = _id->_offset;
-    findBaseAndOffset(_expr, base, offset);
+    Symbol *symbol;
 
-    Expression *ptr;
-    if (base->isDereference(ptr))
+    expr->generate();
+
+    if (expr->_register == nullptr)
     {
-        ptr->generate();
-        if (ptr->_register == nullptr)
+        if (expr->isIdentifier(symbol) && symbol->_register != nullptr)
         {
-            load(ptr, getreg());
+            return symbol->_register;
         }
-        assign(this, getreg());
-        if (this->type().size() == 4)
+
+        load(expr, getreg());
+    }
+
+    return expr->_register;
+}
+
+/*
+ * Function:	address (private)
+ *
+ * Description:	Generate a pointer expression, moved by the given offset,
+ *		and return the memory operand to which it points.  Pointer
+ *		arithmetic is folded into the operand as far as the
+ *		addressing modes allow: constants are added to the
+ *		displacement, one integer scaled by 1, 2, 4, or 8 becomes
+ *		the index, less any constant added to it, and the address
+ *		of a variable or of a field within one becomes the base.
+ *		The expressions whose registers the operand uses are
+ *		returned so that the caller can release them once the
+ *		operand has been used.
+ */
+
+static Operand address(Expression *pointer, int offset, Expression *&base, Expression *&index)
+{
+    Expression *left, *right, *expr, *factor;
+    unsigned value, scale = 1;
+    int field;
+    Operand op;
+
+    base = index = nullptr;
+
+    while (pointer->isAdd(left, right))
+    {
+        if (!left->type().isPointer())
         {
-            cout << "\tmovl\t" << ptr << ", " << offset << "+(" << this << ")" << endl;
+            swap(left, right);
         }
-        else
+
+        if (right->isNumber(value))
         {
-            cout << "\tmovb\t" << ptr << ", " << offset << "+(" << this << ")" << endl;
+            offset += value;
         }
-    }
-    else
-    {
-        assign(_expr, getreg());
-        if (this->type().size() == 4)
+        else if (index == nullptr)
         {
-            cout << "\tmovl\t" << base << ", " << offset << "+" << this << endl;
+            index = right;
+
+            if (right->isMultiply(expr, factor) && factor->isNumber(value))
+            {
+                if (value == 2 || value == 4 || value == 8)
+                {
+                    index = expr;
+                    scale = value;
+                }
+            }
+
+            while (index->isAdd(expr, factor) && factor->isNumber(value))
+            {
+                offset += value * scale;
+                index = expr;
+            }
         }
         else
         {
-            cout << "\tmovb\t" << base << ", " << offset << "+" << this << endl;
+            break;
         }
+
+        pointer = left;
     }
+
+    if (pointer->isAddress(expr))
+    {
+        findBaseAndOffset(expr, expr, field);
+        offset += field;
+
+        if (!expr->isDereference(pointer))
+        {
+            expr->generate();
+            op = displace(operandOf(expr), offset);
+            pointer = nullptr;
+        }
+    }
+
+    if (pointer != nullptr)
+    {
+        op = Memory(registerOf(pointer), offset);
+        base = pointer;
+    }
+
+    if (index != nullptr)
+    {
+        op.index = registerOf(index)->number();
+        op.scale = scale;
+    }
+
+    return op;
 }
 
-void LogicalAnd::generate()
+/*
+ * Function:	location (private)
+ *
+ * Description:	Generate the address of an lvalue and return the operand
+ *		for it, as address() does for a pointer.
+ */
+
+static Operand location(Expression *lvalue, Expression *&base, Expression *&index)
 {
-    Label next;
-    _left->test(next, false);
+    Expression *pointer;
+    int offset;
 
-    _right->generate();
-    if (_right->_register == nullptr)
+    findBaseAndOffset(lvalue, lvalue, offset);
+
+    if (lvalue->isDereference(pointer))
     {
-        load(_right, getreg());
+        return address(pointer, offset, base, index);
     }
-    cout << "\tcmpl\t$0, " << _right << endl;
 
-    cout << next << ":" << endl;
-    cout << "\tsetne\t" << _right->_register->byte() << endl;
-    cout << "\tmovzbl\t" << _right->_register->byte() << ", " << _right << endl;
-    assign(this, _right->_register);
+    base = index = nullptr;
+    lvalue->generate();
+    return displace(operandOf(lvalue), offset);
 }
 
-void LogicalOr::generate()
+/*
+ * Function:	release (private)
+ *
+ * Description:	Release the registers used by an operand from address().
+ */
+
+static void release(Expression *base, Expression *index)
 {
-    Label next;
-    _left->test(next, true);
+    if (base != nullptr)
+    {
+        assign(base, nullptr);
+    }
 
-    _right->generate();
-    if (_right->_register == nullptr)
+    if (index != nullptr)
     {
-        load(_right, getreg());
+        assign(index, nullptr);
     }
+}
 
-    cout << "\tcmpl\t$0, " << _right << endl;
+void Field::generate()
+{
+    Expression *base, *index;
+    Operand op = location(this, base, index);
 
-    cout << next << ":" << endl;
-    cout << "\tsetne\t" << _right->_register->byte() << endl;
-    cout << "\tmovzbl\t" << _right->_register->byte() << ", " << _right << endl;
-    assign(this, _right->_register);
+    release(base, index);
+    assign(this, getreg());
+    context->code.emit(_type.size() == 1 ? MOVZBL : MOVL, op, Operand(_register, SIZEOF_REG));
 }
 
-void While::generate()
-{
-    Label loop, exit;
+/*
+ * Function:	logical (private)
+ *
+ * Description:	Generate the value of a condition by testing it and
+ *		setting a register to one or zero accordingly.
+ */
 
-    cout << loop << ":" << endl;
+static void logical(Expression *result)
+{
+    Label skip;
+    Register *reg = getreg();
 
-    _expr->test(exit, false);
-    _stmt->generate();
+    context->code.emit(MOVL, Immediate(0), Operand(reg, SIZEOF_REG));
+    result->test(skip, false);
+    context->code.emit(MOVL, Immediate(1), Operand(reg, SIZEOF_REG));
+    context->code.label(Target(skip));
 
-    cout << "\tjmp\t" << loop << endl;
-    cout << exit << ":" << endl;
+    assign(result, reg);
 }
 
-void LessThan::test(const Label &label, bool ifTrue)
+void LogicalAnd::generate()
 {
-    _left->generate();
-    _right->generate();
+    logical(this);
+}
 
-    if (_left->_register == nullptr)
-        load(_left, getreg());
+void LogicalOr::generate()
+{
+    logical(this);
+}
 
-    cout << "\tcmpl\t" << _right << ", " << _left << endl;
-    cout << (ifTrue ? "\tjl\t" : "\tjge\t") << label << endl;
+void LogicalAnd::test(const Label &label, bool ifTrue)
+{
+    Label skip;
 
-    assign(_left, nullptr);
-    assign(_right, nullptr);
+    if (ifTrue)
+    {
+        _left->test(skip, false);
+        _right->test(label, true);
+        context->code.label(Target(skip));
+    }
+    else
+    {
+        _left->test(label, false);
+        _right->test(label, false);
+    }
 }
 
-void Return::generate()
+void LogicalOr::test(const Label &label, bool ifTrue)
 {
-    if (debug)
+    Label skip;
+
+    if (ifTrue)
     {
-        cout << "# RETURN GENERATE!" << endl;
+        _left->test(label, true);
+        _right->test(label, true);
     }
+    else
+    {
+        _left->test(skip, true);
+        _right->test(label, false);
+        context->code.label(Target(skip));
+    }
+}
+
+void Not::test(const Label &label, bool ifTrue)
+{
+    _expr->test(label, !ifTrue);
+}
+
+/*
+ * Function:	duplicate
+ *
+ * Description:	Return whether the condition of a loop should be copied in
+ *		front of the loop, which is if conditions are being copied
+ *		and it is small enough, which we take to mean that it makes
+ *		no calls and has only a few operators.
+ */
+
+bool duplicate(const Expression *expr)
+{
+    return duplicateConditions && !expr->_hasCall && expr->_size <= MAX_DUPLICATED;
+}
+
+/*
+ * Function:	rotate (private)
+ *
+ * Description:	Generate code for a loop with the test at the bottom, so
+ *		that each iteration takes only the one branch back.  We
+ *		enter the loop by jumping to the test, unless the condition
+ *		is to be copied in front of the loop instead as a guard that
+ *		skips the loop entirely.
+ */
+
+static void rotate(Expression *expr, Statement *body, Statement *incr)
+{
+    Label loop, next, exit;
+    bool copy = duplicate(expr);
+
+    if (copy)
+        expr->test(exit, false);
+    else
+        context->code.emit(JMP, Target(next));
+
+    context->code.label(Target(loop), true);
+    body->generate();
+
+    if (incr != nullptr)
+        incr->generate();
+
+    if (!copy)
+        context->code.label(Target(next));
+
+    expr->test(loop, true);
+
+    if (copy)
+        context->code.label(Target(exit));
+}
+
+void While::generate()
+{
+    rotate(_expr, _stmt, nullptr);
+}
+
+void Return::generate()
+{
     _expr->generate();
     load(_expr, eax);
-    cout << "\tjmp\t" << funcname << ".exit" << endl;
+    context->code.emit(JMP, context->code.exit());
     assign(_expr, nullptr);
 }
 
 void For::generate()
 {
-    Label next, exit;
     _init->generate();
-    cout << next << ":" << endl;
-
-    _expr->test(exit, false);
-    _stmt->generate();
-    _incr->generate();
-
-    cout << "\tjmp\t" << next << endl;
-    cout << exit << ":" << endl;
+    rotate(_expr, _stmt, _incr);
 }
 
 void If::generate()
@@ -833,13 +1700,13 @@ void If::generate()
     if (_elseStmt != nullptr)
     {
 
-        cout << "\tjmp\t" << exit << endl;
-        cout << next << ":" << endl;
+        context->code.emit(JMP, Target(exit));
+        context->code.label(Target(next));
         _elseStmt->generate();
-        cout << exit << ":" << endl;
+        context->code.label(Target(exit));
     }
     else
     {
-        cout << next << ":" << endl;
+        context->code.label(Target(next));
     }
 }
@@ -13,10 +13,19 @@
 #include "label.h"
 
 void generateGlobals(Scope *scope);
+void writeFunctions();
+bool spliceFunction();
 
 void load(Expression *expr, Register *reg);
 void assign(Expression *expr, Register *reg);
 
 Register *getreg();
 
+void magic(unsigned divisor, int &multiplier, unsigned &shift);
+bool duplicate(const Expression *expr);
+
+extern bool promoteVariables;
+extern bool duplicateConditions;
+extern unsigned numThreads;
+
 #endif /* GENERATOR_H */
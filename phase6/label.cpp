@@ -4,25 +4,55 @@
  *   Description: The file contains the member functions
  *   for labels provided in the assembly
  *
+ *   Labels are numbered by a counter kept for each thread, so that
+ *   functions generated at the same time on different threads each
+ *   number their labels on their own.
+ *
  */
 
 #include <iostream>
 #include "label.h"
 using namespace std;
 
-unsigned Label::_counter = 0;
+thread_local unsigned Label::_counter = 0;
 
 Label::Label()
 {
     _number = _counter++;
 }
 
+Label::Label(unsigned number)
+{
+    _number = number;
+}
+
 unsigned Label::number() const
 {
     return _number;
 }
 
+/*
+ *   Function: count
+ *   Returns the number of labels created since the counter was last
+ *   reset on this thread.
+ */
+
+unsigned Label::count()
+{
+    return _counter;
+}
+
+/*
+ *   Function: reset
+ *   Restarts the counter on this thread at the given number.
+ */
+
+void Label::reset(unsigned counter)
+{
+    _counter = counter;
+}
+
 ostream &operator<<(ostream &ostr, const Label &label)
 {
     return ostr << ".L" << label.number();
-}
\ No newline at end of file
+}
@@ -1,16 +1,19 @@
-
 #ifndef LABEL_H
 #define LABEL_H
 #include <iostream>
 
 class Label
 {
-    static unsigned _counter;
+    static thread_local unsigned _counter;
     unsigned _number;
 
 public:
     Label();
+    explicit Label(unsigned number);
     unsigned number() const;
+
+    static unsigned count();
+    static void reset(unsigned counter = 0);
 };
 
 std::ostream &operator<<(std::ostream &ostr, const Label &label);
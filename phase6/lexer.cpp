@@ -10,23 +10,65 @@
  *		- checking for invalid character constants
  */
 
-# include <map>
 # include <cstdio>
-# include <cerrno>
-# include <cctype>
-# include <cstdlib>
+# include <climits>
 # include <iostream>
 # include "string.h"
 # include "lexer.h"
 # include "tokens.h"
+# include "scan.h"
+# include "context.h"
 
 using namespace std;
-int numerrors, lineno = 1;
 
 
-/* Keywords and their associated tokens */
+/* Character classes, indexed by character.  These replace isspace(),
+   isalpha(), and friends, which consult the locale on every call.  EOF
+   converts to 255 when indexing, which has no class, as we want. */
 
-static map<string, int> keywords = {
+enum { SPACE = 1, DIGIT = 2, LETTER = 4, WORD = DIGIT | LETTER };
+
+struct Classes {
+    unsigned char of[256];
+};
+
+static constexpr Classes makeClasses()
+{
+    Classes table = {};
+
+    for (int i = 0; i < 256; i ++) {
+	if (i == ' ' || (i >= '\t' && i <= '\r'))
+	    table.of[i] = SPACE;
+	else if (i >= '0' && i <= '9')
+	    table.of[i] = DIGIT;
+	else if ((i >= 'a' && i <= 'z') || (i >= 'A' && i <= 'Z') || i == '_')
+	    table.of[i] = LETTER;
+    }
+
+    return table;
+}
+
+static constexpr Classes classes = makeClasses();
+
+static inline bool is(int c, int mask)
+{
+    return classes.of[(unsigned char) c] & mask;
+}
+
+
+/* Keywords and their associated tokens.  Keywords are found with a
+   perfect hash of the first two characters, the last character, and the
+   length, so an identifier costs one probe and one comparison.  The
+   table is built at compile time, which also checks that no two
+   keywords collide.  If you add a keyword and the check fails, find new
+   multipliers for keyhash(). */
+
+struct Keyword {
+    const char *lexeme;
+    int token;
+};
+
+static constexpr Keyword keywords[] = {
     {"auto", AUTO},
     {"break", BREAK},
     {"case", CASE},
@@ -61,326 +103,401 @@ static map<string, int> keywords = {
     {"while", WHILE},
 };
 
+static constexpr unsigned KEYWORD_SLOTS = 64;
+static constexpr unsigned KEYWORD_MIN = 2, KEYWORD_MAX = 8;
 
-/*
- * Function:	report
- *
- * Description:	Report an error to the standard error prefixed with the
- *		line number.  We'll be using this a lot later with an
- *		optional string argument, but C++'s stupid streams don't do
- *		positional arguments, so we actually resort to snprintf.
- *		You just can't beat C for doing things down and dirty.
- */
-
-void report(const string &str, const string &arg)
+static constexpr unsigned keyhash(string_view s)
 {
-    char buf[1000];
+    unsigned h = 11 * (unsigned char) s[0] + 25 * (unsigned char) s[1];
 
-    snprintf(buf, sizeof(buf), str.c_str(), arg.c_str());
-    cerr << "line " << lineno << ": " << buf << endl;
-    numerrors ++;
+    h += (unsigned char) s[s.size() - 1] + 3 * s.size();
+    return h % KEYWORD_SLOTS;
 }
 
+struct KeywordTable {
+    Keyword slots[KEYWORD_SLOTS];
+    bool perfect;
+};
 
-/*
- * Function:	lexan
- *
- * Description:	Read and tokenize the standard input stream.  The lexeme is
- *		stored in a buffer.
- */
-
-int lexan(string &lexbuf)
+static constexpr KeywordTable makeKeywordTable()
 {
-    static int c = cin.get();
-    bool invalid, overflow;
-    long val;
-    int p;
+    KeywordTable table = {};
+    unsigned h = 0;
 
+    table.perfect = true;
 
-    /* The invariant here is that the next character has already been read
-       and is ready to be classified.  In this way, we eliminate having to
-       push back characters onto the stream, merely to read them again. */
+    for (auto &keyword : keywords) {
+	string_view s(keyword.lexeme);
+	h = keyhash(s);
 
-    while (!cin.eof()) {
-	lexbuf.clear();
+	if (table.slots[h].lexeme != nullptr)
+	    table.perfect = false;
 
+	if (s.size() < KEYWORD_MIN || s.size() > KEYWORD_MAX)
+	    table.perfect = false;
 
-	/* Ignore white space */
-
-	while (isspace(c)) {
-	    if (c == '\n')
-		lineno ++;
+	table.slots[h] = keyword;
+    }
 
-	    c = cin.get();
-	}
+    return table;
+}
 
+static constexpr KeywordTable keywordTable = makeKeywordTable();
+static_assert(keywordTable.perfect, "keyword hash is not perfect");
 
-	/* Check for an identifier or a keyword */
 
-	if (isalpha(c) || c == '_') {
-	    do {
-		lexbuf += c;
-		c = cin.get();
-	    } while (isalnum(c) || c == '_');
+/* Operators and the other punctuation that starts a token.  The
+   recognizer is a DFA generated at compile time from this list, taking
+   the longest match.  Comments and literals are recognized by their
+   opening characters and then scanned by hand. */
 
-	    if (keywords.count(lexbuf) > 0)
-		return keywords[lexbuf];
+enum { COMMENT = DONE + 1 };
 
-	    return ID;
+struct Operator {
+    const char *lexeme;
+    int token;
+};
 
+static constexpr Operator operators[] = {
+    {"|", '|'}, {"||", OR}, {"=", '='}, {"==", EQL}, {"&", '&'},
+    {"&&", AND}, {"!", '!'}, {"!=", NEQ}, {"<", '<'}, {"<=", LEQ},
+    {">", '>'}, {">=", GEQ}, {"-", '-'}, {"--", DEC}, {"->", ARROW},
+    {"+", '+'}, {"++", INC}, {"*", '*'}, {"%", '%'}, {":", ':'},
+    {";", ';'}, {"(", '('}, {")", ')'}, {"[", '['}, {"]", ']'},
+    {"{", '{'}, {"}", '}'}, {".", '.'}, {",", ','}, {"/", '/'},
+    {"/*", COMMENT}, {"\"", STRING}, {"'", CHARACTER},
+};
 
-	/* Check for a number */
+static constexpr unsigned DFA_STATES = 64;
 
-	} else if (isdigit(c)) {
-	    do {
-		lexbuf += c;
-		c = cin.get();
-	    } while (isdigit(c));
+struct DFA {
+    unsigned char next[DFA_STATES][128];
+    int accept[DFA_STATES];
+    bool complete;
+};
 
-	    errno = 0;
-	    val = strtol(lexbuf.c_str(), NULL, 0);
+static constexpr DFA makeDFA()
+{
+    DFA dfa = {};
+    unsigned state = 0, count = 1;
 
-	    if (errno != 0 || val != (int) val)
-		report("integer constant too large");
+    dfa.complete = true;
 
-	    return NUM;
+    for (auto &op : operators) {
+	state = 0;
 
+	for (const char *p = op.lexeme; *p != '\0'; p ++) {
+	    if (dfa.next[state][(int) *p] == 0) {
+		if (count == DFA_STATES) {
+		    dfa.complete = false;
+		    return dfa;
+		}
 
-	/* There must be an easier way to do this.  It might seem stupid at
-	   this point to recognize each token separately, but eventually
-	   we'll be returning separate token values to the parser, so we
-	   might as well do it now. */
+		dfa.next[state][(int) *p] = count ++;
+	    }
 
-	} else {
-	    lexbuf += c;
+	    state = dfa.next[state][(int) *p];
+	}
 
-	    switch(c) {
+	dfa.accept[state] = op.token;
+    }
 
 
-	    /* Check for '|' and '||' */
+    /* Every state must accept, so that the longest match never has to
+       back up over characters it has already consumed. */
 
-	    case '|':
-		c = cin.get();
+    for (state = 1; state < count; state ++)
+	if (dfa.accept[state] == 0)
+	    dfa.complete = false;
 
-		if (c == '|') {
-		    lexbuf += c;
-		    c = cin.get();
-		    return OR;
-		}
+    return dfa;
+}
 
-		return '|';
+static constexpr DFA dfa = makeDFA();
+static_assert(dfa.complete, "operator DFA is incomplete");
 
 
-	    /* Check for '=' and '==' */
+/*
+ * Function:	report
+ *
+ * Description:	Report an error to the error stream of the unit prefixed
+ *		with the line number, and with its name if it has one.
+ *		We'll be using this a lot later with an optional string
+ *		argument, but C++'s stupid streams don't do positional
+ *		arguments, so we actually resort to snprintf.  You just
+ *		can't beat C for doing things down and dirty.  The line is
+ *		written all at once, since other units may be reporting
+ *		errors at the same time.
+ */
 
-	    case '=':
-		c = cin.get();
+void report(const string &str, const string &arg)
+{
+    char buf[1000];
+    string line;
 
-		if (c == '=') {
-		    lexbuf += c;
-		    c = cin.get();
-		    return EQL;
-		}
+    snprintf(buf, sizeof(buf), str.c_str(), arg.c_str());
 
-		return '=';
+    if (!context->name.empty())
+	line = context->name + ": ";
 
+    line += "line " + to_string(context->lineno) + ": " + buf + "\n";
+    *context->errors << line << flush;
+    context->numerrors ++;
+}
 
-	    /* Check for '&' and '&&' */
 
-	    case '&':
-		c = cin.get();
+/*
+ * Function:	lexinit
+ *
+ * Description:	Start tokenizing the given buffer, which must remain valid
+ *		for as long as any lexeme taken from it is in use.
+ */
 
-		if (c == '&') {
-		    lexbuf += c;
-		    c = cin.get();
-		    return AND;
-		}
+void lexinit(const char *begin, const char *end)
+{
+    context->cp = begin;
+    context->limit = end;
+    context->c = context->cp < context->limit ? (unsigned char) *context->cp : EOF;
+}
 
-		return '&';
 
+/*
+ * Function:	advance (private)
+ *
+ * Description:	Move to the next character in the buffer, which becomes
+ *		the current character, or EOF if there is none.
+ */
 
-	    /* Check for '!' and '!=' */
+static inline void advance(CompilerContext &unit)
+{
+    if (unit.cp < unit.limit)
+	unit.cp ++;
 
-	    case '!':
-		c = cin.get();
+    unit.c = unit.cp < unit.limit ? (unsigned char) *unit.cp : EOF;
+}
 
-		if (c == '=') {
-		    lexbuf += c;
-		    c = cin.get();
-		    return NEQ;
-		}
 
-		return '!';
+/*
+ * Function:	seek (private)
+ *
+ * Description:	Move directly to the given character in the buffer, which
+ *		becomes the current character, or EOF if there is none.
+ */
 
+static inline void seek(CompilerContext &unit, const char *p)
+{
+    unit.cp = p;
+    unit.c = unit.cp < unit.limit ? (unsigned char) *unit.cp : EOF;
+}
 
-	    /* Check for '<' and '<=' */
 
-	    case '<':
-		c = cin.get();
+/*
+ * Function:	literal (private)
+ *
+ * Description:	Scan the remainder of a string or character literal whose
+ *		opening quote has already been read, and return whether it
+ *		was properly terminated.  A character following a backslash
+ *		is always taken as part of the literal.  Runs of ordinary
+ *		characters are skipped in bulk.
+ */
 
-		if (c == '=') {
-		    lexbuf += c;
-		    c = cin.get();
-		    return LEQ;
-		}
+static bool literal(CompilerContext &unit, char quote)
+{
+    int p = quote;
 
-		return '<';
 
+    if (unit.c == '\n')
+	unit.lineno ++;
 
-	    /* Check for '>' and '>=' */
+    while (p == '\\' || (unit.c != quote && unit.c != '\n' && unit.c != EOF)) {
+	if (p != '\\' && unit.c != '\\') {
+	    seek(unit, findQuote(unit.cp, unit.limit, quote));
+	    p = 0;
+	} else {
+	    p = p == '\\' ? 0 : unit.c;
+	    advance(unit);
+	}
 
-	    case '>':
-		c = cin.get();
+	if (unit.c == '\n')
+	    unit.lineno ++;
+    }
 
-		if (c == '=') {
-		    lexbuf += c;
-		    c = cin.get();
-		    return GEQ;
-		}
+    return unit.c != '\n' && unit.c != EOF;
+}
 
-		return '>';
 
+/*
+ * Function:	lexan
+ *
+ * Description:	Tokenize the input buffer.  The lexeme is returned as a view
+ *		into the buffer, so nothing is copied here; the caller must
+ *		copy anything it wants to keep.  An identifier is also
+ *		interned, using the hash computed while scanning it, and
+ *		its name is returned.
+ */
 
-	    /* Check for '-', '--', and '->' */
+int lexan(string_view &lexbuf, Name &name)
+{
+    CompilerContext &unit = *context;
+    bool invalid, overflow;
+    const char *start;
+    unsigned state, hash;
+    string_view s;
+    long val;
+    int p;
 
-	    case '-':
-		c = cin.get();
 
-		if (c == '-') {
-		    lexbuf += c;
-		    c = cin.get();
-		    return DEC;
-		} else if (c == '>') {
-		    lexbuf += c;
-		    c = cin.get();
-		    return ARROW;
-		}
+    /* The invariant here is that the next character has already been read
+       and is ready to be classified.  In this way, we eliminate having to
+       push back characters onto the stream, merely to read them again.
+       The lexeme is everything from where we started up to the current
+       character. */
 
-		return '-';
+    while (unit.c != EOF) {
+	lexbuf = string_view();
 
 
-	    /* Check for '+' and '++' */
+	/* Ignore white space */
 
-	    case '+':
-		c = cin.get();
+	if (is(unit.c, SPACE))
+	    seek(unit, skipSpace(unit.cp, unit.limit, unit.lineno));
 
-		if (c == '+') {
-		    lexbuf += c;
-		    c = cin.get();
-		    return INC;
-		}
+	start = unit.cp;
 
-		return '+';
 
+	/* Check for an identifier or a keyword */
 
-	    /* Check for simple, single character tokens */
+	if (is(unit.c, LETTER)) {
+	    hash = Name::basis;
 
-	    case '*': case '%': case ':': case ';':
-	    case '(': case ')': case '[': case ']':
-	    case '{': case '}': case '.': case ',':
-		c = cin.get();
-		return lexbuf[0];
+	    do {
+		hash = Name::mix(hash, unit.c);
+		advance(unit);
+	    } while (is(unit.c, WORD));
 
+	    lexbuf = string_view(start, unit.cp - start);
 
-	    /* Check for '/' or a comment */
+	    if (lexbuf.size() >= KEYWORD_MIN && lexbuf.size() <= KEYWORD_MAX) {
+		const Keyword &keyword = keywordTable.slots[keyhash(lexbuf)];
 
-	    case '/':
-		c = cin.get();
+		if (keyword.lexeme != nullptr && lexbuf == keyword.lexeme)
+		    return keyword.token;
+	    }
 
-		if (c == '*') {
-		    do {
-			while (c != '*' && !cin.eof()) {
-			    if (c == '\n')
-				lineno ++;
+	    name = Name(lexbuf, hash);
+	    return ID;
 
-			    c = cin.get();
-			}
 
-			c = cin.get();
-		    } while (c != '/' && !cin.eof());
+	/* Check for a number.  A leading zero means octal, just like
+	   strtol() would do, and we stop at the first invalid digit. */
 
-		    c = cin.get();
-		    break;
+	} else if (is(unit.c, DIGIT)) {
+	    do {
+		advance(unit);
+	    } while (is(unit.c, DIGIT));
 
-		} else
-		    return '/';
+	    lexbuf = string_view(start, unit.cp - start);
+	    p = (lexbuf[0] == '0' ? 8 : 10);
+	    val = 0;
 
+	    for (auto digit : lexbuf) {
+		if (digit - '0' >= p || val > INT_MAX)
+		    break;
 
-	    /* Check for a string literal */
+		val = val * p + (digit - '0');
+	    }
 
-	    case '"':
-		do {
-		    p = c;
-		    c = cin.get();
-		    lexbuf += c;
+	    if (val > INT_MAX)
+		report("integer constant too large");
 
-		    if (c == '\n')
-			lineno ++;
+	    return NUM;
+	}
 
-		} while (p == '\\' || (c != '"' && c != '\n' && !cin.eof()));
 
-		if (c == '\n' || cin.eof())
-		    report("premature end of string constant");
-		else {
-		    string s = lexbuf.substr(1, lexbuf.size() - 2);
-		    s = parseString(s, invalid, overflow);
+	/* Run the operator DFA as far as it will go.  If it can't even
+	   start, then we have either reached the end or found an illegal
+	   character. */
 
-		    if (invalid)
-			report("unknown escape sequence");
-		    else if (overflow)
-			report("escape sequence out of range");
-		}
+	state = 0;
 
-		c = cin.get();
-		return STRING;
+	while (unit.c >= 0 && unit.c < 128 && dfa.next[state][unit.c] != 0) {
+	    state = dfa.next[state][unit.c];
+	    advance(unit);
+	}
 
+	if (state == 0) {
+	    if (unit.c == EOF)
+		return DONE;
 
-	    /* Check for a character literal */
+	    advance(unit);
+	    lexbuf = string_view(start, 1);
+	    return ILLEGAL;
+	}
 
-	    case '\'':
-		do {
-		    p = c;
-		    c = cin.get();
-		    lexbuf += c;
+	lexbuf = string_view(start, unit.cp - start);
 
-		    if (c == '\n')
-			lineno ++;
 
-		} while (p == '\\' || (c != '\'' && c != '\n' && !cin.eof()));
+	/* Skip a comment.  We have already read the opening star. */
 
-		if (c == '\n' || cin.eof())
-		    report("premature end of character constant");
-		else {
-		    string s = lexbuf.substr(1, lexbuf.size() - 2);
-		    s = parseString(s, invalid, overflow);
+	if (dfa.accept[state] == COMMENT) {
+	    while (unit.c != '/' && unit.c != EOF) {
+		seek(unit, findStar(unit.cp, unit.limit, unit.lineno));
+		advance(unit);
+	    }
 
-		    if (invalid)
-			report("unknown escape sequence");
-		    else if (overflow)
-			report("escape sequence out of range");
-		    else if (s.size() == 0)
-			report("empty character constant");
-		    else if (s.size() != 1)
-			report("multi-character character constant");
-		}
+	    advance(unit);
+	    continue;
+	}
 
-		c = cin.get();
-		return CHARACTER;
 
+	/* Check for a string literal.  We have already read the opening
+	   quote. */
 
-	    /* Handle EOF here as well */
+	if (dfa.accept[state] == STRING) {
+	    if (!literal(unit, '"'))
+		report("premature end of string constant");
+	    else {
+		s = string_view(start + 1, unit.cp - start - 1);
+		parseString(s, invalid, overflow);
 
-	    case EOF:
-		return DONE;
+		if (invalid)
+		    report("unknown escape sequence");
+		else if (overflow)
+		    report("escape sequence out of range");
+	    }
 
+	    advance(unit);
+	    lexbuf = string_view(start, unit.cp - start);
+	    return STRING;
+	}
 
-	    /* Everything else is illegal */
 
-	    default:
-		c = cin.get();
-		return ILLEGAL;
+	/* Check for a character literal.  We have already read the opening
+	   quote. */
+
+	if (dfa.accept[state] == CHARACTER) {
+	    if (!literal(unit, '\''))
+		report("premature end of character constant");
+	    else {
+		s = string_view(start + 1, unit.cp - start - 1);
+		string t = parseString(s, invalid, overflow);
+
+		if (invalid)
+		    report("unknown escape sequence");
+		else if (overflow)
+		    report("escape sequence out of range");
+		else if (t.size() == 0)
+		    report("empty character constant");
+		else if (t.size() != 1)
+		    report("multi-character character constant");
 	    }
+
+	    advance(unit);
+	    lexbuf = string_view(start, unit.cp - start);
+	    return CHARACTER;
 	}
+
+	return dfa.accept[state];
     }
 
     return DONE;
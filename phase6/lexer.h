@@ -8,10 +8,11 @@
 # ifndef LEXER_H
 # define LEXER_H
 # include <string>
+# include <string_view>
+# include "Name.h"
 
-extern int lineno, numerrors;
-
-int lexan(std::string &lexbuf);
+void lexinit(const char *begin, const char *end);
+int lexan(std::string_view &lexbuf, Name &name);
 void report(const std::string &str, const std::string &arg = "");
 
 # endif /* LEXER_H */
@@ -0,0 +1,910 @@
+/*
+ * File:	lower.cpp
+ *
+ * Description:	This file contains the member function definitions for
+ *		lowering the tree of a function to its intermediate
+ *		representation in static single assignment form.  The
+ *		actual classes are declared elsewhere, mainly in Tree.h.
+ *
+ *		The form is built as the tree is walked, using the
+ *		algorithm of Braun et al.: a variable kept in a register is
+ *		looked up in the current vertex, and then recursively in
+ *		its predecessors, inserting phis where they meet.  A vertex
+ *		is sealed once all of its predecessors are known, and until
+ *		then a read of a variable in it leaves a phi to be completed
+ *		when it is.  Variables in memory are simply loaded and
+ *		stored.  No attempt is made to avoid trivial phis, since the
+ *		optimizer removes them.
+ *
+ *		Statements after a return cannot be reached, since Simple C
+ *		has no labels, and so are not lowered at all.
+ *
+ *		The state of the walk belongs to each thread, since the
+ *		functions of different translation units may be lowered at
+ *		the same time.
+ */
+
+# include <map>
+# include <cstdlib>
+# include "lower.h"
+# include "generator.h"
+# include "machine.h"
+
+using namespace std;
+
+static thread_local Graph *graph;
+static thread_local int current, undefined;
+
+static thread_local vector<map<const Symbol *, int>> defs;
+static thread_local vector<vector<pair<const Symbol *, int>>> incomplete;
+static thread_local vector<char> sealed;
+
+static int readVariable(const Symbol *symbol, int vertex);
+
+
+/*
+ * Function:	slotOf (private)
+ *
+ * Description:	Return an operand for a slot in the stack frame.
+ */
+
+static Operand slotOf(int offset)
+{
+    Operand op;
+
+    op.kind = Operand::MEMORY;
+    op.base = EBP;
+    op.value = offset;
+    return op;
+}
+
+
+/*
+ * Function:	vertex (private)
+ *
+ * Description:	Add a new vertex to the graph.
+ */
+
+static int vertex()
+{
+    int v = addVertex(*graph);
+
+
+    defs.resize(v + 1);
+    incomplete.resize(v + 1);
+    sealed.resize(v + 1);
+
+    defs[v].clear();
+    incomplete[v].clear();
+    sealed[v] = false;
+    return v;
+}
+
+
+/*
+ * Function:	enter (private)
+ *
+ * Description:	Start adding instructions to a vertex, which lays it out
+ *		after the vertices entered before it.
+ */
+
+static void enter(int v, bool aligned = false)
+{
+    current = v;
+    graph->order.push_back(v);
+    graph->vertices[v].aligned = aligned;
+}
+
+
+/*
+ * Function:	emit (private)
+ *
+ * Description:	Add an instruction to the current vertex.
+ */
+
+static int emit(Op op, const vector<int> &args = {})
+{
+    return addValue(*graph, current, op, args);
+}
+
+
+/*
+ * Function:	constant (private)
+ *
+ * Description:	Add a constant to the current vertex.
+ */
+
+static int constant(int value)
+{
+    int v = emit(OP_CONST);
+
+
+    graph->values[v].constant = value;
+    return v;
+}
+
+
+/*
+ * Function:	jump (private)
+ *
+ * Description:	End the current vertex with a jump to another.
+ */
+
+static void jump(int to)
+{
+    emit(OP_JUMP);
+    addEdge(*graph, current, to);
+    current = -1;
+}
+
+
+/*
+ * Function:	branch (private)
+ *
+ * Description:	End the current vertex with a branch on whether a value is
+ *		nonzero.
+ */
+
+static void branch(int cond, int ifTrue, int ifFalse)
+{
+    emit(OP_BRANCH, {cond});
+    addEdge(*graph, current, ifTrue);
+    addEdge(*graph, current, ifFalse);
+    current = -1;
+}
+
+
+/*
+ * Function:	writeVariable (private)
+ *
+ * Description:	Record the value of a variable at the end of a vertex.
+ */
+
+static void writeVariable(const Symbol *symbol, int vertex, int value)
+{
+    defs[vertex][symbol] = value;
+}
+
+
+/*
+ * Function:	addOperands (private)
+ *
+ * Description:	Give a phi for a variable its operands, which are the
+ *		values of the variable at the end of each predecessor.
+ */
+
+static void addOperands(const Symbol *symbol, int phi)
+{
+    const vector<int> &preds = graph->vertices[graph->values[phi].vertex].preds;
+    int value;
+
+
+    for (unsigned i = 0; i < preds.size(); i ++) {
+	value = readVariable(symbol, preds[i]);
+	graph->values[phi].args.push_back(value);
+    }
+}
+
+
+/*
+ * Function:	readVariable (private)
+ *
+ * Description:	Return the value of a variable on entry to a vertex, or at
+ *		the current point if it is the current one.
+ */
+
+static int readVariable(const Symbol *symbol, int vertex)
+{
+    const vector<int> &preds = graph->vertices[vertex].preds;
+    auto i = defs[vertex].find(symbol);
+    int value;
+
+
+    if (i != defs[vertex].end())
+	return i->second;
+
+    if (!sealed[vertex]) {
+	value = addPhi(*graph, vertex);
+	incomplete[vertex].push_back({symbol, value});
+
+    } else if (preds.size() == 1)
+	value = readVariable(symbol, preds[0]);
+
+    else if (preds.empty())
+	value = undefined;
+
+    else {
+	value = addPhi(*graph, vertex);
+	writeVariable(symbol, vertex, value);
+	addOperands(symbol, value);
+    }
+
+    writeVariable(symbol, vertex, value);
+    return value;
+}
+
+
+/*
+ * Function:	seal (private)
+ *
+ * Description:	Seal a vertex now that all of its predecessors are known,
+ *		completing the phis left in it.
+ */
+
+static void seal(int vertex)
+{
+    vector<pair<const Symbol *, int>> phis;
+
+
+    phis.swap(incomplete[vertex]);
+    sealed[vertex] = true;
+
+    for (auto &phi : phis)
+	addOperands(phi.first, phi.second);
+}
+
+
+/*
+ * Function:	promoted (private)
+ *
+ * Description:	Return whether an expression is a variable kept in a
+ *		register, and if so, its symbol.
+ */
+
+static bool promoted(Expression *expr, Symbol *&symbol)
+{
+    return expr->isIdentifier(symbol) && symbol->_register != nullptr;
+}
+
+
+/*
+ * Function:	address (private)
+ *
+ * Description:	Lower the address of an lvalue.
+ */
+
+static int address(Expression *lvalue)
+{
+    Expression *expr;
+    int offset, v;
+
+
+    if (lvalue->isDereference(expr))
+	return expr->evaluate();
+
+    if (lvalue->isField(expr, offset)) {
+	v = address(expr);
+	return offset != 0 ? emit(OP_ADD, {v, constant(offset)}) : v;
+    }
+
+    v = emit(OP_ADDRESS);
+    graph->values[v].object = lvalue->operand();
+    return v;
+}
+
+
+/*
+ * Function:	binary (private)
+ *
+ * Description:	Lower a binary operator.
+ */
+
+static int binary(Op op, Expression *left, Expression *right)
+{
+    int l = left->evaluate();
+    int r = right->evaluate();
+
+
+    return emit(op, {l, r});
+}
+
+
+/*
+ * Function:	Expression::evaluate
+ *
+ * Description:	Lower an lvalue expression, which is a load from its
+ *		address.
+ */
+
+int Expression::evaluate()
+{
+    int v = emit(OP_LOAD, {address(this)});
+
+
+    graph->values[v].size = _type.size();
+    return v;
+}
+
+
+/*
+ * Function:	Expression::condition
+ *
+ * Description:	Lower an expression used as a condition, which branches on
+ *		whether its value is nonzero.
+ */
+
+void Expression::condition(int ifTrue, int ifFalse)
+{
+    branch(evaluate(), ifTrue, ifFalse);
+}
+
+
+/*
+ * Function:	Identifier::evaluate
+ *
+ * Description:	Lower an identifier, which is the current value of a
+ *		variable kept in a register and otherwise a load.
+ */
+
+int Identifier::evaluate()
+{
+    if (_symbol->_register != nullptr)
+	return readVariable(_symbol, current);
+
+    return Expression::evaluate();
+}
+
+
+/*
+ * Function:	Number::evaluate
+ *
+ * Description:	Lower a number.
+ */
+
+int Number::evaluate()
+{
+    return constant(strtoul(_value.c_str(), NULL, 0));
+}
+
+
+/*
+ * Function:	Call::evaluate
+ *
+ * Description:	Lower a function call.  The arguments are evaluated from
+ *		last to first, as when generating code directly.
+ */
+
+int Call::evaluate()
+{
+    vector<int> args(_args.size());
+    int v;
+
+
+    for (int i = _args.size() - 1; i >= 0; i --)
+	args[i] = _args[i]->evaluate();
+
+    if (_expr->type().isCallback())
+	args.insert(args.begin(), _expr->evaluate());
+
+    v = emit(OP_CALL, args);
+
+    if (!_expr->type().isCallback())
+	graph->values[v].object = Target(_expr->operand().symbol);
+
+    return v;
+}
+
+
+/*
+ * Function:	Not::evaluate
+ *
+ * Description:	Lower a logical negation, which is a comparison with zero.
+ */
+
+int Not::evaluate()
+{
+    int v = _expr->evaluate();
+
+
+    return emit(OP_EQ, {v, constant(0)});
+}
+
+
+/*
+ * Function:	Not::condition
+ *
+ * Description:	Lower a logical negation used as a condition by swapping
+ *		the targets.
+ */
+
+void Not::condition(int ifTrue, int ifFalse)
+{
+    _expr->condition(ifFalse, ifTrue);
+}
+
+
+/*
+ * Function:	Negate::evaluate
+ *
+ * Description:	Lower an arithmetic negation.
+ */
+
+int Negate::evaluate()
+{
+    return emit(OP_NEG, {_expr->evaluate()});
+}
+
+
+/*
+ * Function:	Address::evaluate
+ *
+ * Description:	Lower an address expression.
+ */
+
+int Address::evaluate()
+{
+    return address(_expr);
+}
+
+
+/*
+ * Function:	Cast::evaluate
+ *
+ * Description:	Lower a cast, which only does anything when a character
+ *		is extended to an integer.
+ */
+
+int Cast::evaluate()
+{
+    int v = _expr->evaluate();
+
+
+    if (_type.size() == SIZEOF_REG && _expr->type().size() == 1)
+	return emit(OP_EXTEND, {v});
+
+    return v;
+}
+
+
+/*
+ * Function:	Multiply::evaluate
+ *
+ * Description:	Lower a multiplication.
+ */
+
+int Multiply::evaluate()
+{
+    return binary(OP_MUL, _left, _right);
+}
+
+
+/*
+ * Function:	Divide::evaluate
+ *
+ * Description:	Lower a division.
+ */
+
+int Divide::evaluate()
+{
+    return binary(OP_DIV, _left, _right);
+}
+
+
+/*
+ * Function:	Remainder::evaluate
+ *
+ * Description:	Lower a remainder.
+ */
+
+int Remainder::evaluate()
+{
+    return binary(OP_REM, _left, _right);
+}
+
+
+/*
+ * Function:	Add::evaluate
+ *
+ * Description:	Lower an addition.
+ */
+
+int Add::evaluate()
+{
+    return binary(OP_ADD, _left, _right);
+}
+
+
+/*
+ * Function:	Subtract::evaluate
+ *
+ * Description:	Lower a subtraction.
+ */
+
+int Subtract::evaluate()
+{
+    return binary(OP_SUB, _left, _right);
+}
+
+
+/*
+ * Function:	LessThan::evaluate
+ *
+ * Description:	Lower a less-than comparison.
+ */
+
+int LessThan::evaluate()
+{
+    return binary(OP_LT, _left, _right);
+}
+
+
+/*
+ * Function:	GreaterThan::evaluate
+ *
+ * Description:	Lower a greater-than comparison.
+ */
+
+int GreaterThan::evaluate()
+{
+    return binary(OP_GT, _left, _right);
+}
+
+
+/*
+ * Function:	LessOrEqual::evaluate
+ *
+ * Description:	Lower a less-than-or-equal comparison.
+ */
+
+int LessOrEqual::evaluate()
+{
+    return binary(OP_LE, _left, _right);
+}
+
+
+/*
+ * Function:	GreaterOrEqual::evaluate
+ *
+ * Description:	Lower a greater-than-or-equal comparison.
+ */
+
+int GreaterOrEqual::evaluate()
+{
+    return binary(OP_GE, _left, _right);
+}
+
+
+/*
+ * Function:	Equal::evaluate
+ *
+ * Description:	Lower an equality comparison.
+ */
+
+int Equal::evaluate()
+{
+    return binary(OP_EQ, _left, _right);
+}
+
+
+/*
+ * Function:	NotEqual::evaluate
+ *
+ * Description:	Lower an inequality comparison.
+ */
+
+int NotEqual::evaluate()
+{
+    return binary(OP_NE, _left, _right);
+}
+
+
+/*
+ * Function:	logical (private)
+ *
+ * Description:	Lower the value of a logical expression.  The result is
+ *		one if the condition leads to a new vertex, and zero along
+ *		every edge that skips it.
+ */
+
+static int logical(Expression *expr)
+{
+    int zero = constant(0), one, phi, join, yes;
+
+
+    yes = vertex();
+    join = vertex();
+
+    expr->condition(yes, join);
+    seal(yes);
+
+    enter(yes);
+    one = constant(1);
+    jump(join);
+
+    seal(join);
+    enter(join);
+    phi = addPhi(*graph, join);
+
+    for (auto p : graph->vertices[join].preds)
+	graph->values[phi].args.push_back(p == yes ? one : zero);
+
+    return phi;
+}
+
+
+/*
+ * Function:	LogicalAnd::evaluate
+ *
+ * Description:	Lower the value of a logical-and expression.
+ */
+
+int LogicalAnd::evaluate()
+{
+    return logical(this);
+}
+
+
+/*
+ * Function:	LogicalAnd::condition
+ *
+ * Description:	Lower a logical-and expression used as a condition, which
+ *		only tests the right operand if the left one is true.
+ */
+
+void LogicalAnd::condition(int ifTrue, int ifFalse)
+{
+    int next = vertex();
+
+
+    _left->condition(next, ifFalse);
+    seal(next);
+    enter(next);
+    _right->condition(ifTrue, ifFalse);
+}
+
+
+/*
+ * Function:	LogicalOr::evaluate
+ *
+ * Description:	Lower the value of a logical-or expression.
+ */
+
+int LogicalOr::evaluate()
+{
+    return logical(this);
+}
+
+
+/*
+ * Function:	LogicalOr::condition
+ *
+ * Description:	Lower a logical-or expression used as a condition, which
+ *		only tests the right operand if the left one is false.
+ */
+
+void LogicalOr::condition(int ifTrue, int ifFalse)
+{
+    int next = vertex();
+
+
+    _left->condition(ifTrue, next);
+    seal(next);
+    enter(next);
+    _right->condition(ifTrue, ifFalse);
+}
+
+
+/*
+ * Function:	Assignment::lower
+ *
+ * Description:	Lower an assignment statement.  As when generating code
+ *		directly, the right-hand side is evaluated first.
+ */
+
+void Assignment::lower()
+{
+    int value = _right->evaluate();
+    Symbol *symbol;
+    int v;
+
+
+    if (promoted(_left, symbol))
+	writeVariable(symbol, current, value);
+
+    else {
+	v = emit(OP_STORE, {address(_left), value});
+	graph->values[v].size = _left->type().size();
+    }
+}
+
+
+/*
+ * Function:	Return::lower
+ *
+ * Description:	Lower a return statement.
+ */
+
+void Return::lower()
+{
+    emit(OP_RETURN, {_expr->evaluate()});
+    current = -1;
+}
+
+
+/*
+ * Function:	Block::lower
+ *
+ * Description:	Lower a block, stopping at any statement that cannot be
+ *		reached.
+ */
+
+void Block::lower()
+{
+    for (auto stmt : _stmts) {
+	if (current < 0)
+	    break;
+
+	stmt->lower();
+    }
+}
+
+
+/*
+ * Function:	Simple::lower
+ *
+ * Description:	Lower an expression statement.
+ */
+
+void Simple::lower()
+{
+    _expr->evaluate();
+}
+
+
+/*
+ * Function:	loop (private)
+ *
+ * Description:	Lower a loop with the test at the bottom, entering it by
+ *		jumping to the test, or by a copy of the test if the condition
+ *		is to be copied, just as when generating code directly.
+ */
+
+static void loop(Expression *expr, Statement *body, Statement *incr)
+{
+    int top = vertex(), exit = vertex(), test = -1;
+    bool copy = duplicate(expr);
+
+
+    if (copy)
+	expr->condition(top, exit);
+    else {
+	test = vertex();
+	jump(test);
+    }
+
+    enter(top, true);
+    body->lower();
+
+    if (incr != nullptr && current >= 0)
+	incr->lower();
+
+    if (copy) {
+	if (current >= 0)
+	    expr->condition(top, exit);
+
+    } else {
+	if (current >= 0)
+	    jump(test);
+
+	seal(test);
+	enter(test);
+	expr->condition(top, exit);
+    }
+
+    seal(top);
+    seal(exit);
+    enter(exit);
+}
+
+
+/*
+ * Function:	While::lower
+ *
+ * Description:	Lower a while statement.
+ */
+
+void While::lower()
+{
+    loop(_expr, _stmt, nullptr);
+}
+
+
+/*
+ * Function:	For::lower
+ *
+ * Description:	Lower a for statement.
+ */
+
+void For::lower()
+{
+    _init->lower();
+    loop(_expr, _stmt, _incr);
+}
+
+
+/*
+ * Function:	If::lower
+ *
+ * Description:	Lower an if-then or if-then-else statement.  The vertex
+ *		after it cannot be reached if both branches return.
+ */
+
+void If::lower()
+{
+    int then = vertex(), next = vertex(), exit;
+
+
+    _expr->condition(then, next);
+    seal(then);
+
+    enter(then);
+    _thenStmt->lower();
+
+    if (_elseStmt == nullptr) {
+	if (current >= 0)
+	    jump(next);
+
+	seal(next);
+	enter(next);
+	return;
+    }
+
+    exit = vertex();
+
+    if (current >= 0)
+	jump(exit);
+
+    seal(next);
+    enter(next);
+    _elseStmt->lower();
+
+    if (current >= 0)
+	jump(exit);
+
+    seal(exit);
+
+    if (!graph->vertices[exit].preds.empty())
+	enter(exit);
+}
+
+
+/*
+ * Function:	lower
+ *
+ * Description:	Lower the body of a function.  The parameters kept in
+ *		registers are loaded from their slots on entry.  Falling
+ *		off the end of the function returns nothing.
+ */
+
+void lower(Graph &g, const Symbol *function, Block *body)
+{
+    const Symbols &symbols = body->declarations()->symbols();
+    Parameters *params = function->type().parameters();
+    int slot, value;
+
+
+    graph = &g;
+    graph->values.clear();
+    graph->vertices.clear();
+    graph->order.clear();
+
+    enter(vertex());
+    seal(0);
+    undefined = emit(OP_UNDEF);
+
+    for (unsigned i = 0; i < params->size(); i ++)
+	if (symbols[i]->_register != nullptr) {
+	    slot = emit(OP_ADDRESS);
+	    graph->values[slot].object = slotOf(symbols[i]->_offset);
+	    value = emit(OP_LOAD, {slot});
+	    graph->values[value].size = SIZEOF_REG;
+	    writeVariable(symbols[i], 0, value);
+	}
+
+    body->lower();
+
+    if (current >= 0)
+	emit(OP_RETURN);
+
+    removeUnreachable(*graph);
+}
@@ -0,0 +1,17 @@
+/*
+ * File:	lower.h
+ *
+ * Description:	This file contains the function declaration for lowering
+ *		the tree of a function to its intermediate representation.
+ *		Most of the function declarations are actually member
+ *		functions provided as part of Tree.h.
+ */
+
+# ifndef LOWER_H
+# define LOWER_H
+# include "ssa.h"
+# include "Tree.h"
+
+void lower(Graph &graph, const Symbol *function, Block *body);
+
+# endif /* LOWER_H */
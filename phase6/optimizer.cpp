@@ -0,0 +1,870 @@
+/*
+ * File:	optimizer.cpp
+ *
+ * Description:	This file contains the optimizer for Simple C, which is a
+ *		pipeline of passes over the intermediate representation of
+ *		each function.  Each pass runs at a given optimization level
+ *		and above, unless "-f name" or "-f no-name" says otherwise,
+ *		and is timed like the passes over the assembly code.  The
+ *		number of values each pass removes or rewrites is counted,
+ *		so that "-s" can show which ones pay for themselves.
+ *
+ *		To add a pass, write a function that rewrites the graph and
+ *		returns how much it changed, and enter it in the table
+ *		below.  The passes are run in the order they appear.
+ */
+
+# include <atomic>
+# include <cassert>
+# include <climits>
+# include <cstring>
+# include <sstream>
+# include <algorithm>
+# include <unordered_map>
+# include "optimizer.h"
+# include "timing.h"
+# include "machine.h"
+
+using namespace std;
+
+struct Pass {
+    const char *name;
+    unsigned level;
+    unsigned long (*run)(Graph &graph);
+    int forced;				/* -1, or enabled by -f or not */
+    atomic<unsigned long> hits;
+};
+
+unsigned optimizationLevel = 1;
+
+static thread_local vector<int> replacement;
+static thread_local vector<vector<int>> users;
+
+
+/*
+ * Function:	findUsers (private)
+ *
+ * Description:	Compute the values that use each value in the graph.
+ */
+
+static void findUsers(const Graph &graph)
+{
+    users.resize(graph.values.size());
+
+    for (auto &u : users)
+	u.clear();
+
+    for (auto v : graph.order) {
+	for (auto phi : graph.vertices[v].phis)
+	    for (auto arg : graph.values[phi].args)
+		users[arg].push_back(phi);
+
+	for (auto value : graph.vertices[v].values)
+	    for (auto arg : graph.values[value].args)
+		users[arg].push_back(value);
+    }
+}
+
+
+/*
+ * Function:	leader (private)
+ *
+ * Description:	Return the value that a value has been forwarded to,
+ *		compressing the path to it along the way.
+ */
+
+static int leader(int value)
+{
+    int root = value, next;
+
+
+    while (replacement[root] != root)
+	root = replacement[root];
+
+    while (replacement[value] != root) {
+	next = replacement[value];
+	replacement[value] = root;
+	value = next;
+    }
+
+    return root;
+}
+
+
+/*
+ * Function:	replace (private)
+ *
+ * Description:	Replace every use of a value that has been forwarded with
+ *		the value it was forwarded to, and remove it.
+ */
+
+static unsigned long replace(Graph &graph)
+{
+    unsigned long count = 0;
+
+
+    for (auto v : graph.order) {
+	Vertex &vertex = graph.vertices[v];
+
+	for (auto phi : vertex.phis)
+	    for (auto &arg : graph.values[phi].args)
+		arg = leader(arg);
+
+	for (auto value : vertex.values)
+	    for (auto &arg : graph.values[value].args)
+		arg = leader(arg);
+    }
+
+    for (unsigned i = 0; i < replacement.size(); i ++)
+	if (replacement[i] != (int) i && graph.values[i].vertex >= 0) {
+	    removeValue(graph, i);
+	    count ++;
+	}
+
+    compact(graph);
+    return count;
+}
+
+
+/*
+ * Function:	fold (private)
+ *
+ * Description:	Compute the result of an operation on constants, if it can
+ *		be computed.  Integers wrap around, as they do on the
+ *		machine, and a division that would trap is left alone.
+ */
+
+static bool fold(Op op, int left, int right, int &result)
+{
+    unsigned l = left, r = right;
+
+
+    switch (op) {
+    case OP_COPY: result = left; break;
+    case OP_ADD: result = l + r; break;
+    case OP_SUB: result = l - r; break;
+    case OP_MUL: result = l * r; break;
+    case OP_NEG: result = -l; break;
+    case OP_EXTEND: result = (signed char) left; break;
+
+    case OP_DIV:
+    case OP_REM:
+	if (right == 0 || (left == INT_MIN && right == -1))
+	    return false;
+
+	result = op == OP_DIV ? left / right : left % right;
+	break;
+
+    case OP_EQ: result = left == right; break;
+    case OP_NE: result = left != right; break;
+    case OP_LT: result = left < right; break;
+    case OP_GT: result = left > right; break;
+    case OP_LE: result = left <= right; break;
+    case OP_GE: result = left >= right; break;
+
+    default:
+	return false;
+    }
+
+    return true;
+}
+
+
+/*
+ * The state of sparse conditional constant propagation.  A value is
+ * unknown until it is found to be either a constant or not one, and an
+ * edge, numbered twice its source plus its position, is only followed
+ * once it is found to be taken.
+ */
+
+enum { UNKNOWN, CONSTANT, VARYING };
+
+static thread_local vector<unsigned char> state;
+static thread_local vector<int> known;
+static thread_local vector<char> visited, taken;
+static thread_local vector<int> blocks, pending;
+
+
+/*
+ * Function:	setState (private)
+ *
+ * Description:	Move a value down the lattice, and if it moved, revisit
+ *		the values that use it.
+ */
+
+static void setState(int value, unsigned char s, int c)
+{
+    if (s == UNKNOWN || state[value] == VARYING)
+	return;
+
+    if (state[value] == CONSTANT) {
+	if (s == CONSTANT && known[value] == c)
+	    return;
+
+	s = VARYING;
+    }
+
+    state[value] = s;
+    known[value] = c;
+
+    for (auto user : users[value])
+	pending.push_back(user);
+}
+
+
+/*
+ * Function:	take (private)
+ *
+ * Description:	Mark an edge as taken, and if it is new, visit its target.
+ */
+
+static void take(const Graph &graph, int v, unsigned i)
+{
+    if (!taken[2 * v + i]) {
+	taken[2 * v + i] = true;
+	blocks.push_back(graph.vertices[v].succs[i]);
+    }
+}
+
+
+/*
+ * Function:	isTaken (private)
+ *
+ * Description:	Return whether any edge between two vertices is taken.
+ */
+
+static bool isTaken(const Graph &graph, int from, int to)
+{
+    const vector<int> &succs = graph.vertices[from].succs;
+
+
+    for (unsigned i = 0; i < succs.size(); i ++)
+	if (succs[i] == to && taken[2 * from + i])
+	    return true;
+
+    return false;
+}
+
+
+/*
+ * Function:	evaluate (private)
+ *
+ * Description:	Compute the state of a value from those of its operands.
+ *		A phi only meets the operands along edges that are taken,
+ *		and a terminator takes the edges it might.  A branch on an
+ *		unknown condition takes both, since the condition might be
+ *		undefined and so never become known.
+ */
+
+static void evaluate(const Graph &graph, int value)
+{
+    const Value &v = graph.values[value];
+    unsigned char s;
+    int c, result = 0;
+
+
+    switch (v.op) {
+    case OP_CONST:
+	setState(value, CONSTANT, v.constant);
+	break;
+
+    case OP_UNDEF:
+    case OP_STORE:
+	break;
+
+    case OP_ADDRESS:
+    case OP_LOAD:
+    case OP_CALL:
+	setState(value, VARYING, 0);
+	break;
+
+    case OP_PHI: {
+	const vector<int> &preds = graph.vertices[v.vertex].preds;
+
+	for (unsigned i = 0; i < v.args.size(); i ++)
+	    if (isTaken(graph, preds[i], v.vertex))
+		setState(value, state[v.args[i]], known[v.args[i]]);
+
+	break;
+    }
+
+    case OP_JUMP:
+	take(graph, v.vertex, 0);
+	break;
+
+    case OP_BRANCH:
+	s = state[v.args[0]];
+
+	if (s == CONSTANT)
+	    take(graph, v.vertex, known[v.args[0]] != 0 ? 0 : 1);
+	else {
+	    take(graph, v.vertex, 0);
+	    take(graph, v.vertex, 1);
+	}
+
+	break;
+
+    case OP_RETURN:
+	break;
+
+    default:
+	s = CONSTANT;
+
+	for (auto arg : v.args)
+	    if (state[arg] == VARYING)
+		s = VARYING;
+	    else if (state[arg] == UNKNOWN && s == CONSTANT)
+		s = UNKNOWN;
+
+	if (s == CONSTANT) {
+	    c = v.args.size() > 1 ? known[v.args[1]] : 0;
+
+	    if (!fold(v.op, known[v.args[0]], c, result))
+		s = VARYING;
+	}
+
+	setState(value, s, result);
+	break;
+    }
+}
+
+
+/*
+ * Function:	propagateConstants (private)
+ *
+ * Description:	Propagate constants using the sparse conditional algorithm
+ *		of Wegman and Zadeck, which only follows the edges that
+ *		might be taken and so finds the constants that hold along
+ *		them.  Values found to be constant are rewritten as such,
+ *		branches on constants become jumps, and the vertices that
+ *		can no longer be reached are removed.
+ */
+
+static unsigned long propagateConstants(Graph &graph)
+{
+    unsigned long count = 0;
+    int v, value;
+
+
+    findUsers(graph);
+    state.assign(graph.values.size(), UNKNOWN);
+    known.assign(graph.values.size(), 0);
+    visited.assign(graph.vertices.size(), false);
+    taken.assign(2 * graph.vertices.size(), false);
+    blocks.assign(1, 0);
+    pending.clear();
+
+    while (!blocks.empty() || !pending.empty()) {
+	if (!blocks.empty()) {
+	    v = blocks.back();
+	    blocks.pop_back();
+
+	    for (auto phi : graph.vertices[v].phis)
+		evaluate(graph, phi);
+
+	    if (!visited[v]) {
+		visited[v] = true;
+
+		for (auto value : graph.vertices[v].values)
+		    evaluate(graph, value);
+	    }
+
+	} else {
+	    value = pending.back();
+	    pending.pop_back();
+
+	    if (graph.values[value].vertex >= 0 && visited[graph.values[value].vertex])
+		evaluate(graph, value);
+	}
+    }
+
+    /* Rewrite the constants, moving any phis among them to the front. */
+
+    for (auto v : graph.order) {
+	Vertex &vertex = graph.vertices[v];
+	vector<int> phis, values;
+
+	if (!visited[v])
+	    continue;
+
+	for (auto phi : vertex.phis)
+	    (state[phi] == CONSTANT ? values : phis).push_back(phi);
+
+	values.insert(values.end(), vertex.values.begin(), vertex.values.end());
+	vertex.phis.swap(phis);
+	vertex.values.swap(values);
+
+	for (auto value : vertex.values) {
+	    Value &x = graph.values[value];
+
+	    if (state[value] == CONSTANT && x.op != OP_CONST) {
+		x.op = OP_CONST;
+		x.constant = known[value];
+		x.args.clear();
+		count ++;
+	    }
+	}
+    }
+
+    /* Turn the branches that go only one way into jumps. */
+
+    for (auto v : graph.order) {
+	Vertex &vertex = graph.vertices[v];
+
+	if (!visited[v] || vertex.values.empty())
+	    continue;
+
+	Value &last = graph.values[vertex.values.back()];
+
+	if (last.op == OP_BRANCH && taken[2 * v] != taken[2 * v + 1]) {
+	    int dead = vertex.succs[taken[2 * v] ? 1 : 0];
+
+	    last.op = OP_JUMP;
+	    last.args.clear();
+	    removeEdge(graph, v, dead);
+	    count ++;
+	}
+    }
+
+    removeUnreachable(graph);
+    return count;
+}
+
+
+/*
+ * Function:	propagateCopies (private)
+ *
+ * Description:	Replace each copy with the value it copies, and each phi
+ *		whose operands are all the same value, other than the phi
+ *		itself, with that value.  Replacing one phi can make another
+ *		trivial, so we repeat until none are left.
+ */
+
+static unsigned long propagateCopies(Graph &graph)
+{
+    bool changed;
+    int same, arg;
+
+
+    replacement.resize(graph.values.size());
+
+    for (unsigned i = 0; i < replacement.size(); i ++)
+	replacement[i] = i;
+
+    do {
+	changed = false;
+
+	for (auto v : graph.order) {
+	    Vertex &vertex = graph.vertices[v];
+
+	    for (auto phi : vertex.phis) {
+		if (replacement[phi] != phi)
+		    continue;
+
+		same = -1;
+
+		for (auto a : graph.values[phi].args) {
+		    arg = leader(a);
+
+		    if (arg == phi || arg == same)
+			continue;
+
+		    if (same >= 0) {
+			same = -2;
+			break;
+		    }
+
+		    same = arg;
+		}
+
+		if (same >= 0) {
+		    replacement[phi] = same;
+		    changed = true;
+		}
+	    }
+
+	    for (auto value : vertex.values)
+		if (graph.values[value].op == OP_COPY && replacement[value] == value) {
+		    replacement[value] = leader(graph.values[value].args[0]);
+		    changed = true;
+		}
+	}
+    } while (changed);
+
+    return replace(graph);
+}
+
+
+/*
+ * The key by which global value numbering recognizes a value computed
+ * again.  A load also depends upon the state of memory, which is
+ * numbered anew after every store or call.
+ */
+
+struct Key {
+    Op op;
+    unsigned char size;
+    int left, right;
+    int constant, memory;
+    int base, offset, label;
+    unsigned symbol;
+
+    bool operator ==(const Key &rhs) const {
+	return op == rhs.op && size == rhs.size && left == rhs.left
+	    && right == rhs.right && constant == rhs.constant
+	    && memory == rhs.memory && base == rhs.base
+	    && offset == rhs.offset && label == rhs.label
+	    && symbol == rhs.symbol;
+    }
+};
+
+struct KeyHash {
+    size_t operator ()(const Key &key) const {
+	size_t h = key.op;
+
+	for (int x : {(int) key.size, key.left, key.right, key.constant,
+		key.memory, key.base, key.offset, key.label, (int) key.symbol})
+	    h = h * 31 + x;
+
+	return h;
+    }
+};
+
+static thread_local unordered_map<Key, int, KeyHash> table;
+static thread_local vector<pair<Key, int>> undo;
+static thread_local vector<int> generations;
+static thread_local int memory;
+
+
+/*
+ * Function:	keyOf (private)
+ *
+ * Description:	Return the key of a value computed in the given state of
+ *		memory.
+ */
+
+static Key keyOf(const Value &v, int generation)
+{
+    Key key = {v.op, v.size, -1, -1, v.constant, -1, NOREG, 0, -1, 0};
+
+
+    if (!v.args.empty())
+	key.left = v.args[0];
+
+    if (v.args.size() > 1)
+	key.right = v.args[1];
+
+    if (isCommutative(v.op) && key.left > key.right)
+	swap(key.left, key.right);
+
+    if (v.op == OP_LOAD)
+	key.memory = generation;
+
+    if (v.op == OP_ADDRESS) {
+	key.base = v.object.base;
+	key.offset = v.object.value;
+	key.label = v.object.label;
+	key.symbol = v.object.symbol.id();
+    }
+
+    return key;
+}
+
+
+/*
+ * Function:	enter (private)
+ *
+ * Description:	Enter a key into the table, remembering what it replaced
+ *		so that it can be restored.
+ */
+
+static void enter(const Key &key, int value)
+{
+    auto i = table.find(key);
+
+
+    undo.push_back({key, i == table.end() ? -1 : i->second});
+    table[key] = value;
+}
+
+
+/*
+ * Function:	numberValues (private)
+ *
+ * Description:	Number the values in a vertex, forwarding each that
+ *		computes the same thing as one before it to that one.
+ *		Since the vertices are visited in a walk of the dominator
+ *		tree, the values in the table all dominate the current one.
+ *		A store records the value it stores as that of a load from
+ *		the same address, until memory changes again.
+ */
+
+static void numberValues(Graph &graph, int v, int generation)
+{
+    Vertex &vertex = graph.vertices[v];
+    Value load;
+    int same;
+
+
+    for (auto phi : vertex.phis) {
+	vector<int> &args = graph.values[phi].args;
+
+	same = leader(args[0]);
+
+	for (auto arg : args)
+	    if (leader(arg) != same)
+		same = -1;
+
+	if (same >= 0 && same != phi)
+	    replacement[phi] = same;
+    }
+
+    for (auto value : vertex.values) {
+	Value &x = graph.values[value];
+
+	for (auto &arg : x.args)
+	    arg = leader(arg);
+
+	if (x.op == OP_STORE) {
+	    generation = ++ memory;
+
+	    if (x.size == SIZEOF_REG) {
+		load = {OP_LOAD, x.size, v, 0, Operand(), {x.args[0]}};
+		enter(keyOf(load, generation), x.args[1]);
+	    }
+
+	} else if (x.op == OP_CALL)
+	    generation = ++ memory;
+
+	else if (x.op == OP_LOAD || (isPure(x.op) && x.op != OP_UNDEF)) {
+	    Key key = keyOf(x, generation);
+	    auto i = table.find(key);
+
+	    if (i != table.end())
+		replacement[value] = i->second;
+	    else
+		enter(key, value);
+	}
+    }
+
+    generations[v] = generation;
+}
+
+
+/*
+ * Function:	numberGlobally (private)
+ *
+ * Description:	Remove redundant computations by walking the dominator
+ *		tree with a scoped table of the values computed.  A vertex
+ *		inherits the state of memory from its dominator only if
+ *		that is its sole predecessor.
+ */
+
+static unsigned long numberGlobally(Graph &graph)
+{
+    vector<int> idom, rpo;
+    vector<vector<int>> children;
+    vector<pair<int, unsigned>> stack;
+    int v, child, generation;
+    unsigned mark;
+
+
+    dominators(graph, idom, rpo);
+    children.resize(graph.vertices.size());
+
+    for (auto v : rpo)
+	if (v != 0)
+	    children[idom[v]].push_back(v);
+
+    replacement.resize(graph.values.size());
+
+    for (unsigned i = 0; i < replacement.size(); i ++)
+	replacement[i] = i;
+
+    generations.assign(graph.vertices.size(), 0);
+    table.clear();
+    undo.clear();
+    memory = 0;
+
+    numberValues(graph, 0, ++ memory);
+    stack.push_back({0, undo.size()});
+
+    while (!stack.empty()) {
+	v = stack.back().first;
+	mark = stack.back().second;
+
+	if (children[v].empty()) {
+	    while (undo.size() > mark) {
+		if (undo.back().second < 0)
+		    table.erase(undo.back().first);
+		else
+		    table[undo.back().first] = undo.back().second;
+
+		undo.pop_back();
+	    }
+
+	    stack.pop_back();
+	    continue;
+	}
+
+	child = children[v].back();
+	children[v].pop_back();
+	stack.push_back({child, undo.size()});
+
+	if (graph.vertices[child].preds == vector<int>{v})
+	    generation = generations[v];
+	else
+	    generation = ++ memory;
+
+	numberValues(graph, child, generation);
+    }
+
+    return replace(graph);
+}
+
+
+/*
+ * Function:	eliminateDeadCode (private)
+ *
+ * Description:	Remove the values that are never used.  Stores, calls, and
+ *		terminators are live, and so is every value they use,
+ *		directly or indirectly.
+ */
+
+static unsigned long eliminateDeadCode(Graph &graph)
+{
+    vector<char> live(graph.values.size(), false);
+    unsigned long count = 0;
+    int value;
+
+
+    pending.clear();
+
+    for (auto v : graph.order)
+	for (auto value : graph.vertices[v].values) {
+	    Op op = graph.values[value].op;
+
+	    if (op == OP_STORE || op == OP_CALL || isTerminator(op)) {
+		live[value] = true;
+		pending.push_back(value);
+	    }
+	}
+
+    while (!pending.empty()) {
+	value = pending.back();
+	pending.pop_back();
+
+	for (auto arg : graph.values[value].args)
+	    if (!live[arg]) {
+		live[arg] = true;
+		pending.push_back(arg);
+	    }
+    }
+
+    for (auto v : graph.order) {
+	for (auto phi : graph.vertices[v].phis)
+	    if (!live[phi]) {
+		removeValue(graph, phi);
+		count ++;
+	    }
+
+	for (auto value : graph.vertices[v].values)
+	    if (!live[value]) {
+		removeValue(graph, value);
+		count ++;
+	    }
+    }
+
+    compact(graph);
+    return count;
+}
+
+
+/*
+ * Function:	print (private)
+ *
+ * Description:	Write the graph to the standard error, which is only done
+ *		when asked for by "-f print".  The graph is written all at
+ *		once, since other functions may be printed at the same time.
+ */
+
+static unsigned long print(Graph &graph)
+{
+    ostringstream ostr;
+
+    ostr << graph;
+    cerr << ostr.str();
+    return 0;
+}
+
+
+static Pass passes[] = {
+    {"copyprop", 1, propagateCopies, -1, 0},
+    {"gvn", 2, numberGlobally, -1, 0},
+    {"constprop", 1, propagateConstants, -1, 0},
+    {"dce", 1, eliminateDeadCode, -1, 0},
+    {"print", UINT_MAX, print, -1, 0},
+};
+
+static const unsigned NUM_PASSES = sizeof(passes) / sizeof(passes[0]);
+
+
+/*
+ * Function:	selectPass
+ *
+ * Description:	Enable a pass by name, or disable it if its name is
+ *		preceded by "no-", regardless of the optimization level.
+ *		Return false if there is no such pass.
+ */
+
+bool selectPass(const char *option)
+{
+    bool enable = strncmp(option, "no-", 3) != 0;
+
+
+    if (!enable)
+	option += 3;
+
+    for (unsigned i = 0; i < NUM_PASSES; i ++)
+	if (strcmp(passes[i].name, option) == 0) {
+	    passes[i].forced = enable;
+	    return true;
+	}
+
+    return false;
+}
+
+
+/*
+ * Function:	optimize
+ *
+ * Description:	Run the enabled passes over the graph of a function.
+ */
+
+void optimize(Graph &graph)
+{
+    for (auto &pass : passes) {
+	if (pass.forced >= 0 ? pass.forced : optimizationLevel >= pass.level) {
+	    pass.hits += pass.run(graph);
+	    stopTiming(pass.name);
+	}
+    }
+}
+
+
+/*
+ * Function:	optimizerStatistics
+ *
+ * Description:	Write the number of values each pass changed to the given
+ *		stream.
+ */
+
+void optimizerStatistics(ostream &ostr)
+{
+    ostr << "optimizer:";
+
+    for (unsigned i = 0; i < NUM_PASSES - 1; i ++)
+	ostr << (i > 0 ? ", " : " ") << passes[i].hits << " " << passes[i].name;
+
+    ostr << endl;
+}
@@ -0,0 +1,20 @@
+/*
+ * File:	optimizer.h
+ *
+ * Description:	This file contains the function declarations for the
+ *		optimizer for Simple C, which runs a pipeline of passes over
+ *		the intermediate representation of each function.
+ */
+
+# ifndef OPTIMIZER_H
+# define OPTIMIZER_H
+# include <ostream>
+# include "ssa.h"
+
+extern unsigned optimizationLevel;
+
+bool selectPass(const char *option);
+void optimize(Graph &graph);
+void optimizerStatistics(std::ostream &ostr);
+
+# endif /* OPTIMIZER_H */
@@ -6,39 +6,116 @@
  *		Simple C.
  */
 
+# include <cerrno>
+# include <future>
+# include <vector>
+# include <algorithm>
 # include <cstdlib>
+# include <cstring>
 # include <iostream>
+# include <unordered_set>
+# include <fcntl.h>
+# include <getopt.h>
+# include <unistd.h>
 # include "generator.h"
+# include "assembly.h"
+# include "peephole.h"
+# include "regalloc.h"
+# include "deadcode.h"
+# include "timing.h"
+# include "pool.h"
+# include "server.h"
+# include "cache.h"
+# include "optimizer.h"
 # include "checker.h"
 # include "tokens.h"
 # include "string.h"
+# include "source.h"
 # include "lexer.h"
+# include "parser.h"
 # include "Tree.h"
 
 using namespace std;
 
-static int lookahead;
-static string lexbuf;
-
 static Expression *expression();
 static Statement *statement();
-static Type returnType;
+
+
+/* A syntax error unwinds all the way back to compile(), since our parser
+   does not do error recovery, and so does running out of names. */
+
+struct SyntaxError {
+};
 
 
 /*
  * Function:	error
  *
- * Description:	Report a syntax error to standard error.
+ * Description:	Report a syntax error to standard error and abandon the
+ *		compilation.
  */
 
 static void error()
 {
-    if (lookahead == DONE)
+    if (context->lookahead == DONE)
 	report("syntax error at end of file");
     else
-	report("syntax error at '%s'", lexbuf);
+	report("syntax error at '%s'", string(context->lexbuf));
 
-    exit(EXIT_FAILURE);
+    throw SyntaxError();
+}
+
+
+/*
+ * Function:	full
+ *
+ * Description:	Report that the table of names is full and abandon the
+ *		compilation.  Only this unit fails, and the names already
+ *		in the table can still be used by any other.
+ */
+
+static void full()
+{
+    report("too many distinct names");
+    throw SyntaxError();
+}
+
+
+/*
+ * Function:	next
+ *
+ * Description:	Read the next token.  An identifier can only have the
+ *		empty name if the table of names is full.
+ */
+
+static void next()
+{
+    context->lookahead = lexan(context->lexbuf, context->lexname);
+
+    if (context->lookahead == ID && context->lexname == Name())
+	full();
+}
+
+
+/*
+ * Function:	remember
+ *
+ * Description:	Add a matched token to the key of the current function, and
+ *		remember the name of an identifier so that its type can be
+ *		added once the function is done.
+ */
+
+static void remember(int t)
+{
+    unsigned length = context->lexbuf.size();
+
+
+    context->fingerprint.append((const char *) &t, sizeof(t));
+    context->fingerprint.append((const char *) &length, sizeof(length));
+    context->fingerprint += context->lexbuf;
+
+    if (t == ID)
+	context->references.push_back(context->lexname);
 }
 
 
@@ -46,16 +123,19 @@ static void error()
  * Function:	match
  *
  * Description:	Match the next token against the specified token.  A
- *		failure indicates a syntax error and will terminate the
- *		program since our parser does not do error recovery.
+ *		failure indicates a syntax error and will abandon the
+ *		compilation since our parser does not do error recovery.
  */
 
 static void match(int t)
 {
-    if (lookahead != t)
+    if (context->lookahead != t)
 	error();
 
-    lookahead = lexan(lexbuf);
+    if (cacheFunctions)
+	remember(t);
+
+    next();
 }
 
 
@@ -70,7 +150,7 @@ static unsigned number()
     string buf;
 
 
-    buf = lexbuf;
+    buf = string(context->lexbuf);
     match(NUM);
     return strtoul(buf.c_str(), NULL, 0);
 }
@@ -82,14 +162,14 @@ static unsigned number()
  * Description:	Match the next token as an identifier and return its name.
  */
 
-static string identifier()
+static Name identifier()
 {
-    string buf;
+    Name name;
 
 
-    buf = lexbuf;
+    name = context->lexname;
     match(ID);
-    return buf;
+    return name;
 }
 
 
@@ -117,14 +197,14 @@ static bool isSpecifier(int token)
  *		  struct identifier
  */
 
-static string specifier()
+static Name specifier()
 {
-    if (lookahead == INT) {
+    if (context->lookahead == INT) {
 	match(INT);
 	return "int";
     }
 
-    if (lookahead == CHAR) {
+    if (context->lookahead == CHAR) {
 	match(CHAR);
 	return "char";
     }
@@ -149,7 +229,7 @@ static unsigned pointers()
     unsigned count = 0;
 
 
-    while (lookahead == '*') {
+    while (context->lookahead == '*') {
 	match('*');
 	count ++;
     }
@@ -172,15 +252,15 @@ static unsigned pointers()
  *		  pointers ( * identifier ) ( )
  */
 
-static void declarator(const string &typespec)
+static void declarator(const Name &typespec)
 {
     unsigned indirection;
-    string name;
+    Name name;
 
 
     indirection = pointers();
 
-    if (lookahead == '(') {
+    if (context->lookahead == '(') {
 	match('(');
 	match('*');
 	name = identifier();
@@ -192,7 +272,7 @@ static void declarator(const string &typespec)
     } else {
 	name = identifier();
 
-	if (lookahead == '[') {
+	if (context->lookahead == '[') {
 	    match('[');
 	    declareSymbol(name, Array(typespec, indirection, number()));
 	    match(']');
@@ -219,13 +299,13 @@ static void declarator(const string &typespec)
 
 static void declaration()
 {
-    string typespec;
+    Name typespec;
 
 
     typespec = specifier();
     declarator(typespec);
 
-    while (lookahead == ',') {
+    while (context->lookahead == ',') {
 	match(',');
 	declarator(typespec);
     }
@@ -246,7 +326,7 @@ static void declaration()
 
 static void declarations()
 {
-    while (isSpecifier(lookahead))
+    while (isSpecifier(context->lookahead))
 	declaration();
 }
 
@@ -273,21 +353,27 @@ static Expression *primaryExpression(bool lparen)
 	expr = expression();
 	match(')');
 
-    } else if (lookahead == CHARACTER) {
-	lexbuf = lexbuf.substr(1, lexbuf.size() - 2);
-	expr = new Number(parseString(lexbuf)[0]);
+    } else if (context->lookahead == CHARACTER) {
+	context->lexbuf = context->lexbuf.substr(1, context->lexbuf.size() - 2);
+	expr = new Number(parseString(context->lexbuf)[0]);
 	match(CHARACTER);
 
-    } else if (lookahead == STRING) {
-	lexbuf = lexbuf.substr(1, lexbuf.size() - 2);
-	expr = new String(parseString(lexbuf));
+    } else if (context->lookahead == STRING) {
+	context->lexbuf = context->lexbuf.substr(1, context->lexbuf.size() - 2);
+	string s = parseString(context->lexbuf);
+	Name value(s);
+
+	if (!s.empty() && value == Name())
+	    full();
+
+	expr = new String(value);
 	match(STRING);
 
-    } else if (lookahead == NUM) {
-	expr = new Number(lexbuf);
+    } else if (context->lookahead == NUM) {
+	expr = new Number(string(context->lexbuf));
 	match(NUM);
 
-    } else if (lookahead == ID) {
+    } else if (context->lookahead == ID) {
 	expr = new Identifier(checkIdentifier(identifier()));
 
     } else {
@@ -325,20 +411,20 @@ static Expression *postfixExpression(bool lparen)
     left = primaryExpression(lparen);
 
     while (1) {
-	if (lookahead == '[') {
+	if (context->lookahead == '[') {
 	    match('[');
 	    right = expression();
 	    left = checkArray(left, right);
 	    match(']');
 
-	} else if (lookahead == '(') {
+	} else if (context->lookahead == '(') {
 	    match('(');
 	    Expressions args;
 
-	    if (lookahead != ')') {
+	    if (context->lookahead != ')') {
 		args.push_back(expression());
 
-		while (lookahead == ',') {
+		while (context->lookahead == ',') {
 		    match(',');
 		    args.push_back(expression());
 		}
@@ -347,11 +433,11 @@ static Expression *postfixExpression(bool lparen)
 	    left = checkCall(left, args);
 	    match(')');
 
-	} else if (lookahead == '.') {
+	} else if (context->lookahead == '.') {
 	    match('.');
 	    left = checkDirectField(left, identifier());
 
-	} else if (lookahead == ARROW) {
+	} else if (context->lookahead == ARROW) {
 	    match(ARROW);
 	    left = checkIndirectField(left, identifier());
 
@@ -390,36 +476,36 @@ static Expression *prefixExpression()
 {
     Expression *expr;
     unsigned indirection;
-    string typespec;
+    Name typespec;
 
 
-    if (lookahead == '!') {
+    if (context->lookahead == '!') {
 	match('!');
 	expr = prefixExpression();
 	expr = checkNot(expr);
 
-    } else if (lookahead == '-') {
+    } else if (context->lookahead == '-') {
 	match('-');
 	expr = prefixExpression();
 	expr = checkNegate(expr);
 
-    } else if (lookahead == '*') {
+    } else if (context->lookahead == '*') {
 	match('*');
 	expr = prefixExpression();
 	expr = checkDereference(expr);
 
-    } else if (lookahead == '&') {
+    } else if (context->lookahead == '&') {
 	match('&');
 	expr = prefixExpression();
 	expr = checkAddress(expr);
 
-    } else if (lookahead == SIZEOF) {
+    } else if (context->lookahead == SIZEOF) {
 	match(SIZEOF);
 
-	if (lookahead == '(') {
+	if (context->lookahead == '(') {
 	    match('(');
 
-	    if (isSpecifier(lookahead)) {
+	    if (isSpecifier(context->lookahead)) {
 		typespec = specifier();
 		indirection = pointers();
 		expr = checkSizeof(Scalar(typespec, indirection));
@@ -434,10 +520,10 @@ static Expression *prefixExpression()
 	    expr = checkSizeof(expr->type());
 	}
 
-    } else if (lookahead == '(') {
+    } else if (context->lookahead == '(') {
 	match('(');
 
-	if (isSpecifier(lookahead)) {
+	if (isSpecifier(context->lookahead)) {
 	    typespec = specifier();
 	    indirection = pointers();
 	    match(')');
@@ -473,17 +559,17 @@ static Expression *multiplicativeExpression()
     left = prefixExpression();
 
     while (1) {
-	if (lookahead == '*') {
+	if (context->lookahead == '*') {
 	    match('*');
 	    right = prefixExpression();
 	    left = checkMultiply(left, right);
 
-	} else if (lookahead == '/') {
+	} else if (context->lookahead == '/') {
 	    match('/');
 	    right = prefixExpression();
 	    left = checkDivide(left, right);
 
-	} else if (lookahead == '%') {
+	} else if (context->lookahead == '%') {
 	    match('%');
 	    right = prefixExpression();
 	    left = checkRemainder(left, right);
@@ -515,12 +601,12 @@ static Expression *additiveExpression()
     left = multiplicativeExpression();
 
     while (1) {
-	if (lookahead == '+') {
+	if (context->lookahead == '+') {
 	    match('+');
 	    right = multiplicativeExpression();
 	    left = checkAdd(left, right);
 
-	} else if (lookahead == '-') {
+	} else if (context->lookahead == '-') {
 	    match('-');
 	    right = multiplicativeExpression();
 	    left = checkSubtract(left, right);
@@ -556,22 +642,22 @@ static Expression *relationalExpression()
     left = additiveExpression();
 
     while (1) {
-	if (lookahead == '<') {
+	if (context->lookahead == '<') {
 	    match('<');
 	    right = additiveExpression();
 	    left = checkLessThan(left, right);
 
-	} else if (lookahead == '>') {
+	} else if (context->lookahead == '>') {
 	    match('>');
 	    right = additiveExpression();
 	    left = checkGreaterThan(left, right);
 
-	} else if (lookahead == LEQ) {
+	} else if (context->lookahead == LEQ) {
 	    match(LEQ);
 	    right = additiveExpression();
 	    left = checkLessOrEqual(left, right);
 
-	} else if (lookahead == GEQ) {
+	} else if (context->lookahead == GEQ) {
 	    match(GEQ);
 	    right = additiveExpression();
 	    left = checkGreaterOrEqual(left, right);
@@ -603,12 +689,12 @@ static Expression *equalityExpression()
     left = relationalExpression();
 
     while (1) {
-	if (lookahead == EQL) {
+	if (context->lookahead == EQL) {
 	    match(EQL);
 	    right = relationalExpression();
 	    left = checkEqual(left, right);
 
-	} else if (lookahead == NEQ) {
+	} else if (context->lookahead == NEQ) {
 	    match(NEQ);
 	    right = relationalExpression();
 	    left = checkNotEqual(left, right);
@@ -639,7 +725,7 @@ static Expression *logicalAndExpression()
 
     left = equalityExpression();
 
-    while (lookahead == AND) {
+    while (context->lookahead == AND) {
 	match(AND);
 	right = equalityExpression();
 	left = checkLogicalAnd(left, right);
@@ -668,7 +754,7 @@ static Expression *expression()
 
     left = logicalAndExpression();
 
-    while (lookahead == OR) {
+    while (context->lookahead == OR) {
 	match(OR);
 	right = logicalAndExpression();
 	left = checkLogicalOr(left, right);
@@ -696,7 +782,7 @@ static Statements statements()
     Statements stmts;
 
 
-    while (lookahead != '}')
+    while (context->lookahead != '}')
 	stmts.push_back(statement());
 
     return stmts;
@@ -720,7 +806,7 @@ static Statement *assignment()
 
     expr = expression();
 
-    if (lookahead == '=') {
+    if (context->lookahead == '=') {
 	match('=');
 	return checkAssignment(expr, expression());
     }
@@ -753,7 +839,7 @@ static Statement *statement()
     Statements stmts;
 
 
-    if (lookahead == '{') {
+    if (context->lookahead == '{') {
 	match('{');
 	openScope();
 	declarations();
@@ -763,15 +849,15 @@ static Statement *statement()
 	return new Block(decls, stmts);
     }
     
-    if (lookahead == RETURN) {
+    if (context->lookahead == RETURN) {
 	match(RETURN);
 	expr = expression();
-	checkReturn(expr, returnType);
+	checkReturn(expr, context->returnType);
 	match(';');
 	return new Return(expr);
     }
     
-    if (lookahead == WHILE) {
+    if (context->lookahead == WHILE) {
 	match(WHILE);
 	match('(');
 	expr = expression();
@@ -781,7 +867,7 @@ static Statement *statement()
 	return new While(expr, stmt);
     }
     
-    if (lookahead == FOR) {
+    if (context->lookahead == FOR) {
 	match(FOR);
 	match('(');
 	init = assignment();
@@ -795,7 +881,7 @@ static Statement *statement()
 	return new For(init, expr, incr, stmt);
     }
     
-    if (lookahead == IF) {
+    if (context->lookahead == IF) {
 	match(IF);
 	match('(');
 	expr = expression();
@@ -803,7 +889,7 @@ static Statement *statement()
 	match(')');
 	stmt = statement();
 
-	if (lookahead != ELSE)
+	if (context->lookahead != ELSE)
 	    return new If(expr, stmt, nullptr);
 
 	match(ELSE);
@@ -831,14 +917,14 @@ static Statement *statement()
 static Type parameter()
 {
     unsigned indirection;
-    string typespec, name;
+    Name typespec, name;
     Type type;
 
 
     typespec = specifier();
     indirection = pointers();
 
-    if (lookahead == '(') {
+    if (context->lookahead == '(') {
 	match('(');
 	match('*');
 	name = identifier();
@@ -878,15 +964,15 @@ static Parameters *parameters()
     Parameters *params;
 
 
-    params = new Parameters();
+    params = context->permanent.make<Parameters>();
 
-    if (lookahead == VOID)
+    if (context->lookahead == VOID)
 	match(VOID);
 
     else {
 	params->push_back(parameter());
 
-	while (lookahead == ',') {
+	while (context->lookahead == ',') {
 	    match(',');
 	    params->push_back(parameter());
 	}
@@ -911,15 +997,15 @@ static Parameters *parameters()
  *		  pointers ( * identifier ) ( )
  */
 
-static void globalDeclarator(const string &typespec)
+static void globalDeclarator(const Name &typespec)
 {
     unsigned indirection;
-    string name;
+    Name name;
 
 
     indirection = pointers();
 
-    if (lookahead == '(') {
+    if (context->lookahead == '(') {
 	match('(');
 	match('*');
 	name = identifier();
@@ -931,12 +1017,12 @@ static void globalDeclarator(const string &typespec)
     } else {
 	name = identifier();
 
-	if (lookahead == '(') {
+	if (context->lookahead == '(') {
 	    match('(');
 	    declareSymbol(name, Function(typespec, indirection));
 	    match(')');
 
-	} else if (lookahead == '[') {
+	} else if (context->lookahead == '[') {
 	    match('[');
 	    declareSymbol(name, Array(typespec, indirection, number()));
 	    match(']');
@@ -957,9 +1043,9 @@ static void globalDeclarator(const string &typespec)
  * 		  , global-declarator remaining-declarators
  */
 
-static void remainingDeclarators(const string &typespec)
+static void remainingDeclarators(const Name &typespec)
 {
-    while (lookahead == ',') {
+    while (context->lookahead == ',') {
 	match(',');
 	globalDeclarator(typespec);
     }
@@ -968,6 +1054,91 @@ static void remainingDeclarators(const string &typespec)
 }
 
 
+/*
+ * Function:	describe (private)
+ *
+ * Description:	Add a description of a type to the key of the current
+ *		function, noting the structure it names, if any, so that its
+ *		layout may be added as well.
+ */
+
+static void describe(const Type &type, vector<Name> &structs)
+{
+    string &key = context->fingerprint;
+
+
+    key += type.isArray() ? 'A' : type.isFunction() ? 'F' : type.isCallback() ? 'C' : 'S';
+    key += type.specifier().str();
+    key += string(type.indirection(), '*');
+
+    if (type.isArray())
+	key += '[' + to_string(type.length()) + ']';
+
+    if (type.isFunction() && type.parameters() != nullptr) {
+	key += '(';
+
+	for (auto &param : *type.parameters())
+	    describe(param, structs);
+
+	key += ')';
+    }
+
+    key += ';';
+
+    if (type.isStruct())
+	structs.push_back(type.specifier());
+}
+
+
+/*
+ * Function:	fingerprint (private)
+ *
+ * Description:	Finish the key of the function just parsed, which so far
+ *		holds its tokens.  The code for a function also depends upon
+ *		the types of the globals it names, and upon the layout of
+ *		every structure it can reach through those types or its own
+ *		declarations, so each of these is added to the key.  A name
+ *		that is a local as well as a global only adds to the key
+ *		needlessly, which is harmless.
+ */
+
+static void fingerprint()
+{
+    string &key = context->fingerprint;
+    unordered_set<Name> symbols, layouts;
+    vector<Name> structs;
+    Symbol *symbol;
+
+
+    for (auto &name : context->references)
+	if (symbols.insert(name).second) {
+	    structs.push_back(name);
+
+	    if ((symbol = context->outermost->find(name)) != nullptr) {
+		key += name.str() + ':';
+		describe(symbol->type(), structs);
+	    }
+	}
+
+    for (unsigned i = 0; i < structs.size(); i ++) {
+	auto it = context->structs.find(structs[i]);
+
+	if (it == context->structs.end() || !layouts.insert(structs[i]).second)
+	    continue;
+
+	key += "struct " + structs[i].str() + '{' + to_string(it->second.size);
+	key += ',' + to_string(it->second.alignment) + ';';
+
+	for (auto field : it->second.fields->symbols()) {
+	    key += field->name().str() + '@' + to_string(field->_offset) + ':';
+	    describe(field->type(), structs);
+	}
+
+	key += '}';
+    }
+}
+
+
 /*
  * Function:	globalOrFunction
  *
@@ -984,7 +1155,7 @@ static void remainingDeclarators(const string &typespec)
 static void globalOrFunction()
 {
     unsigned indirection;
-    string typespec, name;
+    Name typespec, name;
     Statements stmts;
     Procedure *proc;
     Symbol *symbol;
@@ -992,9 +1163,14 @@ static void globalOrFunction()
     Type type;
 
 
+    if (cacheFunctions) {
+	context->fingerprint.clear();
+	context->references.clear();
+    }
+
     typespec = specifier();
 
-    if (typespec != "int" && typespec != "char" && lookahead == '{') {
+    if (typespec != "int" && typespec != "char" && context->lookahead == '{') {
 	openStruct(typespec);
 	match('{');
 	declaration();
@@ -1006,7 +1182,7 @@ static void globalOrFunction()
     } else {
 	indirection = pointers();
 
-	if (lookahead == '(') {
+	if (context->lookahead == '(') {
 	    match('(');
 	    match('*');
 	    name = identifier();
@@ -1019,24 +1195,25 @@ static void globalOrFunction()
 	} else {
 	    name = identifier();
 
-	    if (lookahead == '[') {
+	    if (context->lookahead == '[') {
 		match('[');
 		declareSymbol(name, Array(typespec, indirection, number()));
 		match(']');
 		remainingDeclarators(typespec);
 
-	    } else if (lookahead == '(') {
+	    } else if (context->lookahead == '(') {
 		match('(');
 
-		if (lookahead == ')') {
+		if (context->lookahead == ')') {
 		    declareSymbol(name, Function(typespec, indirection));
 		    match(')');
 		    remainingDeclarators(typespec);
 
 		} else {
+		    arena = &context->transient;
 		    openScope();
 		    type = Function(typespec, indirection, parameters());
-		    returnType = Scalar(typespec, indirection);
+		    context->returnType = Scalar(typespec, indirection);
 		    symbol = defineFunction(name, type);
 		    match(')');
 		    match('{');
@@ -1046,8 +1223,19 @@ static void globalOrFunction()
 		    proc = new Procedure(symbol, new Block(decls, stmts));
 		    match('}');
 
-		    if (numerrors == 0)
-			proc->generate();
+		    if (context->numerrors == 0) {
+			if (!Assembly::nameable(name))
+			    full();
+
+			if (cacheFunctions)
+			    fingerprint();
+
+			if (!cacheFunctions || !spliceFunction())
+			    proc->generate();
+		    }
+
+		    arena = &context->permanent;
+		    context->transient.release();
 		}
 
 	    } else {
@@ -1060,19 +1248,376 @@ static void globalOrFunction()
 
 
 /*
- * Function:	main
+ * Function:	compile
  *
- * Description:	Analyze the standard input stream.
+ * Description:	Compile the translation unit in the given buffer, which
+ *		becomes the context of this thread until it is done.  A
+ *		context is good for only a single unit, but any number of
+ *		them may be compiled one after another.  Return false if a
+ *		syntax error abandoned the compilation, in which case only
+ *		the functions before the error have been written.
  */
 
-int main()
+bool compile(CompilerContext &unit, const char *begin, const char *end)
 {
+    CompilerContext *saved = context;
+    Arena *current = arena;
+    bool ok = true;
+
+
+    context = &unit;
+    arena = &unit.permanent;
+    lexinit(begin, end);
     openScope();
-    lookahead = lexan(lexbuf);
 
-    while (lookahead != DONE)
-	globalOrFunction();
+    try {
+	next();
+
+	while (context->lookahead != DONE)
+	    globalOrFunction();
+
+	generateGlobals(closeScope());
+
+    } catch (const SyntaxError &) {
+	writeFunctions();
+	ok = false;
+    }
+
+    context = saved;
+    arena = current;
+    return ok;
+}
+
+
+/*
+ * Function:	compileFile (private)
+ *
+ * Description:	Compile the named source file into an assembly file named
+ *		the same but ending in ".s" rather than ".c", and report
+ *		the time taken by each pass over it if asked.  Return false
+ *		if the file could not be read or written, or if a syntax
+ *		error abandoned its compilation.
+ */
+
+static bool compileFile(const string &program, const string &path)
+{
+    CompilerContext unit;
+    string output;
+    Source source;
+    bool ok;
+
+
+    output = path;
+
+    if (output.size() > 2 && output.compare(output.size() - 2, 2, ".c") == 0)
+	output.resize(output.size() - 2);
+
+    output += ".s";
+    unit.name = path;
+
+    if (!source.open(path)) {
+	cerr << program + ": " + path + ": " + strerror(errno) + "\n" << flush;
+	return false;
+    }
+
+    if (!unit.emitter.open(output)) {
+	cerr << program + ": " + output + ": " + strerror(errno) + "\n" << flush;
+	return false;
+    }
+
+    ok = compile(unit, source.begin(), source.end());
+
+    if (!unit.emitter.close()) {
+	cerr << program + ": " + output + ": write error: " + strerror(errno) + "\n" << flush;
+	return false;
+    }
+
+    reportTiming(cerr, path, unit.times);
+    return ok;
+}
+
+
+/*
+ * Function:	compileFiles (private)
+ *
+ * Description:	Compile each of the named source files on its own thread
+ *		from a pool of the given size, or one after another on
+ *		this thread if just one is given.  Return whether every
+ *		file was compiled.
+ */
+
+static bool compileFiles(const string &program, char *paths[], unsigned count,
+	unsigned threads)
+{
+    vector<future<void>> done;
+    vector<char> ok(count);
+    Pool pool;
+
+
+    if (threads > 1)
+	pool.start(min(threads, count));
+
+    for (unsigned i = 0; i < count; i ++)
+	done.push_back(pool.submit([&, i] {
+	    ok[i] = compileFile(program, paths[i]);
+	}));
+
+    for (auto &file : done)
+	file.get();
+
+    return find(ok.begin(), ok.end(), false) == ok.end();
+}
+
+
+/*
+ * Function:	client (private)
+ *
+ * Description:	Have the server on the socket with the given path compile
+ *		the named source file, or the standard input if none is
+ *		given, into the named output file, or the standard output
+ *		if none is given.  Return the exit status.
+ */
+
+static int client(const string &program, const string &path, const char *file,
+	const char *output)
+{
+    int input, result, status;
+
+
+    input = file != nullptr ? open(file, O_RDONLY | O_CLOEXEC) : STDIN_FILENO;
+
+    if (input < 0) {
+	cerr << program << ": " << file << ": " << strerror(errno) << endl;
+	return EXIT_FAILURE;
+    }
+
+    result = STDOUT_FILENO;
+
+    if (output != nullptr)
+	result = open(output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+
+    if (result < 0) {
+	cerr << program << ": " << output << ": " << strerror(errno) << endl;
+	return EXIT_FAILURE;
+    }
+
+    if ((status = request(path, input, result)) < 0) {
+	cerr << program << ": " << path << ": " << strerror(errno) << endl;
+	return EXIT_FAILURE;
+    }
+
+    return status;
+}
+
+
+/*
+ * Function:	main
+ *
+ * Description:	Analyze the named source file, or the standard input
+ *		stream if none is given.  The generated assembly is
+ *		written to the standard output unless "-o file" is given,
+ *		"-m" keeps every variable in memory rather than promoting
+ *		those whose address is never taken to registers, "-d"
+ *		copies small loop conditions in front of their loops
+ *		rather than jumping to the test at the bottom, "-s"
+ *		reports output, memory, dead code, register, peephole, and
+ *		optimizer statistics when done, and "-t" reports the time
+ *		taken by each pass over each function and in total.
+ *
+ *		"-O level" selects how hard to optimize.  At level 0, code
+ *		is generated directly from the tree and only has its
+ *		registers allocated, with no dead code removed and no
+ *		peephole optimizer.  At level 1, the default, and level 2,
+ *		each function is lowered to static single assignment form
+ *		and run through the optimizer first, with global value
+ *		numbering added at level 2, and dead code is removed and
+ *		the peephole optimizer run as well.  "-f pass" and
+ *		"-f no-pass" enable or disable a single pass of the
+ *		optimizer regardless of the level.
+ *
+ *		"-j threads" finishes the code for each function on a pool
+ *		of that many threads while the functions after it are being
+ *		parsed.  The output is the same no matter how many are used.
+ *
+ *		Given more than one file, each is compiled into its own
+ *		assembly file, as if by "-o" with its name ending in ".s",
+ *		and "-j threads" compiles that many files at once instead.
+ *		"-t" then also reports the time of each pass over each file,
+ *		and "-s" only the statistics shared by all of them.
+ *
+ *		"--server" instead keeps running as a compile server on a
+ *		local socket, answering requests on "-j threads" threads
+ *		with the other options given to it.  "--client" has such a
+ *		server do the work, but otherwise behaves just as the
+ *		compiler does, and takes only "-o file" and a file.  Either
+ *		may name the socket, as in "--server=path", which otherwise
+ *		is taken from the SCC_SOCKET environment variable or else is
+ *		in a directory private to the user.  Only the user who
+ *		started the server may use it, and a client only uses a
+ *		server started by the same user.
+ *
+ *		"--cache" keeps the finished code for each function in a
+ *		cache on disk, and uses it again instead of generating any
+ *		function whose tokens, and the types of the names they use,
+ *		are unchanged, as long as the options are too.  The cache
+ *		may be named, as in "--cache=directory", which otherwise is
+ *		taken from the SCC_CACHE environment variable or else is in
+ *		the cache directory of the user.  "--cache-size=megabytes"
+ *		limits its size, 64 megabytes by default, beyond which the
+ *		least recently used functions are removed.  A cache that
+ *		belongs to anyone else, or that anyone else may write to,
+ *		is not used at all.
+ */
+
+int main(int argc, char *argv[])
+{
+    static const struct option roles[] = {
+	{"server", optional_argument, nullptr, 'S'},
+	{"client", optional_argument, nullptr, 'C'},
+	{"cache", optional_argument, nullptr, 'K'},
+	{"cache-size", required_argument, nullptr, 'Z'},
+	{nullptr, 0, nullptr, 0},
+    };
+
+    const char *output = nullptr;
+    bool ok, tuned, stats = false;
+    unsigned long megabytes = 64;
+    unsigned threads = 1;
+    string path, cache, settings;
+    CompilerContext unit;
+    Source source;
+    int c, role;
+
+
+    role = 0;
+    tuned = false;
+
+    while ((c = getopt_long(argc, argv, "dmo:stO:f:j:", roles, nullptr)) != -1) {
+	tuned = tuned || (c != 'o' && c != 'S' && c != 'C');
+
+	if (c == 'd' || c == 'm' || c == 'O' || c == 'f')
+	    settings += string("-") + char(c) + (optarg != nullptr ? optarg : "") + ' ';
+
+	if (c == 'o')
+	    output = optarg;
+
+	else if (c == 'S' || c == 'C') {
+	    role = c;
+	    path = optarg != nullptr ? optarg : defaultSocket();
+
+	    if (path.empty()) {
+		cerr << argv[0] << ": no private directory for the socket: ";
+		cerr << strerror(errno) << endl;
+		exit(EXIT_FAILURE);
+	    }
+
+	} else if (c == 'K')
+	    cache = optarg != nullptr ? optarg : defaultCache();
+
+	else if (c == 'Z' && strspn(optarg, "0123456789") == strlen(optarg) && atol(optarg) > 0)
+	    megabytes = atol(optarg);
+
+	else if (c == 'd')
+	    duplicateConditions = true;
+
+	else if (c == 'm')
+	    promoteVariables = false;
+
+	else if (c == 's')
+	    stats = true;
+
+	else if (c == 't')
+	    timePasses = true;
+
+	else if (c == 'O' && strlen(optarg) == 1 && optarg[0] >= '0' && optarg[0] <= '2')
+	    optimizationLevel = optarg[0] - '0';
+
+	else if (c == 'j' && strspn(optarg, "0123456789") == strlen(optarg) && atoi(optarg) > 0)
+	    threads = atoi(optarg);
+
+	else if (c != 'f' || !selectPass(optarg)) {
+	    cerr << "usage: " << argv[0] << " [-d] [-m] [-s] [-t] [-O level] [-f [no-]pass] [-j threads] [-o file] [--cache[=directory]] [--cache-size=megabytes] [--server[=socket] | --client[=socket]] [file ...]" << endl;
+	    exit(EXIT_FAILURE);
+	}
+    }
+
+    if (!cache.empty() && role != 'C' && !openCache(cache, megabytes << 20, settings))
+	cerr << argv[0] << ": " << cache << ": " << strerror(errno) << ", not caching" << endl;
+
+    if (role == 'S') {
+	if (optind < argc || output != nullptr) {
+	    cerr << argv[0] << ": the server takes no files" << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	serve(path, threads);
+	cerr << argv[0] << ": " << path << ": " << strerror(errno) << endl;
+	exit(EXIT_FAILURE);
+    }
+
+    if (role == 'C') {
+	if (tuned || argc - optind > 1) {
+	    cerr << argv[0] << ": the client takes only -o and a file" << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	exit(client(argv[0], path, optind < argc ? argv[optind] : nullptr, output));
+    }
+
+    if (argc - optind > 1) {
+	if (output != nullptr) {
+	    cerr << argv[0] << ": cannot use -o with more than one file" << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	ok = compileFiles(argv[0], argv + optind, argc - optind, threads);
+	trimCache();
+
+    } else {
+	if (optind < argc ? !source.open(argv[optind]) : !source.open(0)) {
+	    cerr << argv[0] << ": " << (optind < argc ? argv[optind] : "stdin");
+	    cerr << ": " << strerror(errno) << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	if (output != nullptr && !unit.emitter.open(output)) {
+	    cerr << argv[0] << ": " << output << ": " << strerror(errno) << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	numThreads = threads;
+	ok = compile(unit, source.begin(), source.end());
+	trimCache();
+
+	if (!unit.emitter.close()) {
+	    cerr << argv[0] << ": write error: " << strerror(errno) << endl;
+	    exit(EXIT_FAILURE);
+	}
+    }
+
+    if (!ok)
+	exit(EXIT_FAILURE);
+
+    if (stats) {
+	if (argc - optind <= 1) {
+	    unit.emitter.statistics(cerr);
+	    cerr << "permanent arena: ";
+	    unit.permanent.statistics(cerr);
+	    cerr << "transient arena: ";
+	    unit.transient.statistics(cerr);
+	}
+
+	deadCodeStatistics(cerr);
+	allocatorStatistics(cerr);
+	peepholeStatistics(cerr);
+	optimizerStatistics(cerr);
+
+	if (cacheFunctions)
+	    cacheStatistics(cerr);
+    }
+
+    if (timePasses)
+	timingStatistics(cerr);
 
-    generateGlobals(closeScope());
     exit(EXIT_SUCCESS);
 }
@@ -0,0 +1,15 @@
+/*
+ * File:	parser.h
+ *
+ * Description:	This file contains the function declaration for the
+ *		parser for Simple C, which drives the compilation of a
+ *		translation unit.
+ */
+
+# ifndef PARSER_H
+# define PARSER_H
+# include "context.h"
+
+bool compile(CompilerContext &unit, const char *begin, const char *end);
+
+# endif /* PARSER_H */
@@ -0,0 +1,374 @@
+/*
+ * File:	peephole.cpp
+ *
+ * Description:	This file contains the peephole optimizer for Simple C.  A
+ *		window is slid over the instructions of each basic block,
+ *		and at each position the rules are tried in order.  A rule
+ *		that matches rewrites the instructions in its window in
+ *		place and returns how many of them remain, the rest being
+ *		deleted.  The window is then backed up so that the new
+ *		instructions get a chance to match as well.
+ *
+ *		To add a rule, write a function that recognizes and
+ *		rewrites its pattern and enter it in the table below.  The
+ *		number of times each rule fires is counted, so that "-s"
+ *		can show which ones pay for themselves.
+ *
+ *		The rules rely upon one property of the code generator:
+ *		no scratch register is live across a branch, since the
+ *		result of a test is released as soon as it is compared.
+ *		The condition codes, however, could be live across a
+ *		branch, so we work out which blocks read them before
+ *		setting them.
+ */
+
+# include <atomic>
+# include <unordered_set>
+# include "peephole.h"
+
+using namespace std;
+
+struct Context {
+    bool last;				/* window ends the block */
+    bool reads;				/* next block reads the flags */
+    const Operand *next;		/* label of the next block */
+    unordered_set<int> flags;		/* labels that read the flags */
+};
+
+struct Rule {
+    const char *name;
+    unsigned width;
+    int (*apply)(Instruction *window, const Context &context);
+    atomic<unsigned long> hits;
+};
+
+static const Opcode negated[] = {JNE, JE, JGE, JLE, JG, JL};
+static const int FAIL = -1;
+
+
+/*
+ * Function:	readsFlags (private)
+ *
+ * Description:	Return whether a block reads the condition codes before
+ *		setting them.  A block that does neither is assumed to
+ *		read them, since its successors might.
+ */
+
+static bool readsFlags(const BasicBlock &block)
+{
+    for (auto &insn : block.instructions) {
+	if ((insn.opcode >= SETE && insn.opcode <= SETGE) || (insn.opcode >= JE && insn.opcode <= JGE))
+	    return true;
+
+	switch (insn.opcode) {
+	case ADDL: case SUBL: case IMULL: case NEGL: case IDIVL:
+	case SHLL: case SARL: case SHRL:
+	case CMPL: case TESTL: case TESTB: case CALL: case RET:
+	    return false;
+
+	default:
+	    break;
+	}
+    }
+
+    return true;
+}
+
+
+/*
+ * Function:	isMove (private)
+ *
+ * Description:	Return whether an instruction is a plain move.
+ */
+
+static bool isMove(const Instruction &insn)
+{
+    return insn.opcode == MOVL || insn.opcode == MOVB;
+}
+
+
+/*
+ * Function:	selfMove (private)
+ *
+ * Description:	Remove a move of a register to itself, which is what is
+ *		left of a copy once the register allocator has given both
+ *		sides the same register:
+ *
+ *		movl	%eax, %eax	=>
+ */
+
+static int selfMove(Instruction *window, const Context &context)
+{
+    const Instruction &move = window[0];
+
+
+    if (!isMove(move) || move.src.kind != Operand::REGISTER || move.src != move.dst)
+	return FAIL;
+
+    return 0;
+}
+
+
+/*
+ * Function:	storeReload (private)
+ *
+ * Description:	Remove the reload of a value that was just stored:
+ *
+ *		movl	%r, m		=>	movl	%r, m
+ *		movl	m, %r
+ */
+
+static int storeReload(Instruction *window, const Context &context)
+{
+    const Instruction &store = window[0], &load = window[1];
+
+
+    if (!isMove(store) || load.opcode != store.opcode)
+	return FAIL;
+
+    if (store.src.kind != Operand::REGISTER || store.dst.kind != Operand::MEMORY)
+	return FAIL;
+
+    if (load.src != store.dst || load.dst != store.src)
+	return FAIL;
+
+    return 1;
+}
+
+
+/*
+ * Function:	reloadStore (private)
+ *
+ * Description:	Remove the store of a value that was just loaded, as long
+ *		as the address does not depend upon the register loaded:
+ *
+ *		movl	m, %r		=>	movl	m, %r
+ *		movl	%r, m
+ */
+
+static int reloadStore(Instruction *window, const Context &context)
+{
+    const Instruction &load = window[0], &store = window[1];
+
+
+    if (!isMove(load) || store.opcode != load.opcode)
+	return FAIL;
+
+    if (load.src.kind != Operand::MEMORY || load.dst.kind != Operand::REGISTER)
+	return FAIL;
+
+    if (store.src != load.dst || store.dst != load.src)
+	return FAIL;
+
+    if (load.src.base == load.dst.base || load.src.index == load.dst.base)
+	return FAIL;
+
+    return 1;
+}
+
+
+/*
+ * Function:	setBranch (private)
+ *
+ * Description:	Branch directly on the condition codes rather than first
+ *		materializing a boolean and comparing it against zero:
+ *
+ *		setl	%al		=>	jl	L
+ *		movzbl	%al, %eax
+ *		cmpl	$0, %eax
+ *		jne	L
+ *
+ *		The comparison that set the condition codes in the first
+ *		place is left alone, and the boolean is dead after the
+ *		branch.  The condition codes are now those of the first
+ *		comparison rather than of the boolean, so neither the
+ *		target nor the next block may read them.
+ */
+
+static int setBranch(Instruction *window, const Context &context)
+{
+    const Instruction &set = window[0], &zext = window[1];
+    const Instruction &cmp = window[2], &jump = window[3];
+    int cc = set.opcode - SETE;
+
+
+    if (set.opcode < SETE || set.opcode > SETGE)
+	return FAIL;
+
+    if (zext.opcode != MOVZBL || zext.src != set.dst)
+	return FAIL;
+
+    if (zext.dst.kind != Operand::REGISTER || zext.dst.base != set.dst.base)
+	return FAIL;
+
+    if (cmp.opcode == CMPL) {
+	if (cmp.src != Immediate(0) || cmp.dst != zext.dst)
+	    return FAIL;
+
+    } else if (cmp.opcode == TESTL) {
+	if (cmp.src != zext.dst || cmp.dst != zext.dst)
+	    return FAIL;
+
+    } else
+	return FAIL;
+
+    if (context.reads || context.flags.count(jump.src.label) > 0)
+	return FAIL;
+
+    if (jump.opcode == JNE)
+	window[0] = {Opcode(JE + cc), jump.src, Operand()};
+    else if (jump.opcode == JE)
+	window[0] = {negated[cc], jump.src, Operand()};
+    else
+	return FAIL;
+
+    return 1;
+}
+
+
+/*
+ * Function:	compareZero (private)
+ *
+ * Description:	Test a register against itself rather than comparing it
+ *		against zero, which is shorter and also works for bytes:
+ *
+ *		cmpl	$0, %eax	=>	testl	%eax, %eax
+ */
+
+static int compareZero(Instruction *window, const Context &context)
+{
+    Instruction &cmp = window[0];
+
+
+    if (cmp.opcode != CMPL || cmp.src != Immediate(0))
+	return FAIL;
+
+    if (cmp.dst.kind != Operand::REGISTER)
+	return FAIL;
+
+    cmp.opcode = cmp.dst.size == 1 ? TESTB : TESTL;
+    cmp.src = cmp.dst;
+    return 1;
+}
+
+
+/*
+ * Function:	branchNext (private)
+ *
+ * Description:	Remove a branch at the end of a block to the label of the
+ *		block that immediately follows it:
+ *
+ *		jmp	L		=>
+ *	    L:				    L:
+ */
+
+static int branchNext(Instruction *window, const Context &context)
+{
+    const Instruction &jump = window[0];
+
+
+    if (!context.last || jump.opcode < JMP || jump.opcode > JGE)
+	return FAIL;
+
+    if (jump.src != *context.next)
+	return FAIL;
+
+    return 0;
+}
+
+
+static Rule rules[] = {
+    {"self-move", 1, selfMove, 0},
+    {"store-reload", 2, storeReload, 0},
+    {"reload-store", 2, reloadStore, 0},
+    {"set-branch", 4, setBranch, 0},
+    {"compare-zero", 1, compareZero, 0},
+    {"branch-next", 1, branchNext, 0},
+};
+
+static const unsigned NUM_RULES = sizeof(rules) / sizeof(rules[0]);
+static const unsigned MAX_WIDTH = 4;
+
+
+/*
+ * Function:	peephole
+ *
+ * Description:	Apply the rules to the code of a function until none of
+ *		them match anywhere.
+ */
+
+void peephole(Assembly &code)
+{
+    BasicBlocks &blocks = code.blocks();
+    static thread_local Context context;
+    unsigned b, i, j, size;
+    Instruction *window;
+    Operand none;
+    int n;
+
+
+    context.flags.clear();
+
+    for (b = 0; b < blocks.size(); b ++)
+	if (blocks[b].label.label >= 0 && readsFlags(blocks[b]))
+	    context.flags.insert(blocks[b].label.label);
+
+    for (b = 0; b < blocks.size(); b ++) {
+	Instructions &insns = blocks[b].instructions;
+
+	if (b + 1 < blocks.size()) {
+	    context.next = &blocks[b + 1].label;
+	    context.reads = readsFlags(blocks[b + 1]);
+	} else {
+	    context.next = &none;
+	    context.reads = false;
+	}
+
+	size = insns.size();
+	i = 0;
+
+	while (i < size) {
+	    window = insns.data() + i;
+	    n = FAIL;
+
+	    for (j = 0; j < NUM_RULES; j ++)
+		if (i + rules[j].width <= size) {
+		    context.last = i + rules[j].width == size;
+		    n = rules[j].apply(window, context);
+
+		    if (n != FAIL)
+			break;
+		}
+
+	    if (n != FAIL) {
+		rules[j].hits ++;
+
+		if ((unsigned) n < rules[j].width) {
+		    insns.erase(insns.begin() + i + n, insns.begin() + i + rules[j].width);
+		    size = insns.size();
+		}
+
+		i = i >= MAX_WIDTH - 1 ? i - (MAX_WIDTH - 1) : 0;
+	    } else
+		i ++;
+	}
+    }
+}
+
+
+/*
+ * Function:	peepholeStatistics
+ *
+ * Description:	Write the number of times each rule fired to the given
+ *		stream.
+ */
+
+void peepholeStatistics(ostream &ostr)
+{
+    ostr << "peephole:";
+
+    for (unsigned j = 0; j < NUM_RULES; j ++)
+	ostr << (j > 0 ? ", " : " ") << rules[j].hits << " " << rules[j].name;
+
+    ostr << endl;
+}
@@ -0,0 +1,17 @@
+/*
+ * File:	peephole.h
+ *
+ * Description:	This file contains the function declarations for the
+ *		peephole optimizer for Simple C, which rewrites the code of
+ *		each function before it is written out.
+ */
+
+# ifndef PEEPHOLE_H
+# define PEEPHOLE_H
+# include <ostream>
+# include "assembly.h"
+
+void peephole(Assembly &code);
+void peepholeStatistics(std::ostream &ostr);
+
+# endif /* PEEPHOLE_H */
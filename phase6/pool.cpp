@@ -0,0 +1,132 @@
+/*
+ * File:	pool.cpp
+ *
+ * Description:	This file contains the member function definitions for
+ *		the pool of worker threads for Simple C.
+ *
+ *		Each worker waits for a task, runs it outside of the lock,
+ *		and waits again.  A task that throws leaves its exception
+ *		in its future rather than ending the worker.  The workers
+ *		are stopped and joined when the pool is destroyed, once the
+ *		tasks still queued have run.
+ */
+
+# include "pool.h"
+
+using namespace std;
+
+
+/*
+ * Function:	Pool::Pool (constructor)
+ *
+ * Description:	Initialize a pool without any workers.
+ */
+
+Pool::Pool()
+    : _stopping(false)
+{
+}
+
+
+/*
+ * Function:	Pool::~Pool (destructor)
+ *
+ * Description:	Stop the workers once the queue is empty and wait for them
+ *		to finish.
+ */
+
+Pool::~Pool()
+{
+    {
+	lock_guard<mutex> guard(_mutex);
+	_stopping = true;
+    }
+
+    _ready.notify_all();
+
+    for (auto &worker : _workers)
+	worker.join();
+}
+
+
+/*
+ * Function:	Pool::work (private)
+ *
+ * Description:	Run tasks from the queue until the pool is stopped.
+ */
+
+void Pool::work()
+{
+    packaged_task<void()> task;
+
+
+    while (true) {
+	{
+	    unique_lock<mutex> guard(_mutex);
+
+	    _ready.wait(guard, [this] { return _stopping || !_tasks.empty(); });
+
+	    if (_tasks.empty())
+		return;
+
+	    task = move(_tasks.front());
+	    _tasks.pop_front();
+	}
+
+	task();
+    }
+}
+
+
+/*
+ * Function:	Pool::start
+ *
+ * Description:	Start the given number of workers in addition to any that
+ *		are already running.
+ */
+
+void Pool::start(unsigned numWorkers)
+{
+    for (unsigned i = 0; i < numWorkers; i ++)
+	_workers.emplace_back(&Pool::work, this);
+}
+
+
+/*
+ * Function:	Pool::size
+ *
+ * Description:	Return the number of workers.
+ */
+
+unsigned Pool::size() const
+{
+    return _workers.size();
+}
+
+
+/*
+ * Function:	Pool::submit
+ *
+ * Description:	Queue a task to be run by the next idle worker, or run it
+ *		now if there are none, and return its future.
+ */
+
+future<void> Pool::submit(const function<void()> &task)
+{
+    packaged_task<void()> packaged(task);
+    future<void> result = packaged.get_future();
+
+
+    if (_workers.empty()) {
+	packaged();
+	return result;
+    }
+
+    {
+	lock_guard<mutex> guard(_mutex);
+	_tasks.push_back(move(packaged));
+    }
+
+    _ready.notify_one();
+    return result;
+}
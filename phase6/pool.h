@@ -0,0 +1,42 @@
+/*
+ * File:	pool.h
+ *
+ * Description:	This file contains the class definition for a pool of
+ *		worker threads for Simple C.  Tasks are taken in the order
+ *		they are submitted from a single queue by whichever worker
+ *		is idle, and each one has a future that is ready once the
+ *		task has run.  A pool without workers runs each task at
+ *		once as it is submitted.
+ */
+
+# ifndef POOL_H
+# define POOL_H
+# include <deque>
+# include <mutex>
+# include <future>
+# include <thread>
+# include <vector>
+# include <functional>
+# include <condition_variable>
+
+class Pool {
+    std::vector<std::thread> _workers;
+    std::deque<std::packaged_task<void()>> _tasks;
+    std::mutex _mutex;
+    std::condition_variable _ready;
+    bool _stopping;
+
+    Pool(const Pool &);
+    Pool &operator =(const Pool &);
+    void work();
+
+public:
+    Pool();
+    ~Pool();
+
+    void start(unsigned numWorkers);
+    unsigned size() const;
+    std::future<void> submit(const std::function<void()> &task);
+};
+
+# endif /* POOL_H */
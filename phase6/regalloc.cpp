@@ -0,0 +1,636 @@
+/*
+ * File:	regalloc.cpp
+ *
+ * Description:	This file contains the register allocator for Simple C.
+ *		The code generator hands out a fresh virtual register for
+ *		every value it computes, and only uses real registers where
+ *		the instruction set demands them, as for division, calls,
+ *		and return values.  Once a function has been generated, we
+ *		take the registers live at the boundaries of each block from
+ *		the dataflow framework, work out which are live at every
+ *		point in between, reduce the lifetime of each virtual
+ *		register to a single interval, and assign real registers to
+ *		the intervals in order of their start by linear scan.
+ *
+ *		All six general-purpose registers are used.  A call
+ *		clobbers %eax, %ecx, and %edx, so a value that lives across
+ *		a call ends up in %ebx, %esi, or %edi, which the function
+ *		saves in its own frame on entry and restores on exit.  Only
+ *		the first four registers have byte forms, which constrains
+ *		the values that are used as bytes.
+ *
+ *		When there are not enough registers, the interval with the
+ *		smallest weight, which is its number of uses with those in
+ *		loops counting for more, divided by its length, is spilled
+ *		to a slot in the frame.  Spilling a long interval that is
+ *		seldom used frees the most for the least.
+ *		Each use of a spilled register then gets a short-lived
+ *		register of its own that is loaded from or stored to the
+ *		slot, and the allocation is simply repeated.  Those short
+ *		intervals are never spilled themselves.
+ */
+
+# include <atomic>
+# include <cassert>
+# include <climits>
+# include <cstdint>
+# include <algorithm>
+# include "regalloc.h"
+# include "dataflow.h"
+# include "machine.h"
+
+using namespace std;
+
+static const int allocatable[] = {EAX, ECX, EDX, EBX, ESI, EDI};
+static const int preserved[] = {EBX, ESI, EDI};
+
+static const unsigned NUM_ALLOCATABLE = sizeof(allocatable) / sizeof(allocatable[0]);
+static const unsigned NUM_PRESERVED = sizeof(preserved) / sizeof(preserved[0]);
+
+/* The state of the allocation for the current function.  Each thread
+   has its own, which it keeps between functions so that the vectors
+   need not grow from nothing. */
+
+struct Allocator {
+    FlowGraph graph;
+    Dataflow live;
+    unsigned numPoints;
+    int numRegs;
+    vector<int> depth;
+    vector<unsigned char> busy;
+    vector<int> counts;
+
+    vector<int> start, finish, hint, assigned, order, active;
+    vector<float> weight;
+    vector<char> bytes, temporary, spilled;
+
+    void nesting();
+    void extend(int reg, int point);
+    void intervals(Assembly &code);
+    bool available(unsigned k, int reg);
+    bool scan();
+    void fold(Instruction &insn, const vector<int> &slots);
+    void spill(Assembly &code);
+    void replace(Assembly &code);
+    void preserve(Assembly &code);
+    void allocate(Assembly &code);
+};
+
+static atomic<unsigned long> numIntervals, numSpilled, numSaved;
+
+
+/*
+ * Function:	registerOf (private)
+ *
+ * Description:	Return an operand for a register with the given number.
+ */
+
+static Operand registerOf(int reg, unsigned size = SIZEOF_REG)
+{
+    Operand op;
+
+    op.kind = Operand::REGISTER;
+    op.base = reg;
+    op.size = size;
+    return op;
+}
+
+
+/*
+ * Function:	slotOf (private)
+ *
+ * Description:	Return an operand for a slot in the stack frame.
+ */
+
+static Operand slotOf(int offset)
+{
+    Operand op;
+
+    op.kind = Operand::MEMORY;
+    op.base = EBP;
+    op.value = offset;
+    return op;
+}
+
+
+/*
+ * Function:	Allocator::nesting (private)
+ *
+ * Description:	Approximate the loop nesting depth of every block by the
+ *		number of backward branches around it.
+ */
+
+void Allocator::nesting()
+{
+    unsigned b, i;
+
+
+    depth.assign(graph.numBlocks, 0);
+
+    for (b = 0; b < graph.numBlocks; b ++) {
+	int target = graph.succs[2 * b];
+
+	if (target >= 0 && (unsigned) target <= b)
+	    for (i = target; i <= b; i ++)
+		depth[i] ++;
+    }
+}
+
+
+/*
+ * Function:	Allocator::extend (private)
+ *
+ * Description:	Extend the interval of a register to include a point.
+ */
+
+inline void Allocator::extend(int reg, int point)
+{
+    if (point < start[reg])
+	start[reg] = point;
+
+    if (point > finish[reg])
+	finish[reg] = point;
+}
+
+
+/*
+ * Function:	Allocator::intervals (private)
+ *
+ * Description:	Compute the interval, weight, and constraints of every
+ *		virtual register, and the points at which every real
+ *		register is busy.  Instruction p reads its operands at
+ *		point 2p and writes its results at point 2p + 1.  A copy
+ *		into a virtual register hints that it should get the same
+ *		register as its source, so that the copy disappears.
+ */
+
+void Allocator::intervals(Assembly &code)
+{
+    BasicBlocks &blocks = code.blocks();
+    unsigned b, i, k, p, w;
+    unsigned char mask, d, u;
+    Effects fx;
+    float scale;
+
+
+    start.assign(numRegs, INT_MAX);
+    finish.assign(numRegs, -1);
+    hint.assign(numRegs, NOREG);
+    weight.assign(numRegs, 0);
+    bytes.assign(numRegs, 0);
+    temporary.resize(numRegs, 0);
+    busy.assign(numPoints, 0);
+
+    for (b = 0; b < graph.numBlocks; b ++) {
+	const Instructions &insns = blocks[b].instructions;
+	const Word *n = &live.in[b * live.numWords], *o = &live.out[b * live.numWords];
+
+	if (insns.empty())
+	    continue;
+
+	for (w = 0; w < live.numWords; w ++)
+	    for (Word x = n[w] | o[w]; x != 0; x &= x - 1) {
+		int reg = w * BITS + __builtin_ctzll(x);
+
+		if (reg >= NUM_REGS) {
+		    if (has(n, reg))
+			extend(reg, 2 * graph.first[b]);
+
+		    if (has(o, reg))
+			extend(reg, 2 * graph.last[b] - 1);
+		}
+	    }
+
+	scale = depth[b] == 0 ? 1 : depth[b] == 1 ? 10 : depth[b] == 2 ? 100 : 1000;
+	mask = o[0] & 0xff;
+
+	for (p = graph.last[b]; p -- > graph.first[b]; ) {
+	    const Instruction &insn = insns[p - graph.first[b]];
+
+	    effects(insn, fx);
+	    d = u = 0;
+
+	    for (i = 0; i < fx.ndefs; i ++)
+		if (fx.defs[i] < NUM_REGS)
+		    d |= 1 << fx.defs[i];
+		else {
+		    extend(fx.defs[i], 2 * p + 1);
+		    weight[fx.defs[i]] += scale;
+		}
+
+	    for (i = 0; i < fx.nuses; i ++)
+		if (fx.uses[i] < NUM_REGS)
+		    u |= 1 << fx.uses[i];
+		else {
+		    extend(fx.uses[i], 2 * p);
+		    weight[fx.uses[i]] += scale;
+		}
+
+	    busy[2 * p + 1] = mask | d;
+	    mask = (mask & ~d) | u;
+	    busy[2 * p] = mask;
+
+	    if (insn.src.kind == Operand::REGISTER && insn.src.size == 1)
+		bytes[insn.src.base] = true;
+
+	    if (insn.dst.kind == Operand::REGISTER && insn.dst.size == 1)
+		bytes[insn.dst.base] = true;
+
+	    if (insn.opcode == MOVL && insn.src.kind == Operand::REGISTER)
+		if (insn.dst.kind == Operand::REGISTER) {
+		    if (insn.dst.base >= NUM_REGS)
+			hint[insn.dst.base] = insn.src.base;
+		    else if (insn.src.base >= NUM_REGS)
+			hint[insn.src.base] = insn.dst.base;
+		}
+	}
+    }
+
+    for (int reg = NUM_REGS; reg < numRegs; reg ++)
+	if (finish[reg] >= 0)
+	    weight[reg] /= finish[reg] - start[reg] + 1;
+
+    counts.assign(NUM_ALLOCATABLE * (numPoints + 1), 0);
+
+    for (k = 0; k < NUM_ALLOCATABLE; k ++) {
+	int *count = &counts[k * (numPoints + 1)];
+
+	for (p = 0; p < numPoints; p ++)
+	    count[p + 1] = count[p] + ((busy[p] >> allocatable[k]) & 1);
+    }
+}
+
+
+/*
+ * Function:	Allocator::available (private)
+ *
+ * Description:	Return whether the real register with the given index in
+ *		the table of allocatable registers is free of fixed uses
+ *		over the interval of a virtual register and suits it.
+ */
+
+bool Allocator::available(unsigned k, int reg)
+{
+    const int *count = &counts[k * (numPoints + 1)];
+
+    if (bytes[reg] && allocatable[k] > EBX)
+	return false;
+
+    return count[finish[reg] + 1] == count[start[reg]];
+}
+
+
+/*
+ * Function:	Allocator::scan (private)
+ *
+ * Description:	Assign real registers to the intervals in order of their
+ *		start.  Return whether every interval received one.
+ */
+
+bool Allocator::scan()
+{
+    int holder[NUM_REGS], reg, victim, want;
+    unsigned i, k, chosen;
+    bool done = true;
+
+
+    order.clear();
+    active.clear();
+    assigned.assign(numRegs, NOREG);
+    spilled.assign(numRegs, 0);
+
+    for (k = 0; k < NUM_REGS; k ++)
+	holder[k] = NOREG;
+
+    for (reg = NUM_REGS; reg < numRegs; reg ++)
+	if (finish[reg] >= 0)
+	    order.push_back(reg);
+
+    sort(order.begin(), order.end(), [this](int a, int b) {
+	return start[a] < start[b] || (start[a] == start[b] && a < b);
+    });
+
+    for (auto reg : order) {
+	for (i = 0; i < active.size(); )
+	    if (finish[active[i]] < start[reg]) {
+		holder[assigned[active[i]]] = NOREG;
+		active[i] = active.back();
+		active.pop_back();
+	    } else
+		i ++;
+
+	chosen = NUM_ALLOCATABLE;
+	want = hint[reg] >= NUM_REGS ? assigned[hint[reg]] : hint[reg];
+
+	for (k = 0; k < NUM_ALLOCATABLE; k ++)
+	    if (holder[allocatable[k]] == NOREG && available(k, reg)) {
+		if (chosen == NUM_ALLOCATABLE || allocatable[k] == want)
+		    chosen = k;
+
+		if (allocatable[k] == want)
+		    break;
+	    }
+
+	if (chosen == NUM_ALLOCATABLE) {
+	    victim = NOREG;
+
+	    for (i = 0; i < active.size(); i ++) {
+		int other = active[i];
+
+		if (temporary[other])
+		    continue;
+
+		for (k = 0; allocatable[k] != assigned[other]; k ++)
+		    continue;
+
+		if (available(k, reg))
+		    if (victim == NOREG || weight[other] < weight[victim]) {
+			victim = other;
+			chosen = k;
+		    }
+	    }
+
+	    if (victim != NOREG && (temporary[reg] || weight[victim] < weight[reg])) {
+		spilled[victim] = true;
+		assigned[victim] = NOREG;
+		*find(active.begin(), active.end(), victim) = active.back();
+		active.pop_back();
+	    } else {
+		assert(!temporary[reg]);
+		spilled[reg] = true;
+		done = false;
+		continue;
+	    }
+
+	    done = false;
+	}
+
+	assigned[reg] = allocatable[chosen];
+	holder[assigned[reg]] = reg;
+	active.push_back(reg);
+    }
+
+    return done;
+}
+
+
+/*
+ * Function:	Allocator::fold (private)
+ *
+ * Description:	Replace a spilled register that is an operand of an
+ *		instruction by its slot, if the instruction allows memory
+ *		in that position and has no other memory operand.
+ */
+
+void Allocator::fold(Instruction &insn, const vector<int> &slots)
+{
+    bool src = false, dst = false;
+    Operand *op, *other;
+
+
+    switch (insn.opcode) {
+    case MOVL: case MOVB: case ADDL: case SUBL: case CMPL:
+	src = dst = true;
+	break;
+
+    case MOVSBL: case MOVZBL: case IMULL: case IDIVL: case PUSHL:
+	src = true;
+	break;
+
+    case NEGL: case POPL: case SHLL: case SARL: case SHRL:
+    case SETE: case SETNE: case SETL: case SETG: case SETLE: case SETGE:
+	dst = true;
+	break;
+
+    default:
+	return;
+    }
+
+    if (src && insn.src.kind == Operand::REGISTER && spilled[insn.src.base])
+	op = &insn.src, other = &insn.dst;
+    else if (dst && insn.dst.kind == Operand::REGISTER && spilled[insn.dst.base])
+	op = &insn.dst, other = &insn.src;
+    else
+	return;
+
+    if (other->kind == Operand::MEMORY || other->base == op->base)
+	return;
+
+    unsigned size = op->size;
+    *op = slotOf(slots[op->base]);
+    op->size = size;
+}
+
+
+/*
+ * Function:	Allocator::spill (private)
+ *
+ * Description:	Give every spilled register a slot in the frame, and
+ *		replace each of its uses by a new temporary register that
+ *		is loaded from the slot before the instruction and stored
+ *		to it afterward as necessary.  Where the instruction can
+ *		use the slot directly, no temporary is needed.
+ */
+
+void Allocator::spill(Assembly &code)
+{
+    BasicBlocks &blocks = code.blocks();
+    int frame = code.frame(), reg, temp[8], from[8];
+    vector<int> slots(numRegs, 0);
+    unsigned i, n;
+    Instructions insns;
+    Effects fx;
+
+
+    for (reg = NUM_REGS; reg < numRegs; reg ++)
+	if (spilled[reg]) {
+	    frame += SIZEOF_REG;
+	    slots[reg] = -frame;
+	    numSpilled ++;
+	}
+
+    code.frame(frame);
+
+    for (auto &block : blocks) {
+	insns.clear();
+
+	for (auto insn : block.instructions) {
+	    fold(insn, slots);
+	    effects(insn, fx);
+	    n = 0;
+
+	    for (i = 0; i < fx.nuses + fx.ndefs; i ++) {
+		reg = i < fx.nuses ? fx.uses[i] : fx.defs[i - fx.nuses];
+
+		if (reg >= NUM_REGS && spilled[reg] && find(from, from + n, reg) == from + n) {
+		    from[n] = reg;
+		    temp[n] = numRegs ++;
+		    temporary.push_back(true);
+
+		    if (i < fx.nuses)
+			insns.push_back({MOVL, slotOf(slots[reg]), registerOf(temp[n])});
+
+		    n ++;
+		}
+	    }
+
+	    for (i = 0; i < n; i ++) {
+		Operand *ops[] = {&insn.src, &insn.dst};
+
+		for (auto op : ops) {
+		    if (op->base == from[i])
+			op->base = temp[i];
+
+		    if (op->index == from[i])
+			op->index = temp[i];
+		}
+	    }
+
+	    insns.push_back(insn);
+
+	    for (i = 0; i < fx.ndefs; i ++) {
+		reg = fx.defs[i];
+
+		if (reg >= NUM_REGS && spilled[reg]) {
+		    int t = temp[find(from, from + n, reg) - from];
+		    insns.push_back({MOVL, registerOf(t), slotOf(slots[reg])});
+		}
+	    }
+	}
+
+	block.instructions.swap(insns);
+    }
+}
+
+
+/*
+ * Function:	Allocator::replace (private)
+ *
+ * Description:	Replace every virtual register by its real register.
+ */
+
+void Allocator::replace(Assembly &code)
+{
+    for (auto &block : code.blocks())
+	for (auto &insn : block.instructions) {
+	    Operand *ops[] = {&insn.src, &insn.dst};
+
+	    for (auto op : ops)
+		if (op->kind == Operand::REGISTER || op->kind == Operand::MEMORY) {
+		    if (op->base >= NUM_REGS)
+			op->base = assigned[op->base];
+
+		    if (op->index >= NUM_REGS)
+			op->index = assigned[op->index];
+		}
+	}
+}
+
+
+/*
+ * Function:	Allocator::preserve (private)
+ *
+ * Description:	Save the callee-saved registers that were assigned in the
+ *		frame after the prologue, and restore them at the start of
+ *		the epilogue.
+ */
+
+void Allocator::preserve(Assembly &code)
+{
+    BasicBlocks &blocks = code.blocks();
+    bool used[NUM_REGS] = {false};
+    int frame = code.frame();
+    unsigned i, n = 0;
+
+
+    for (int reg = NUM_REGS; reg < numRegs; reg ++)
+	if (assigned[reg] != NOREG)
+	    used[assigned[reg]] = true;
+
+    for (i = 0; i < NUM_PRESERVED; i ++)
+	if (used[preserved[i]]) {
+	    Operand reg = registerOf(preserved[i]);
+
+	    frame += SIZEOF_REG;
+	    blocks[0].instructions.insert(blocks[0].instructions.begin() + 3 + n, {MOVL, reg, slotOf(-frame)});
+
+	    if (graph.exitBlock >= 0)
+		blocks[graph.exitBlock].instructions.insert(blocks[graph.exitBlock].instructions.begin() + n, {MOVL, slotOf(-frame), reg});
+
+	    numSaved ++;
+	    n ++;
+	}
+
+    code.frame(frame);
+}
+
+
+/*
+ * Function:	Allocator::allocate (private)
+ *
+ * Description:	Replace the virtual registers in the code of a function
+ *		with real ones, spilling as necessary, and adjust the frame
+ *		to hold the spilled and saved registers.
+ */
+
+void Allocator::allocate(Assembly &code)
+{
+    int frame = code.frame(), extra;
+
+
+    temporary.clear();
+
+    while (true) {
+	buildGraph(graph, code);
+	liveness(live, graph, code);
+	numRegs = graph.numRegs;
+	numPoints = 2 * graph.numInsns;
+	nesting();
+	intervals(code);
+
+	if (scan())
+	    break;
+
+	spill(code);
+    }
+
+    for (int reg = NUM_REGS; reg < numRegs; reg ++)
+	if (assigned[reg] != NOREG && !temporary[reg])
+	    numIntervals ++;
+
+    replace(code);
+    preserve(code);
+
+    extra = code.frame() - frame;
+    extra += (STACK_ALIGNMENT - extra % STACK_ALIGNMENT) % STACK_ALIGNMENT;
+    code.frame(frame + extra);
+}
+
+
+/*
+ * Function:	allocateRegisters
+ *
+ * Description:	Allocate registers for the code of a function using the
+ *		allocator for this thread.
+ */
+
+void allocateRegisters(Assembly &code)
+{
+    static thread_local Allocator allocator;
+
+    allocator.allocate(code);
+}
+
+
+/*
+ * Function:	allocatorStatistics
+ *
+ * Description:	Write the number of registers allocated, spilled, and
+ *		saved to the given stream.
+ */
+
+void allocatorStatistics(ostream &ostr)
+{
+    ostr << "registers: " << numIntervals << " allocated, " << numSpilled;
+    ostr << " spilled, " << numSaved << " saved" << endl;
+}
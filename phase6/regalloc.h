@@ -0,0 +1,17 @@
+/*
+ * File:	regalloc.h
+ *
+ * Description:	This file contains the function declarations for the
+ *		register allocator for Simple C, which replaces the virtual
+ *		registers in the code of each function with real ones.
+ */
+
+# ifndef REGALLOC_H
+# define REGALLOC_H
+# include <ostream>
+# include "assembly.h"
+
+void allocateRegisters(Assembly &code);
+void allocatorStatistics(std::ostream &ostr);
+
+# endif /* REGALLOC_H */
@@ -0,0 +1,303 @@
+/*
+ * File:	scan.cpp
+ *
+ * Description:	This file contains the function definitions for the
+ *		scanning kernels used by the lexer.
+ *
+ *		All four kernels are really the same loop: classify a block
+ *		of characters, and stop at the first one we are looking
+ *		for.  So each instruction set gets just one function that
+ *		takes the kind of search as a parameter.  The switch is
+ *		perfectly predictable, so it costs next to nothing.
+ *
+ *		The vector functions only ever load whole blocks that lie
+ *		within the buffer, and leave any short tail to the scalar
+ *		function.
+ */
+
+# include <cstdlib>
+# include <cstring>
+# include "scan.h"
+
+# if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+# define VECTOR_KERNELS
+# endif
+
+enum { SPACE, STAR, QUOTE, BACKSLASH };
+
+typedef const char *(*Kernel)(const char *, const char *, int, char, int &);
+
+
+/*
+ * Function:	scalar (private)
+ *
+ * Description:	Search one character at a time.  This is the fallback, and
+ *		also handles the tail end of the buffer for the others.
+ */
+
+static const char *scalar(const char *p, const char *end, int kind, char quote, int &lines)
+{
+    for (; p < end; p ++) {
+	switch (kind) {
+	case SPACE:
+	    if (*p != ' ' && (*p < '\t' || *p > '\r'))
+		return p;
+
+	    break;
+
+	case STAR:
+	    if (*p == '*')
+		return p;
+
+	    break;
+
+	case QUOTE:
+	    if (*p == quote || *p == '\\' || *p == '\n')
+		return p;
+
+	    break;
+
+	case BACKSLASH:
+	    if (*p == '\\')
+		return p;
+
+	    break;
+	}
+
+	if (*p == '\n')
+	    lines ++;
+    }
+
+    return p;
+}
+
+
+# ifdef VECTOR_KERNELS
+
+/*
+ * Function:	sse2 (private)
+ *
+ * Description:	Search sixteen characters at a time.  A character is white
+ *		space if it is a blank or lies in the range '\t' to '\r',
+ *		which we test with an unsigned saturating subtraction.
+ */
+
+__attribute__((target("sse2")))
+static const char *sse2(const char *p, const char *end, int kind, char quote, int &lines)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i blank = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i range = _mm_set1_epi8('\r' - '\t');
+    const __m128i star = _mm_set1_epi8('*');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i delimiter = _mm_set1_epi8(quote);
+    const __m128i zero = _mm_setzero_si128();
+    unsigned stop, newlines;
+    __m128i v, x;
+
+
+    while (end - p >= 16) {
+	v = _mm_loadu_si128((const __m128i *) p);
+	newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(v, newline));
+
+	switch (kind) {
+	case SPACE:
+	    x = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8(v, tab), range), zero);
+	    x = _mm_or_si128(x, _mm_cmpeq_epi8(v, blank));
+	    stop = ~_mm_movemask_epi8(x) & 0xffff;
+	    break;
+
+	case STAR:
+	    stop = _mm_movemask_epi8(_mm_cmpeq_epi8(v, star));
+	    break;
+
+	case QUOTE:
+	    x = _mm_or_si128(_mm_cmpeq_epi8(v, delimiter), _mm_cmpeq_epi8(v, backslash));
+	    stop = _mm_movemask_epi8(x) | newlines;
+	    break;
+
+	default:
+	    stop = _mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash));
+	    break;
+	}
+
+	if (stop != 0) {
+	    stop = __builtin_ctz(stop);
+	    lines += __builtin_popcount(newlines & ((1u << stop) - 1));
+	    return p + stop;
+	}
+
+	lines += __builtin_popcount(newlines);
+	p += 16;
+    }
+
+    return scalar(p, end, kind, quote, lines);
+}
+
+
+/*
+ * Function:	avx2 (private)
+ *
+ * Description:	Search thirty-two characters at a time, exactly as above.
+ */
+
+__attribute__((target("avx2")))
+static const char *avx2(const char *p, const char *end, int kind, char quote, int &lines)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i blank = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i range = _mm256_set1_epi8('\r' - '\t');
+    const __m256i star = _mm256_set1_epi8('*');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i delimiter = _mm256_set1_epi8(quote);
+    const __m256i zero = _mm256_setzero_si256();
+    unsigned stop, newlines;
+    __m256i v, x;
+
+
+    while (end - p >= 32) {
+	v = _mm256_loadu_si256((const __m256i *) p);
+	newlines = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline));
+
+	switch (kind) {
+	case SPACE:
+	    x = _mm256_subs_epu8(_mm256_sub_epi8(v, tab), range);
+	    x = _mm256_cmpeq_epi8(x, zero);
+	    x = _mm256_or_si256(x, _mm256_cmpeq_epi8(v, blank));
+	    stop = ~_mm256_movemask_epi8(x);
+	    break;
+
+	case STAR:
+	    stop = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, star));
+	    break;
+
+	case QUOTE:
+	    x = _mm256_cmpeq_epi8(v, delimiter);
+	    x = _mm256_or_si256(x, _mm256_cmpeq_epi8(v, backslash));
+	    stop = _mm256_movemask_epi8(x) | newlines;
+	    break;
+
+	default:
+	    stop = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, backslash));
+	    break;
+	}
+
+	if (stop != 0) {
+	    stop = __builtin_ctz(stop);
+	    lines += __builtin_popcount(newlines & ((1ull << stop) - 1));
+	    return p + stop;
+	}
+
+	lines += __builtin_popcount(newlines);
+	p += 32;
+    }
+
+    return sse2(p, end, kind, quote, lines);
+}
+
+# endif /* VECTOR_KERNELS */
+
+
+/*
+ * Function:	choose (private)
+ *
+ * Description:	Choose the best kernel for this processor, unless one has
+ *		been named in the environment.
+ */
+
+static const char *name;
+
+static Kernel choose()
+{
+    const char *forced = getenv("SCC_SCAN");
+
+# ifdef VECTOR_KERNELS
+    __builtin_cpu_init();
+
+    if (forced == nullptr || strcmp(forced, "avx2") == 0)
+	if (__builtin_cpu_supports("avx2")) {
+	    name = "avx2";
+	    return avx2;
+	}
+
+    if (forced == nullptr || strcmp(forced, "scalar") != 0)
+	if (__builtin_cpu_supports("sse2")) {
+	    name = "sse2";
+	    return sse2;
+	}
+# endif
+
+    name = "scalar";
+    return scalar;
+}
+
+static const Kernel kernel = choose();
+
+
+/*
+ * Function:	skipSpace
+ *
+ * Description:	Return the first character that is not white space.
+ */
+
+const char *skipSpace(const char *p, const char *end, int &lines)
+{
+    return kernel(p, end, SPACE, 0, lines);
+}
+
+
+/*
+ * Function:	findStar
+ *
+ * Description:	Return the first asterisk, for finding the end of a comment.
+ */
+
+const char *findStar(const char *p, const char *end, int &lines)
+{
+    return kernel(p, end, STAR, 0, lines);
+}
+
+
+/*
+ * Function:	findQuote
+ *
+ * Description:	Return the first closing quote, backslash, or newline, for
+ *		finding the end of a string or character literal.  Since we
+ *		stop at a newline, no lines are ever skipped.
+ */
+
+const char *findQuote(const char *p, const char *end, char quote)
+{
+    int lines = 0;
+
+    return kernel(p, end, QUOTE, quote, lines);
+}
+
+
+/*
+ * Function:	findBackslash
+ *
+ * Description:	Return the first backslash, for finding escape sequences.
+ */
+
+const char *findBackslash(const char *p, const char *end)
+{
+    int lines = 0;
+
+    return kernel(p, end, BACKSLASH, 0, lines);
+}
+
+
+/*
+ * Function:	scanKernels
+ *
+ * Description:	Return the name of the kernels in use.
+ */
+
+const char *scanKernels()
+{
+    return name;
+}
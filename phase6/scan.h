@@ -0,0 +1,27 @@
+/*
+ * File:	scan.h
+ *
+ * Description:	This file contains the function declarations for the
+ *		scanning kernels used by the lexer and by parseString().
+ *		Each kernel returns a pointer to the first interesting
+ *		character at or after P, or END if there is none.  The
+ *		kernels that can skip over newlines add the number they
+ *		skipped to LINES, so the caller's line count stays exact.
+ *
+ *		The kernels use AVX2 or SSE2 when the processor has them,
+ *		with a scalar fallback otherwise.  The choice is made once
+ *		at startup, but can be forced by setting SCC_SCAN to
+ *		"avx2", "sse2", or "scalar" in the environment.
+ */
+
+# ifndef SCAN_H
+# define SCAN_H
+
+const char *skipSpace(const char *p, const char *end, int &lines);
+const char *findStar(const char *p, const char *end, int &lines);
+const char *findQuote(const char *p, const char *end, char quote);
+const char *findBackslash(const char *p, const char *end);
+
+const char *scanKernels();
+
+# endif /* SCAN_H */
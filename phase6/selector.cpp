@@ -0,0 +1,1318 @@
+/*
+ * File:	selector.cpp
+ *
+ * Description:	This file contains the instruction selector for Simple C,
+ *		which translates the intermediate representation of a
+ *		function into assembly code in virtual registers, to be
+ *		finished by the same passes as code generated directly.
+ *
+ *		Each value that is kept gets a virtual register of its own.
+ *		Constants, undefined values, and the addresses of objects
+ *		are never kept, but are used as immediates or folded into
+ *		memory operands where they are used, and are computed into
+ *		a fresh register where they cannot be.  The same goes for a
+ *		sum or scaled index used only to address memory, and for a
+ *		comparison used only by branches.  A branch always compares
+ *		the operands of a comparison again rather than testing its
+ *		value, which keeps the peephole optimizer's assumption that
+ *		a boolean tested by a branch is dead after it.
+ *
+ *		A phi becomes copies at the ends of its predecessors into a
+ *		register that it shares with those of its operands, and
+ *		transitively their own phis and operands, that do not
+ *		interfere with it or each other, so that most copies are
+ *		never made.  Two values interfere if either is live
+ *		where the other is defined, which is found by solving for
+ *		the live values of the graph with the dataflow framework.
+ *		The copies are made in parallel before the branch that ends
+ *		a vertex, since moves leave the condition codes alone,
+ *		unless one of them would overwrite a value live along the
+ *		other edge, in which case that edge is split.
+ */
+
+# include <cassert>
+# include <climits>
+# include <algorithm>
+# include <unordered_map>
+# include "selector.h"
+# include "generator.h"
+# include "dataflow.h"
+# include "machine.h"
+
+using namespace std;
+
+struct Copy {
+    int dst;				/* register copied into */
+    int src;				/* value copied */
+};
+
+struct Split {
+    Label label;
+    vector<Copy> copies;
+    int target;
+};
+
+static const Opcode negated[] = {JNE, JE, JGE, JLE, JG, JL};
+static const Op mirrored[] = {OP_EQ, OP_NE, OP_GT, OP_LT, OP_GE, OP_LE};
+static const unsigned MAX_CHECKS = 256;
+
+/* The state of the selection for the current function. */
+
+static thread_local const Graph *graph;
+static thread_local Assembly *code;
+static thread_local vector<int> reg, position, bit;
+static thread_local vector<char> folded;
+static thread_local vector<vector<int>> users;
+static thread_local vector<Label> labels;
+static thread_local vector<Split> splits;
+static thread_local unordered_map<int, vector<int>> classes;
+
+static thread_local FlowGraph flow;
+static thread_local Dataflow live;
+
+static int materialize(int value);
+
+
+/*
+ * Function:	registerOf (private)
+ *
+ * Description:	Return an operand for a register with the given number.
+ */
+
+static Operand registerOf(int number, unsigned size = SIZEOF_REG)
+{
+    Operand op;
+
+    op.kind = Operand::REGISTER;
+    op.base = number;
+    op.size = size;
+    return op;
+}
+
+
+/*
+ * Function:	isImmediate (private)
+ *
+ * Description:	Return whether a value can be used as an immediate.
+ */
+
+static bool isImmediate(int value)
+{
+    return graph->values[value].op == OP_CONST || graph->values[value].op == OP_UNDEF;
+}
+
+
+/*
+ * Function:	constantOf (private)
+ *
+ * Description:	Return the value of an immediate, taking an undefined
+ *		value to be zero.
+ */
+
+static int constantOf(int value)
+{
+    const Value &v = graph->values[value];
+
+    return v.op == OP_CONST ? v.constant : 0;
+}
+
+
+/*
+ * Function:	source (private)
+ *
+ * Description:	Return an operand for a value used as a source, which is
+ *		either an immediate or a register.
+ */
+
+static Operand source(int value)
+{
+    if (isImmediate(value))
+	return Immediate(constantOf(value));
+
+    return registerOf(materialize(value));
+}
+
+
+/*
+ * Function:	fold (private)
+ *
+ * Description:	Add a value times a scale into a memory operand, folding
+ *		constants into the displacement, objects into the symbol
+ *		and base, and sums and scaled indices that are not kept
+ *		into their parts.  Anything else goes in a register as the
+ *		base or index.  If there is no room for it, the operand is
+ *		left as it was and false is returned.
+ */
+
+static bool fold(int value, Operand &op, unsigned scale)
+{
+    const Value &v = graph->values[value];
+    Operand saved = op;
+    int r, factor, other;
+    unsigned s;
+
+
+    if (isImmediate(value)) {
+	op.value += (unsigned) constantOf(value) * scale;
+	return true;
+    }
+
+    if (v.op == OP_ADDRESS && scale == 1) {
+	bool named = v.object.label >= 0 || v.object.symbol != Name();
+
+	if (v.object.base == NOREG || op.base == NOREG)
+	    if (!named || (op.label < 0 && op.symbol == Name())) {
+		if (v.object.base != NOREG)
+		    op.base = v.object.base;
+
+		op.label = max(op.label, v.object.label);
+
+		if (v.object.symbol != Name())
+		    op.symbol = v.object.symbol;
+
+		op.value += (unsigned) v.object.value + v.constant;
+		return true;
+	    }
+    }
+
+    if (reg[value] == NOREG && folded[value]) {
+	if (v.op == OP_ADD) {
+	    if (fold(v.args[0], op, scale) && fold(v.args[1], op, scale))
+		return true;
+
+	    op = saved;
+
+	} else if (v.op == OP_MUL) {
+	    factor = isImmediate(v.args[1]) ? v.args[1] : v.args[0];
+	    other = factor == v.args[1] ? v.args[0] : v.args[1];
+	    s = scale * constantOf(factor);
+
+	    if (s == 1 || s == 2 || s == 4 || s == 8) {
+		if (fold(other, op, s))
+		    return true;
+
+		op = saved;
+	    }
+	}
+    }
+
+    if (scale != 1 && scale != 2 && scale != 4 && scale != 8)
+	return false;
+
+    r = materialize(value);
+
+    if (scale == 1 && op.base == NOREG) {
+	op.base = r;
+	return true;
+    }
+
+    if (op.index == NOREG) {
+	op.index = r;
+	op.scale = scale;
+	return true;
+    }
+
+    op = saved;
+    return false;
+}
+
+
+/*
+ * Function:	memoryOf (private)
+ *
+ * Description:	Return a memory operand for an address.
+ */
+
+static Operand memoryOf(int address)
+{
+    Operand op;
+
+
+    op.kind = Operand::MEMORY;
+
+    if (!fold(address, op, 1)) {
+	op = Operand();
+	op.kind = Operand::MEMORY;
+	op.base = materialize(address);
+    }
+
+    return op;
+}
+
+
+/*
+ * Function:	multiplyBy (private)
+ *
+ * Description:	Multiply a register by a constant in place, just as when
+ *		generating code directly.
+ */
+
+static void multiplyBy(int r, unsigned value)
+{
+    unsigned odd = value, shift = 0;
+
+
+    while (odd != 0 && odd % 2 == 0) {
+	odd /= 2;
+	shift ++;
+    }
+
+    if (odd == 3 || odd == 5 || odd == 9) {
+	Operand op;
+
+	op.kind = Operand::MEMORY;
+	op.base = op.index = r;
+	op.scale = odd - 1;
+	code->emit(LEAL, op, registerOf(r));
+
+    } else if (odd != 1) {
+	code->emit(IMULL, Immediate(value), registerOf(r));
+	return;
+    }
+
+    if (shift > 0)
+	code->emit(SHLL, Immediate(shift), registerOf(r));
+}
+
+
+/*
+ * Function:	divideBy (private)
+ *
+ * Description:	Divide a value by a positive constant without using idivl,
+ *		just as when generating code directly.
+ */
+
+static void divideBy(int value, unsigned divisor, bool remainder, int r)
+{
+    Operand dividend = registerOf(materialize(value));
+    Operand eax = registerOf(EAX), edx = registerOf(EDX);
+    int quotient = remainder ? getreg()->number() : r, temp;
+    Operand q = registerOf(quotient);
+    unsigned shift;
+    int multiplier;
+
+
+    if (divisor == 1) {
+	code->emit(MOVL, remainder ? Immediate(0) : dividend, registerOf(r));
+	return;
+    }
+
+    if ((divisor & (divisor - 1)) == 0) {
+	for (shift = 0; (1u << shift) < divisor; shift ++)
+	    ;
+
+	code->emit(MOVL, dividend, q);
+
+	if (shift > 1)
+	    code->emit(SARL, Immediate(31), q);
+
+	code->emit(SHRL, Immediate(32 - shift), q);
+	code->emit(ADDL, dividend, q);
+	code->emit(SARL, Immediate(shift), q);
+
+    } else {
+	magic(divisor, multiplier, shift);
+
+	temp = getreg()->number();
+	code->emit(MOVL, dividend, eax);
+	code->emit(MOVL, Immediate(multiplier), registerOf(temp));
+	code->emit(IMULL, registerOf(temp));
+
+	if (multiplier < 0)
+	    code->emit(ADDL, dividend, edx);
+
+	if (shift > 0)
+	    code->emit(SARL, Immediate(shift), edx);
+
+	code->emit(MOVL, edx, q);
+
+	temp = getreg()->number();
+	code->emit(MOVL, dividend, registerOf(temp));
+	code->emit(SHRL, Immediate(31), registerOf(temp));
+	code->emit(ADDL, registerOf(temp), q);
+    }
+
+    if (remainder) {
+	multiplyBy(quotient, divisor);
+	code->emit(MOVL, dividend, registerOf(r));
+	code->emit(SUBL, q, registerOf(r));
+    }
+}
+
+
+/*
+ * Function:	compare (private)
+ *
+ * Description:	Compare the operands of a comparison and return the
+ *		condition to test, numbered as the opcodes that test it.
+ */
+
+static unsigned compare(int value)
+{
+    const Value &v = graph->values[value];
+    int left = v.args[0], right = v.args[1];
+    Op op = v.op;
+
+
+    if (isImmediate(left) && !isImmediate(right)) {
+	swap(left, right);
+	op = mirrored[op - OP_EQ];
+    }
+
+    code->emit(CMPL, source(right), registerOf(materialize(left)));
+    return op - OP_EQ;
+}
+
+
+/*
+ * Function:	call (private)
+ *
+ * Description:	Call a function, pushing the arguments from last to first,
+ *		and then copy the result into a register if it is kept.
+ */
+
+static void call(int value, int r)
+{
+    const Value &v = graph->values[value];
+    unsigned first = v.object.kind == Operand::NONE ? 1 : 0;
+    unsigned numBytes = SIZEOF_REG * (v.args.size() - first);
+    unsigned padding = (STACK_ALIGNMENT - numBytes % STACK_ALIGNMENT) % STACK_ALIGNMENT;
+    Operand esp = registerOf(ESP);
+
+
+    if (padding != 0) {
+	code->emit(SUBL, Immediate(padding), esp);
+	numBytes += padding;
+    }
+
+    for (unsigned i = v.args.size(); i > first; i --)
+	code->emit(PUSHL, source(v.args[i - 1]));
+
+    if (first > 0)
+	code->emit(CALL, registerOf(materialize(v.args[0])));
+    else
+	code->emit(CALL, v.object);
+
+    if (numBytes > 0)
+	code->emit(ADDL, Immediate(numBytes), esp);
+
+    if (r != NOREG)
+	code->emit(MOVL, registerOf(EAX), registerOf(r));
+}
+
+
+/*
+ * Function:	compute (private)
+ *
+ * Description:	Compute a value into a register.
+ */
+
+static void compute(int value, int r)
+{
+    const Value &v = graph->values[value];
+    Operand dst = registerOf(r), op;
+    int left, right;
+    unsigned cc;
+
+
+    switch (v.op) {
+    case OP_CONST:
+    case OP_UNDEF:
+	code->emit(MOVL, Immediate(constantOf(value)), dst);
+	break;
+
+    case OP_ADDRESS:
+	code->emit(LEAL, memoryOf(value), dst);
+	break;
+
+    case OP_COPY:
+	code->emit(MOVL, source(v.args[0]), dst);
+	break;
+
+    case OP_LOAD:
+	code->emit(v.size == 1 ? MOVZBL : MOVL, memoryOf(v.args[0]), dst);
+	break;
+
+    case OP_CALL:
+	call(value, r);
+	break;
+
+    case OP_ADD:
+	op.kind = Operand::MEMORY;
+
+	if (fold(v.args[0], op, 1) && fold(v.args[1], op, 1)) {
+	    if (op.index != NOREG || op.label >= 0 || op.symbol != Name())
+		code->emit(LEAL, op, dst);
+	    else if (op.base == NOREG)
+		code->emit(MOVL, Immediate(op.value), dst);
+	    else if (op.value == 0)
+		code->emit(MOVL, registerOf(op.base), dst);
+	    else
+		code->emit(LEAL, op, dst);
+
+	} else {
+	    code->emit(MOVL, source(v.args[0]), dst);
+	    code->emit(ADDL, source(v.args[1]), dst);
+	}
+
+	break;
+
+    case OP_SUB:
+	code->emit(MOVL, source(v.args[0]), dst);
+	code->emit(SUBL, source(v.args[1]), dst);
+	break;
+
+    case OP_MUL:
+	left = v.args[0], right = v.args[1];
+
+	if (isImmediate(left))
+	    swap(left, right);
+
+	code->emit(MOVL, source(left), dst);
+
+	if (isImmediate(right))
+	    multiplyBy(r, constantOf(right));
+	else
+	    code->emit(IMULL, source(right), dst);
+
+	break;
+
+    case OP_DIV:
+    case OP_REM:
+	right = v.args[1];
+
+	if (isImmediate(right) && constantOf(right) > 0) {
+	    divideBy(v.args[0], constantOf(right), v.op == OP_REM, r);
+	    break;
+	}
+
+	op = registerOf(materialize(right));
+	code->emit(MOVL, source(v.args[0]), registerOf(EAX));
+	code->emit(CLTD);
+	code->emit(IDIVL, op);
+	code->emit(MOVL, registerOf(v.op == OP_DIV ? EAX : EDX), dst);
+	break;
+
+    case OP_NEG:
+	code->emit(MOVL, source(v.args[0]), dst);
+	code->emit(NEGL, Operand(), dst);
+	break;
+
+    case OP_EXTEND:
+	if (isImmediate(v.args[0]))
+	    code->emit(MOVL, Immediate((signed char) constantOf(v.args[0])), dst);
+	else
+	    code->emit(MOVSBL, registerOf(materialize(v.args[0]), 1), dst);
+
+	break;
+
+    default:
+	assert(isCompare(v.op));
+	cc = compare(value);
+	code->emit(Opcode(SETE + cc), Operand(), registerOf(r, 1));
+	code->emit(MOVZBL, registerOf(r, 1), dst);
+	break;
+    }
+}
+
+
+/*
+ * Function:	materialize (private)
+ *
+ * Description:	Return the register holding a value, computing it into a
+ *		fresh register if it is not kept.
+ */
+
+static int materialize(int value)
+{
+    int r;
+
+
+    if (reg[value] != NOREG)
+	return reg[value];
+
+    r = getreg()->number();
+    compute(value, r);
+    return r;
+}
+
+
+/*
+ * Function:	reads (private)
+ *
+ * Description:	Return whether computing a value reads a register.
+ */
+
+static bool reads(int value, int r)
+{
+    for (auto arg : graph->values[value].args) {
+	if (reg[arg] == r)
+	    return true;
+
+	if (reg[arg] == NOREG && folded[arg] && reads(arg, r))
+	    return true;
+    }
+
+    return false;
+}
+
+
+/*
+ * Function:	clobbers (private)
+ *
+ * Description:	Return whether computing a value into a register would
+ *		overwrite one of its operands before it is done reading
+ *		it, which happens if the two share a register.  Most
+ *		instructions first move their left operand into the
+ *		destination and only then read the right one.
+ */
+
+static bool clobbers(int value, int r)
+{
+    const Value &v = graph->values[value];
+    int right;
+
+
+    if (r == NOREG)
+	return false;
+
+    switch (v.op) {
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+	right = v.args[1];
+	return reg[right] == r || (reg[right] == NOREG && folded[right] && reads(right, r));
+
+    case OP_DIV:
+	return isImmediate(v.args[1]) && reg[v.args[0]] == r;
+
+    default:
+	return false;
+    }
+}
+
+
+/*
+ * Function:	define (private)
+ *
+ * Description:	Compute a value into its own register where it is defined,
+ *		or into a fresh one first if that would overwrite one of its
+ *		operands.
+ */
+
+static void define(int value)
+{
+    int r = reg[value], temp;
+
+
+    if (clobbers(value, r)) {
+	temp = getreg()->number();
+	compute(value, temp);
+	code->emit(MOVL, registerOf(temp), registerOf(r));
+    } else
+	compute(value, r);
+}
+
+
+/*
+ * Function:	store (private)
+ *
+ * Description:	Store a value, truncating a constant stored as a byte.
+ */
+
+static void store(int value)
+{
+    const Value &v = graph->values[value];
+    Operand src;
+
+
+    if (isImmediate(v.args[1]))
+	src = Immediate(v.size == 1 ? constantOf(v.args[1]) & 0xff : constantOf(v.args[1]));
+    else
+	src = registerOf(materialize(v.args[1]), v.size);
+
+    code->emit(v.size == 1 ? MOVB : MOVL, src, memoryOf(v.args[0]));
+}
+
+
+/*
+ * Function:	expand (private)
+ *
+ * Description:	Call a function for each kept value read when a value is
+ *		used, which for a value that is not kept are those read
+ *		when computing it.
+ */
+
+template<class F>
+static void expand(int value, F f)
+{
+    if (reg[value] != NOREG)
+	f(value);
+    else if (folded[value])
+	for (auto arg : graph->values[value].args)
+	    expand(arg, f);
+}
+
+
+/*
+ * Function:	forEachUse (private)
+ *
+ * Description:	Call a function for each kept value read by the code for a
+ *		value where it is defined.  A branch on a comparison reads
+ *		the operands of the comparison.
+ */
+
+template<class F>
+static void forEachUse(int value, F f)
+{
+    const Value &v = graph->values[value];
+
+
+    if (v.op == OP_BRANCH && isCompare(graph->values[v.args[0]].op)) {
+	for (auto arg : graph->values[v.args[0]].args)
+	    expand(arg, f);
+
+    } else if (reg[value] != NOREG || v.op == OP_STORE || v.op == OP_CALL || isTerminator(v.op))
+	for (auto arg : v.args)
+	    expand(arg, f);
+}
+
+
+/*
+ * Function:	incoming (private)
+ *
+ * Description:	Return the position of an edge among the predecessors of
+ *		its target, which is that of the operands of its phis.
+ */
+
+static unsigned incoming(int from, int to)
+{
+    const vector<int> &preds = graph->vertices[to].preds;
+
+    return find(preds.begin(), preds.end(), from) - preds.begin();
+}
+
+
+/*
+ * Function:	analyze (private)
+ *
+ * Description:	Solve for the values live at the boundaries of each vertex.
+ *		Only the values given bits are tracked.  A phi defines its
+ *		value at the start of its vertex and uses its operands at
+ *		the ends of its predecessors.  Since the problem is solved
+ *		backward, only the successors of the graph are needed.
+ */
+
+static void analyze(unsigned numBits)
+{
+    unsigned n = graph->vertices.size(), words;
+    Word *gen, *kill;
+
+
+    flow.numBlocks = n;
+    flow.succs.assign(2 * n, -1);
+
+    for (auto v : graph->order)
+	for (unsigned i = 0; i < graph->vertices[v].succs.size(); i ++)
+	    flow.succs[2 * v + i] = graph->vertices[v].succs[i];
+
+    live.forward = false;
+    live.intersect = false;
+    initialize(live, flow, numBits);
+    words = live.numWords;
+
+    for (auto v : graph->order) {
+	const Vertex &vertex = graph->vertices[v];
+
+	gen = &live.gen[v * words];
+	kill = &live.kill[v * words];
+
+	auto use = [&](int value) {
+	    if (bit[value] >= 0)
+		add(gen, bit[value]);
+	};
+
+	for (auto s : vertex.succs) {
+	    unsigned i = incoming(v, s);
+
+	    for (auto phi : graph->vertices[s].phis)
+		expand(graph->values[phi].args[i], use);
+	}
+
+	for (unsigned i = vertex.values.size(); i > 0; i --) {
+	    int value = vertex.values[i - 1];
+
+	    if (bit[value] >= 0) {
+		remove(gen, bit[value]);
+		add(kill, bit[value]);
+	    }
+
+	    forEachUse(value, use);
+	}
+
+	for (auto phi : vertex.phis)
+	    if (bit[phi] >= 0) {
+		remove(gen, bit[phi]);
+		add(kill, bit[phi]);
+	    }
+    }
+
+    solve(live, flow);
+}
+
+
+/*
+ * Function:	liveAfter (private)
+ *
+ * Description:	Return whether a value is live after the given position in
+ *		a vertex, where -1 is after its phis.
+ */
+
+static bool liveAfter(int value, int v, int after)
+{
+    const Vertex &vertex = graph->vertices[v];
+    const Value &x = graph->values[value];
+    unsigned i, words = live.numWords;
+    bool found = false;
+
+
+    if (x.vertex == v && position[value] > after)
+	return false;
+
+    if (has(&live.out[v * words], bit[value]))
+	return true;
+
+    auto use = [&](int u) {
+	if (u == value)
+	    found = true;
+    };
+
+    for (auto s : vertex.succs) {
+	unsigned j = incoming(v, s);
+
+	for (auto phi : graph->vertices[s].phis)
+	    expand(graph->values[phi].args[j], use);
+    }
+
+    for (i = after + 1; !found && i < vertex.values.size(); i ++)
+	forEachUse(vertex.values[i], use);
+
+    return found;
+}
+
+
+/*
+ * Function:	interfere (private)
+ *
+ * Description:	Return whether two values interfere, which is if either is
+ *		live where the other is defined.
+ */
+
+static bool interfere(int a, int b)
+{
+    const Value &x = graph->values[a], &y = graph->values[b];
+
+    return liveAfter(a, y.vertex, position[b]) || liveAfter(b, x.vertex, position[a]);
+}
+
+
+/*
+ * Function:	coalesce (private)
+ *
+ * Description:	Give each phi and as many of its operands as possible the
+ *		same register.  Values sharing a register form a class, and
+ *		the classes of a phi and an operand are merged if none of
+ *		their members interfere.  A class that grows too large
+ *		stops merging, since checking it grows with its square.
+ */
+
+static void coalesce()
+{
+    vector<int> phis;
+    unsigned numBits = 0;
+    bool ok;
+
+
+    bit.assign(graph->values.size(), -1);
+    classes.clear();
+
+    for (auto v : graph->order)
+	for (auto phi : graph->vertices[v].phis) {
+	    phis.push_back(phi);
+
+	    if (bit[phi] < 0)
+		bit[phi] = numBits ++;
+
+	    for (auto arg : graph->values[phi].args)
+		if (reg[arg] != NOREG && bit[arg] < 0)
+		    bit[arg] = numBits ++;
+	}
+
+    if (phis.empty())
+	return;
+
+    analyze(numBits);
+
+    for (unsigned value = 0; value < bit.size(); value ++)
+	if (bit[value] >= 0)
+	    classes[reg[value]].assign(1, value);
+
+    for (auto phi : phis)
+	for (auto arg : graph->values[phi].args) {
+	    if (bit[arg] < 0 || reg[arg] == reg[phi])
+		continue;
+
+	    vector<int> &ours = classes[reg[phi]], &theirs = classes[reg[arg]];
+
+	    if (ours.size() * theirs.size() > MAX_CHECKS)
+		continue;
+
+	    ok = true;
+
+	    for (unsigned i = 0; ok && i < ours.size(); i ++)
+		for (unsigned j = 0; ok && j < theirs.size(); j ++)
+		    if (interfere(ours[i], theirs[j]))
+			ok = false;
+
+	    if (ok) {
+		int old = reg[arg];
+
+		for (auto member : theirs) {
+		    reg[member] = reg[phi];
+		    ours.push_back(member);
+		}
+
+		classes.erase(old);
+	    }
+	}
+}
+
+
+/*
+ * Function:	classify (private)
+ *
+ * Description:	Decide which values are kept in registers.  A comparison
+ *		used only by branches, and a sum or scaled index used only
+ *		to address memory, directly or through other such sums, are
+ *		folded into their uses instead.  Those are found by
+ *		assuming every candidate is folded and then keeping any
+ *		with a use that cannot fold it, until none change.
+ */
+
+static void classify()
+{
+    unsigned n = graph->values.size();
+    bool changed;
+
+
+    users.resize(n);
+    reg.assign(n, NOREG);
+    folded.assign(n, false);
+    position.assign(n, -1);
+
+    for (auto &u : users)
+	u.clear();
+
+    for (auto v : graph->order) {
+	const Vertex &vertex = graph->vertices[v];
+
+	for (auto phi : vertex.phis)
+	    for (auto arg : graph->values[phi].args)
+		users[arg].push_back(phi);
+
+	for (unsigned i = 0; i < vertex.values.size(); i ++) {
+	    const Value &x = graph->values[vertex.values[i]];
+
+	    position[vertex.values[i]] = i;
+
+	    for (auto arg : x.args)
+		users[arg].push_back(vertex.values[i]);
+
+	    if (isCompare(x.op))
+		folded[vertex.values[i]] = true;
+
+	    else if (x.op == OP_ADD)
+		folded[vertex.values[i]] = true;
+
+	    else if (x.op == OP_MUL) {
+		int c = isImmediate(x.args[0]) ? x.args[0] : x.args[1];
+		unsigned s = constantOf(c);
+
+		if (isImmediate(c) && (s == 1 || s == 2 || s == 4 || s == 8))
+		    folded[vertex.values[i]] = true;
+	    }
+	}
+    }
+
+    do {
+	changed = false;
+
+	for (unsigned value = 0; value < n; value ++) {
+	    const Value &x = graph->values[value];
+
+	    if (!folded[value] || x.vertex < 0)
+		continue;
+
+	    for (auto user : users[value]) {
+		const Value &u = graph->values[user];
+		bool ok;
+
+		if (isCompare(x.op))
+		    ok = u.op == OP_BRANCH;
+		else if (u.op == OP_LOAD)
+		    ok = true;
+		else if (u.op == OP_STORE)
+		    ok = u.args[1] != (int) value;
+		else
+		    ok = (u.op == OP_ADD || u.op == OP_MUL) && folded[user];
+
+		if (!ok) {
+		    folded[value] = false;
+		    changed = true;
+		    break;
+		}
+	    }
+	}
+    } while (changed);
+
+    for (auto v : graph->order) {
+	const Vertex &vertex = graph->vertices[v];
+
+	for (auto phi : vertex.phis)
+	    reg[phi] = getreg()->number();
+
+	for (auto value : vertex.values) {
+	    const Value &x = graph->values[value];
+
+	    if (folded[value] || isImmediate(value) || x.op == OP_ADDRESS)
+		continue;
+
+	    if (x.op == OP_STORE || isTerminator(x.op))
+		continue;
+
+	    if (x.op == OP_CALL && users[value].empty())
+		continue;
+
+	    reg[value] = getreg()->number();
+	}
+    }
+}
+
+
+/*
+ * Function:	resolve (private)
+ *
+ * Description:	Return the vertex that a jump to a vertex ends up at,
+ *		skipping any that do nothing but jump again.
+ */
+
+static int resolve(int v)
+{
+    for (unsigned n = 0; n < graph->vertices.size(); n ++) {
+	const Vertex &vertex = graph->vertices[v];
+
+	if (v == graph->order[0] || !vertex.phis.empty() || vertex.values.size() != 1)
+	    break;
+
+	if (graph->values[vertex.values[0]].op != OP_JUMP)
+	    break;
+
+	if (!graph->vertices[vertex.succs[0]].phis.empty())
+	    break;
+
+	v = vertex.succs[0];
+    }
+
+    return v;
+}
+
+
+/*
+ * Function:	copies (private)
+ *
+ * Description:	Return the copies for the phis along an edge.
+ */
+
+static vector<Copy> copies(int from, int to)
+{
+    unsigned i = incoming(from, to);
+    vector<Copy> result;
+    int arg;
+
+
+    for (auto phi : graph->vertices[to].phis) {
+	arg = graph->values[phi].args[i];
+
+	if (reg[arg] != reg[phi] && graph->values[arg].op != OP_UNDEF)
+	    result.push_back({reg[phi], arg});
+    }
+
+    return result;
+}
+
+
+/*
+ * Function:	safe (private)
+ *
+ * Description:	Return whether copies can be made before a branch rather
+ *		than along its edge, which is if none of them overwrites a
+ *		value live on entry to the other target, or an operand of a
+ *		phi of that target along the other edge.  An operand whose
+ *		copy was dropped because it shares the register of its phi
+ *		is still read there, so it counts as well.  Unless the
+ *		copies along the other edge are made after the branch, none
+ *		may also write the register of one of its phis differently.
+ */
+
+static bool safe(const vector<Copy> &moves, int from, int other, bool after)
+{
+    const Word *in = &live.in[other * live.numWords];
+    unsigned i = incoming(from, other);
+    int arg;
+
+
+    for (auto &move : moves) {
+	for (auto member : classes[move.dst])
+	    if (has(in, bit[member]))
+		return false;
+
+	for (auto phi : graph->vertices[other].phis) {
+	    arg = graph->values[phi].args[i];
+
+	    if (graph->values[arg].op == OP_UNDEF)
+		continue;
+
+	    if (reg[arg] == move.dst)
+		return false;
+
+	    if (!after && reg[phi] == move.dst && arg != move.src)
+		return false;
+	}
+    }
+
+    return true;
+}
+
+
+/*
+ * Function:	parallel (private)
+ *
+ * Description:	Make a set of copies as if all at once.  Any sources that
+ *		must be computed are computed first.  A copy is made once
+ *		no other copy still reads its destination, and a cycle of
+ *		copies is broken by moving one destination aside.
+ */
+
+static void parallel(const vector<Copy> &moves)
+{
+    vector<pair<int, Operand>> pending;
+    unsigned i, j;
+    int temp;
+
+
+    for (auto &move : moves) {
+	Operand src = source(move.src);
+
+	if (src.kind != Operand::REGISTER || src.base != move.dst)
+	    pending.push_back({move.dst, src});
+    }
+
+    while (!pending.empty()) {
+	for (i = 0; i < pending.size(); i ++) {
+	    for (j = 0; j < pending.size(); j ++)
+		if (pending[j].second.kind == Operand::REGISTER && pending[j].second.base == pending[i].first)
+		    break;
+
+	    if (j == pending.size())
+		break;
+	}
+
+	if (i < pending.size()) {
+	    code->emit(MOVL, pending[i].second, registerOf(pending[i].first));
+	    pending.erase(pending.begin() + i);
+	    continue;
+	}
+
+	temp = getreg()->number();
+	code->emit(MOVL, registerOf(pending[0].first), registerOf(temp));
+
+	for (auto &p : pending)
+	    if (p.second.kind == Operand::REGISTER && p.second.base == pending[0].first)
+		p.second = registerOf(temp);
+    }
+}
+
+
+/*
+ * Function:	target (private)
+ *
+ * Description:	Return the target operand for a jump to a vertex.
+ */
+
+static Operand target(int v)
+{
+    return Target(labels[v]);
+}
+
+
+/*
+ * Function:	branch (private)
+ *
+ * Description:	Generate the branch that ends a vertex.  The copies along
+ *		each edge are made before the branch if that is safe and
+ *		on a split edge otherwise.  The vertex laid out next is
+ *		reached by falling through if possible.
+ */
+
+static void branch(int v, int cond, int next)
+{
+    const Vertex &vertex = graph->vertices[v];
+    int ifTrue = vertex.succs[0], ifFalse = vertex.succs[1];
+    vector<Copy> onTrue, onFalse, before;
+    bool splitTrue, splitFalse;
+    Operand yes, no;
+    unsigned cc;
+
+
+    if (isCompare(graph->values[cond].op))
+	cc = compare(cond);
+    else {
+	code->emit(CMPL, Immediate(0), registerOf(materialize(cond)));
+	cc = OP_NE - OP_EQ;
+    }
+
+    onTrue = copies(v, ifTrue);
+    onFalse = copies(v, ifFalse);
+
+    splitTrue = !onTrue.empty() && !safe(onTrue, v, vertex.succs[1], false);
+    splitFalse = !onFalse.empty() && !safe(onFalse, v, vertex.succs[0], false);
+
+    if (splitTrue != splitFalse) {
+	if (splitTrue)
+	    splitFalse = !safe(onFalse, v, vertex.succs[0], true);
+	else
+	    splitTrue = !safe(onTrue, v, vertex.succs[1], true);
+    }
+
+    ifTrue = resolve(ifTrue);
+    ifFalse = resolve(ifFalse);
+    yes = target(ifTrue);
+    no = target(ifFalse);
+
+    if (splitTrue) {
+	splits.push_back({Label(), onTrue, vertex.succs[0]});
+	yes = Target(splits.back().label);
+	ifTrue = -1;
+    } else
+	before.insert(before.end(), onTrue.begin(), onTrue.end());
+
+    if (splitFalse) {
+	splits.push_back({Label(), onFalse, vertex.succs[1]});
+	no = Target(splits.back().label);
+	ifFalse = -1;
+    } else
+	before.insert(before.end(), onFalse.begin(), onFalse.end());
+
+    parallel(before);
+
+    if (ifFalse == next)
+	code->emit(Opcode(JE + cc), yes);
+    else if (ifTrue == next)
+	code->emit(negated[cc], no);
+    else {
+	code->emit(Opcode(JE + cc), yes);
+	code->emit(JMP, no);
+    }
+}
+
+
+/*
+ * Function:	terminate (private)
+ *
+ * Description:	Generate the instruction that ends a vertex.
+ */
+
+static void terminate(int v, int next)
+{
+    const Vertex &vertex = graph->vertices[v];
+    const Value &last = graph->values[vertex.values.back()];
+    int to;
+
+
+    if (last.op == OP_RETURN) {
+	if (!last.args.empty())
+	    code->emit(MOVL, source(last.args[0]), registerOf(EAX));
+
+	code->emit(JMP, code->exit());
+	return;
+    }
+
+    if (last.op == OP_BRANCH && !isImmediate(last.args[0])) {
+	branch(v, last.args[0], next);
+	return;
+    }
+
+    if (last.op == OP_BRANCH)
+	to = vertex.succs[constantOf(last.args[0]) != 0 ? 0 : 1];
+    else
+	to = vertex.succs[0];
+
+    parallel(copies(v, to));
+    to = resolve(to);
+
+    if (to != next)
+	code->emit(JMP, target(to));
+}
+
+
+/*
+ * Function:	selectInstructions
+ *
+ * Description:	Translate the graph of a function into assembly code,
+ *		which is added to the current function.
+ */
+
+void selectInstructions(const Graph &g, Assembly &c)
+{
+    unsigned i;
+    int v, next;
+
+
+    graph = &g;
+    code = &c;
+    splits.clear();
+
+    classify();
+    coalesce();
+
+    labels.clear();
+    labels.resize(graph->vertices.size());
+
+    for (i = 0; i < graph->order.size(); i ++) {
+	v = graph->order[i];
+	next = i + 1 < graph->order.size() ? graph->order[i + 1] : -1;
+
+	if (i > 0)
+	    code->label(target(v), graph->vertices[v].aligned);
+
+	for (auto value : graph->vertices[v].values) {
+	    const Value &x = graph->values[value];
+
+	    if (isTerminator(x.op))
+		break;
+
+	    if (x.op == OP_STORE)
+		store(value);
+	    else if (reg[value] != NOREG || x.op == OP_CALL)
+		define(value);
+	}
+
+	terminate(v, next);
+    }
+
+    for (auto &split : splits) {
+	code->label(Target(split.label));
+	parallel(split.copies);
+	code->emit(JMP, target(resolve(split.target)));
+    }
+}
@@ -0,0 +1,16 @@
+/*
+ * File:	selector.h
+ *
+ * Description:	This file contains the function declaration for the
+ *		instruction selector for Simple C, which translates the
+ *		intermediate representation of a function into assembly
+ *		code.
+ */
+
+# ifndef SELECTOR_H
+# define SELECTOR_H
+# include "ssa.h"
+
+void selectInstructions(const Graph &graph, Assembly &code);
+
+# endif /* SELECTOR_H */
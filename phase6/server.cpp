@@ -0,0 +1,422 @@
+/*
+ * File:	server.cpp
+ *
+ * Description:	This file contains the function definitions for running
+ *		Simple C as a compile server, which keeps the tables of
+ *		names and types, and everything else shared by translation
+ *		units, warm from one request to the next.
+ *
+ *		A client connects to the socket of the server and sends it
+ *		three file descriptors: one to read the source from, one to
+ *		write the assembly to, and one to report errors to.  The
+ *		server compiles the source in a context of its own, writing
+ *		straight to the descriptors of the client, and then replies
+ *		with a single byte giving the exit status.  Since a client
+ *		normally hands over its own standard input, output, and
+ *		error, it behaves just like the compiler itself, and
+ *		neither the source nor the assembly is ever copied through
+ *		the socket.
+ *
+ *		Requests are compiled on a pool of threads, all with the
+ *		options the server was started with.  The server runs until
+ *		it is interrupted or terminated, and then removes its
+ *		socket.
+ *
+ *		Since the descriptors passed carry the rights of whoever
+ *		opened them, each end checks that the other is run by the
+ *		same user before passing or using any, and the socket is
+ *		made accessible only to its owner, by default in a
+ *		directory that is private to the user.
+ */
+
+# include <cerrno>
+# include <csignal>
+# include <cstdlib>
+# include <cstring>
+# include <unistd.h>
+# include <sys/socket.h>
+# include <sys/stat.h>
+# include <sys/un.h>
+# include "server.h"
+# include "parser.h"
+# include "source.h"
+# include "pool.h"
+# include "cache.h"
+
+using namespace std;
+
+static const unsigned NUM_DESCRIPTORS = 3;
+static const size_t ERROR_CAPACITY = 1 << 12;
+
+static char socketPath[sizeof(sockaddr_un::sun_path)];
+
+
+/*
+ * Function:	defaultSocket
+ *
+ * Description:	Return the path of the socket to use if none is given,
+ *		which is taken from the environment if it is set there.
+ *		Otherwise, it is in the runtime directory of the user, or
+ *		failing that in a directory of our own under /tmp, which is
+ *		made if need be and must be owned by us and inaccessible to
+ *		anyone else, since anybody may make it first.  Return an
+ *		empty string if there is no such directory, with errno set.
+ */
+
+string defaultSocket()
+{
+    const char *path = getenv("SCC_SOCKET");
+    struct stat st;
+    string dir;
+
+
+    if (path != nullptr && *path != '\0')
+	return path;
+
+    if ((path = getenv("XDG_RUNTIME_DIR")) != nullptr && *path == '/')
+	return string(path) + "/scc.socket";
+
+    dir = "/tmp/scc-" + to_string(getuid());
+
+    if (mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST)
+	return "";
+
+    if (lstat(dir.c_str(), &st) < 0)
+	return "";
+
+    if (!S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 077) != 0) {
+	errno = EACCES;
+	return "";
+    }
+
+    return dir + "/socket";
+}
+
+
+/*
+ * Function:	address (private)
+ *
+ * Description:	Fill in the address of the socket with the given path.
+ *		Return false if the path is too long, with errno set.
+ */
+
+static bool address(const string &path, sockaddr_un &addr)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+	errno = ENAMETOOLONG;
+	return false;
+    }
+
+    strcpy(addr.sun_path, path.c_str());
+    return true;
+}
+
+
+/*
+ * Function:	trusted (private)
+ *
+ * Description:	Return whether the process at the other end of a socket
+ *		is run by the same user as we are.
+ */
+
+static bool trusted(int sock)
+{
+    struct ucred cred;
+    socklen_t length = sizeof(cred);
+
+
+    if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &length) < 0)
+	return false;
+
+    return length == sizeof(cred) && cred.uid == getuid();
+}
+
+
+/*
+ * Function:	transfer (private)
+ *
+ * Description:	Send the given file descriptors over a socket along with a
+ *		single byte, since at least one byte of data must go with
+ *		them.  Return false on failure, with errno set.
+ */
+
+static bool transfer(int sock, const int fds[])
+{
+    char control[CMSG_SPACE(NUM_DESCRIPTORS * sizeof(int))];
+    char byte = 0;
+    struct iovec iov = {&byte, 1};
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+
+
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(NUM_DESCRIPTORS * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, NUM_DESCRIPTORS * sizeof(int));
+
+    while (sendmsg(sock, &msg, 0) < 0)
+	if (errno != EINTR)
+	    return false;
+
+    return true;
+}
+
+
+/*
+ * Function:	receive (private)
+ *
+ * Description:	Receive the file descriptors of a request from a socket.
+ *		Return false unless exactly the expected number arrived, in
+ *		which case any that did are closed.
+ */
+
+static bool receive(int sock, int fds[])
+{
+    char control[CMSG_SPACE(NUM_DESCRIPTORS * sizeof(int))];
+    char byte;
+    struct iovec iov = {&byte, 1};
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    unsigned count;
+    ssize_t n;
+
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    while ((n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) < 0)
+	if (errno != EINTR)
+	    return false;
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+
+    if (n != 1 || cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET
+	    || cmsg->cmsg_type != SCM_RIGHTS)
+	return false;
+
+    count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    memcpy(fds, CMSG_DATA(cmsg), min(count, NUM_DESCRIPTORS) * sizeof(int));
+
+    if (count == NUM_DESCRIPTORS && !(msg.msg_flags & MSG_CTRUNC))
+	return true;
+
+    for (unsigned i = 0; i < min(count, NUM_DESCRIPTORS); i ++)
+	close(fds[i]);
+
+    return false;
+}
+
+
+/*
+ * Function:	answer (private)
+ *
+ * Description:	Answer a single request on the given connection, and close
+ *		it.  The source is compiled in a context of its own, whose
+ *		output and errors go to the descriptors of the client.  The
+ *		cache, if any, is trimmed only once the client has its
+ *		answer.  A client run by anyone else is refused without
+ *		reading its request.
+ */
+
+static void answer(int sock)
+{
+    char status = EXIT_FAILURE;
+    int fds[NUM_DESCRIPTORS];
+
+
+    if (trusted(sock) && receive(sock, fds)) {
+	{
+	    Emitter errors(ERROR_CAPACITY);
+	    CompilerContext unit;
+	    Source source;
+
+	    errors.open(fds[2]);
+	    unit.errors = &errors;
+	    unit.emitter.open(fds[1]);
+
+	    if (!source.open(fds[0]))
+		errors << "cannot read source: " << strerror(errno) << endl;
+
+	    else if (!compile(unit, source.begin(), source.end()))
+		unit.emitter.close();
+
+	    else if (!unit.emitter.close())
+		errors << "write error: " << strerror(errno) << endl;
+
+	    else
+		status = EXIT_SUCCESS;
+
+	    errors.close();
+	}
+
+	for (unsigned i = 0; i < NUM_DESCRIPTORS; i ++)
+	    close(fds[i]);
+    }
+
+    while (write(sock, &status, 1) < 0 && errno == EINTR)
+	continue;
+
+    close(sock);
+    trimCache();
+}
+
+
+/*
+ * Function:	stop (private)
+ *
+ * Description:	Remove the socket and exit when told to stop.  Only calls
+ *		that are safe in a signal handler may be used here.
+ */
+
+static void stop(int sig)
+{
+    unlink(socketPath);
+    _exit(EXIT_SUCCESS);
+}
+
+
+/*
+ * Function:	serve
+ *
+ * Description:	Listen on the socket with the given path, and answer each
+ *		request on a pool of the given number of threads until told
+ *		to stop.  A socket left behind by a server that is gone is
+ *		replaced, but one that is still being served is not.  The
+ *		socket is made accessible only to us.  Return false if the
+ *		socket can't be set up, with errno set.
+ */
+
+bool serve(const string &path, unsigned threads)
+{
+    struct sockaddr_un addr;
+    int listener, sock;
+    mode_t mask;
+    Pool pool;
+
+
+    if (!address(path, addr))
+	return false;
+
+    if ((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+	return false;
+
+    if (connect(sock, (sockaddr *) &addr, sizeof(addr)) == 0) {
+	close(sock);
+	errno = EADDRINUSE;
+	return false;
+    }
+
+    close(sock);
+    unlink(path.c_str());
+
+    if ((listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+	return false;
+
+    mask = umask(077);
+
+    if (bind(listener, (sockaddr *) &addr, sizeof(addr)) < 0) {
+	umask(mask);
+	close(listener);
+	return false;
+    }
+
+    umask(mask);
+
+    if (listen(listener, SOMAXCONN) < 0) {
+	unlink(path.c_str());
+	close(listener);
+	return false;
+    }
+
+    strcpy(socketPath, path.c_str());
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    if (threads > 1)
+	pool.start(threads);
+
+    while (true) {
+	if ((sock = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC)) < 0) {
+	    if (errno == EINTR || errno == ECONNABORTED)
+		continue;
+
+	    unlink(socketPath);
+	    close(listener);
+	    return false;
+	}
+
+	pool.submit([sock] { answer(sock); });
+    }
+}
+
+
+/*
+ * Function:	request
+ *
+ * Description:	Ask the server on the socket with the given path to compile
+ *		the source read from one descriptor into assembly written
+ *		to another, with errors going to our standard error.
+ *		Return the exit status of the compilation, or -1 if the
+ *		server could not be reached or is run by anyone else, with
+ *		errno set.
+ */
+
+int request(const string &path, int input, int output)
+{
+    int fds[NUM_DESCRIPTORS] = {input, output, STDERR_FILENO};
+    struct sockaddr_un addr;
+    char status;
+    ssize_t n;
+    int sock;
+
+
+    if (!address(path, addr))
+	return -1;
+
+    if ((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+	return -1;
+
+    if (connect(sock, (sockaddr *) &addr, sizeof(addr)) < 0) {
+	close(sock);
+	return -1;
+    }
+
+    if (!trusted(sock)) {
+	close(sock);
+	errno = EPERM;
+	return -1;
+    }
+
+    if (!transfer(sock, fds)) {
+	close(sock);
+	return -1;
+    }
+
+    while ((n = read(sock, &status, 1)) < 0 && errno == EINTR)
+	continue;
+
+    close(sock);
+
+    if (n == 1)
+	return status;
+
+    if (n == 0)
+	errno = ECONNRESET;
+
+    return -1;
+}
@@ -0,0 +1,17 @@
+/*
+ * File:	server.h
+ *
+ * Description:	This file contains the function declarations for running
+ *		Simple C as a compile server on a local socket, and for the
+ *		client that sends it requests.
+ */
+
+# ifndef SERVER_H
+# define SERVER_H
+# include <string>
+
+std::string defaultSocket();
+bool serve(const std::string &path, unsigned threads);
+int request(const std::string &path, int input, int output);
+
+# endif /* SERVER_H */
@@ -0,0 +1,159 @@
+/*
+ * File:	source.cpp
+ *
+ * Description:	This file contains the member function definitions for the
+ *		source input of Simple C.
+ */
+
+# include <cerrno>
+# include <cstdlib>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include "source.h"
+
+using namespace std;
+
+
+/*
+ * Function:	Source::Source (constructor)
+ *
+ * Description:	Initialize an empty source.
+ */
+
+Source::Source()
+    : _data(nullptr), _size(0), _mapped(false)
+{
+}
+
+
+/*
+ * Function:	Source::~Source (destructor)
+ *
+ * Description:	Release the buffer, however we obtained it.
+ */
+
+Source::~Source()
+{
+    if (_mapped)
+	munmap(_data, _size);
+    else
+	free(_data);
+}
+
+
+/*
+ * Function:	Source::open
+ *
+ * Description:	Open the named file and make its contents available.
+ *		Return false on failure, with errno set.
+ */
+
+bool Source::open(const string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    bool ok;
+
+
+    if (fd < 0)
+	return false;
+
+    ok = open(fd);
+    ::close(fd);
+    return ok;
+}
+
+
+/*
+ * Function:	Source::open
+ *
+ * Description:	Make the contents of the given file descriptor available.
+ *		A non-empty regular file is mapped; anything else is read
+ *		until end of file, doubling the buffer as we go.  The
+ *		descriptor is not closed.  Return false on failure, with
+ *		errno set.
+ */
+
+bool Source::open(int fd)
+{
+    struct stat st;
+    size_t capacity;
+    ssize_t n;
+    void *p;
+
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+	p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if (p != MAP_FAILED) {
+	    madvise(p, st.st_size, MADV_SEQUENTIAL);
+	    _data = (char *) p;
+	    _size = st.st_size;
+	    _mapped = true;
+	    return true;
+	}
+    }
+
+    capacity = 1 << 16;
+
+    if ((_data = (char *) malloc(capacity)) == nullptr)
+	return false;
+
+    while ((n = read(fd, _data + _size, capacity - _size)) != 0) {
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+
+	    return false;
+	}
+
+	_size += n;
+
+	if (_size == capacity) {
+	    if ((p = realloc(_data, capacity * 2)) == nullptr)
+		return false;
+
+	    _data = (char *) p;
+	    capacity *= 2;
+	}
+    }
+
+    return true;
+}
+
+
+/*
+ * Function:	Source::begin (accessor)
+ *
+ * Description:	Return a pointer to the first character of the source.
+ */
+
+const char *Source::begin() const
+{
+    return _data;
+}
+
+
+/*
+ * Function:	Source::end (accessor)
+ *
+ * Description:	Return a pointer just past the last character.
+ */
+
+const char *Source::end() const
+{
+    return _data + _size;
+}
+
+
+/*
+ * Function:	Source::size (accessor)
+ *
+ * Description:	Return the number of characters in the source.
+ */
+
+size_t Source::size() const
+{
+    return _size;
+}
@@ -0,0 +1,41 @@
+/*
+ * File:	source.h
+ *
+ * Description:	This file contains the class definition for the source
+ *		input of Simple C.  The entire translation unit is made
+ *		available as one contiguous buffer, so the lexer can hand
+ *		out lexemes that point directly into it.
+ *
+ *		A regular file is mapped into memory.  Anything else, such
+ *		as a pipe on the standard input, is read in bulk instead.
+ *		Either way, the buffer lives as long as the source object,
+ *		so it must outlive every lexeme taken from it.
+ */
+
+# ifndef SOURCE_H
+# define SOURCE_H
+# include <string>
+
+class Source {
+    typedef std::string string;
+
+    char *_data;
+    size_t _size;
+    bool _mapped;
+
+    Source(const Source &);
+    Source &operator =(const Source &);
+
+public:
+    Source();
+    ~Source();
+
+    bool open(const string &path);
+    bool open(int fd);
+
+    const char *begin() const;
+    const char *end() const;
+    size_t size() const;
+};
+
+# endif /* SOURCE_H */
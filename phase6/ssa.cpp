@@ -0,0 +1,424 @@
+/*
+ * File:	ssa.cpp
+ *
+ * Description:	This file contains the functions for building and editing
+ *		the intermediate representation of a function in static
+ *		single assignment form, which are shared by the lowering
+ *		from the tree, the optimizer, and the instruction selector.
+ *
+ *		Removing values and vertices only marks them, since the
+ *		passes are still walking the lists they are in.  Compacting
+ *		the graph afterward drops them from the lists.
+ */
+
+# include <cassert>
+# include <algorithm>
+# include "ssa.h"
+
+using namespace std;
+
+static const char *names[] = {
+    "const", "address", "undef", "copy", "phi",
+    "load", "store", "call",
+    "add", "sub", "mul", "div", "rem", "neg", "extend",
+    "eq", "ne", "lt", "gt", "le", "ge",
+    "jump", "branch", "return",
+};
+
+
+/*
+ * Function:	isPure
+ *
+ * Description:	Return whether an operation has no effect other than
+ *		computing its value, so that it may be removed if unused or
+ *		reused if computed again.  A division might trap, but only
+ *		if the program is in error.
+ */
+
+bool isPure(Op op)
+{
+    return op != OP_PHI && op != OP_LOAD && op != OP_STORE && op != OP_CALL && !isTerminator(op);
+}
+
+
+/*
+ * Function:	isCompare
+ *
+ * Description:	Return whether an operation is a comparison.
+ */
+
+bool isCompare(Op op)
+{
+    return op >= OP_EQ && op <= OP_GE;
+}
+
+
+/*
+ * Function:	isCommutative
+ *
+ * Description:	Return whether the operands of an operation can be swapped.
+ */
+
+bool isCommutative(Op op)
+{
+    return op == OP_ADD || op == OP_MUL || op == OP_EQ || op == OP_NE;
+}
+
+
+/*
+ * Function:	isTerminator
+ *
+ * Description:	Return whether an operation ends a vertex.
+ */
+
+bool isTerminator(Op op)
+{
+    return op >= OP_JUMP;
+}
+
+
+/*
+ * Function:	addValue
+ *
+ * Description:	Add an instruction to the end of a vertex and return the
+ *		number of the value it defines.
+ */
+
+int addValue(Graph &graph, int vertex, Op op, const vector<int> &args)
+{
+    int n = graph.values.size();
+
+
+    graph.values.push_back({op, 0, vertex, 0, Operand(), args});
+    graph.vertices[vertex].values.push_back(n);
+    return n;
+}
+
+
+/*
+ * Function:	addPhi
+ *
+ * Description:	Add a phi without any operands to a vertex and return the
+ *		number of its value.
+ */
+
+int addPhi(Graph &graph, int vertex)
+{
+    int n = graph.values.size();
+
+
+    graph.values.push_back({OP_PHI, 0, vertex, 0, Operand(), {}});
+    graph.vertices[vertex].phis.push_back(n);
+    return n;
+}
+
+
+/*
+ * Function:	addVertex
+ *
+ * Description:	Add an empty vertex to a graph and return its number.  It
+ *		is not laid out until it is entered.
+ */
+
+int addVertex(Graph &graph)
+{
+    graph.vertices.push_back(Vertex());
+    graph.vertices.back().aligned = false;
+    graph.vertices.back().removed = false;
+    return graph.vertices.size() - 1;
+}
+
+
+/*
+ * Function:	addEdge
+ *
+ * Description:	Add an edge between two vertices.  Any phis in the target
+ *		must be given their operand for it separately.
+ */
+
+void addEdge(Graph &graph, int from, int to)
+{
+    graph.vertices[from].succs.push_back(to);
+    graph.vertices[to].preds.push_back(from);
+}
+
+
+/*
+ * Function:	removeEdge
+ *
+ * Description:	Remove an edge between two vertices, along with the
+ *		operands of the phis in the target for it.
+ */
+
+void removeEdge(Graph &graph, int from, int to)
+{
+    Vertex &source = graph.vertices[from], &target = graph.vertices[to];
+    unsigned i;
+
+
+    i = find(target.preds.begin(), target.preds.end(), from) - target.preds.begin();
+    assert(i < target.preds.size());
+    target.preds.erase(target.preds.begin() + i);
+
+    for (auto phi : target.phis)
+	if (graph.values[phi].vertex >= 0)
+	    graph.values[phi].args.erase(graph.values[phi].args.begin() + i);
+
+    source.succs.erase(find(source.succs.begin(), source.succs.end(), to));
+}
+
+
+/*
+ * Function:	removeValue
+ *
+ * Description:	Mark a value as removed.
+ */
+
+void removeValue(Graph &graph, int value)
+{
+    graph.values[value].vertex = -1;
+    graph.values[value].args.clear();
+}
+
+
+/*
+ * Function:	removeVertex
+ *
+ * Description:	Remove a vertex that cannot be reached, along with its
+ *		values and the edges leaving it.
+ */
+
+void removeVertex(Graph &graph, int vertex)
+{
+    Vertex &v = graph.vertices[vertex];
+
+
+    while (!v.succs.empty())
+	removeEdge(graph, vertex, v.succs.back());
+
+    for (auto phi : v.phis)
+	removeValue(graph, phi);
+
+    for (auto value : v.values)
+	removeValue(graph, value);
+
+    v.removed = true;
+}
+
+
+/*
+ * Function:	removeUnreachable
+ *
+ * Description:	Remove the vertices that cannot be reached from the entry.
+ */
+
+void removeUnreachable(Graph &graph)
+{
+    vector<char> reached(graph.vertices.size(), 0);
+    vector<int> pending = {0};
+    int v;
+
+
+    reached[0] = true;
+
+    while (!pending.empty()) {
+	v = pending.back();
+	pending.pop_back();
+
+	for (auto s : graph.vertices[v].succs)
+	    if (!reached[s]) {
+		reached[s] = true;
+		pending.push_back(s);
+	    }
+    }
+
+    for (v = 0; v < (int) graph.vertices.size(); v ++)
+	if (!reached[v] && !graph.vertices[v].removed)
+	    removeVertex(graph, v);
+
+    compact(graph);
+}
+
+
+/*
+ * Function:	compact
+ *
+ * Description:	Drop the values and vertices that have been removed from
+ *		the lists that hold them.
+ */
+
+void compact(Graph &graph)
+{
+    auto removed = [&](int value) {
+	return graph.values[value].vertex < 0;
+    };
+
+    for (auto &v : graph.vertices) {
+	v.phis.erase(remove_if(v.phis.begin(), v.phis.end(), removed), v.phis.end());
+	v.values.erase(remove_if(v.values.begin(), v.values.end(), removed), v.values.end());
+    }
+
+    graph.order.erase(remove_if(graph.order.begin(), graph.order.end(), [&](int v) {
+	return graph.vertices[v].removed;
+    }), graph.order.end());
+}
+
+
+/*
+ * Function:	dominators
+ *
+ * Description:	Compute the immediate dominator of every vertex that can be
+ *		reached from the entry, along with a reverse postorder of
+ *		those vertices, using the iterative algorithm of Cooper,
+ *		Harvey, and Kennedy.  The entry is its own dominator, and
+ *		a vertex that cannot be reached has none.
+ */
+
+void dominators(const Graph &graph, vector<int> &idom, vector<int> &rpo)
+{
+    vector<int> number(graph.vertices.size(), -1);
+    vector<pair<int, unsigned>> stack;
+    unsigned i;
+    bool changed;
+    int v, a, b;
+
+
+    rpo.clear();
+    stack.push_back({0, 0});
+    number[0] = 0;
+
+    while (!stack.empty()) {
+	v = stack.back().first;
+	i = stack.back().second ++;
+
+	if (i < graph.vertices[v].succs.size()) {
+	    int s = graph.vertices[v].succs[i];
+
+	    if (number[s] < 0) {
+		number[s] = 0;
+		stack.push_back({s, 0});
+	    }
+	} else {
+	    rpo.push_back(v);
+	    stack.pop_back();
+	}
+    }
+
+    reverse(rpo.begin(), rpo.end());
+
+    for (i = 0; i < rpo.size(); i ++)
+	number[rpo[i]] = i;
+
+    idom.assign(graph.vertices.size(), -1);
+    idom[0] = 0;
+
+    do {
+	changed = false;
+
+	for (i = 1; i < rpo.size(); i ++) {
+	    int next = -1;
+
+	    for (auto p : graph.vertices[rpo[i]].preds) {
+		if (idom[p] < 0)
+		    continue;
+
+		if (next < 0) {
+		    next = p;
+		    continue;
+		}
+
+		for (a = p, b = next; a != b; )
+		    if (number[a] > number[b])
+			a = idom[a];
+		    else
+			b = idom[b];
+
+		next = a;
+	    }
+
+	    if (idom[rpo[i]] != next) {
+		idom[rpo[i]] = next;
+		changed = true;
+	    }
+	}
+    } while (changed);
+}
+
+
+/*
+ * Function:	write (private)
+ *
+ * Description:	Write a value to a stream.
+ */
+
+static void write(ostream &ostr, const Graph &graph, int value)
+{
+    const Value &v = graph.values[value];
+
+
+    ostr << "\t";
+
+    if (v.op != OP_STORE && !isTerminator(v.op))
+	ostr << "v" << value << " = ";
+
+    ostr << names[v.op];
+
+    if (v.op == OP_LOAD || v.op == OP_STORE)
+	ostr << (v.size == 1 ? "b" : "l");
+
+    if (v.op == OP_CONST)
+	ostr << " " << v.constant;
+
+    else if (v.op == OP_ADDRESS)
+	ostr << " " << v.object << (v.constant != 0 ? "+" : "") << v.constant;
+
+    else if (v.op == OP_CALL && v.object.kind != Operand::NONE)
+	ostr << " " << v.object.symbol;
+
+    for (unsigned i = 0; i < v.args.size(); i ++)
+	ostr << (i > 0 || v.op == OP_CALL ? ", " : " ") << "v" << v.args[i];
+
+    ostr << endl;
+}
+
+
+/*
+ * Function:	operator <<
+ *
+ * Description:	Write a graph to a stream in the order laid out.
+ */
+
+ostream &operator <<(ostream &ostr, const Graph &graph)
+{
+    for (auto v : graph.order) {
+	const Vertex &vertex = graph.vertices[v];
+
+	ostr << "b" << v << ":";
+
+	if (!vertex.preds.empty()) {
+	    ostr << "\t\t# from";
+
+	    for (auto p : vertex.preds)
+		ostr << " b" << p;
+	}
+
+	ostr << endl;
+
+	for (auto phi : vertex.phis)
+	    write(ostr, graph, phi);
+
+	for (auto value : vertex.values)
+	    write(ostr, graph, value);
+
+	if (!vertex.succs.empty()) {
+	    ostr << "\t\t# to";
+
+	    for (auto s : vertex.succs)
+		ostr << " b" << s;
+
+	    ostr << endl;
+	}
+    }
+
+    return ostr;
+}
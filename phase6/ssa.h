@@ -0,0 +1,82 @@
+/*
+ * File:	ssa.h
+ *
+ * Description:	This file contains the definitions for the mid-level
+ *		intermediate representation of Simple C, which is in static
+ *		single assignment form.  Each function is a graph of
+ *		vertices, which are basic blocks, and each value is defined
+ *		by exactly one instruction within a vertex.  The operands of
+ *		an instruction are the numbers of the values it uses, and a
+ *		phi has one operand for each predecessor of its vertex, in
+ *		the same order.
+ *
+ *		Every value is a 32-bit integer.  A character loaded from
+ *		memory is zero-extended, and only its low byte matters until
+ *		it is sign-extended to an integer.  The address of a
+ *		variable in memory, a string, or a function is the memory
+ *		operand for it plus a displacement.  A call names the
+ *		function it calls, or else its first operand is the address
+ *		of the function, and the rest are the arguments.
+ *
+ *		A value that has been removed by an optimization is left in
+ *		place with no vertex, so that the numbers of the others
+ *		remain the same.
+ */
+
+# ifndef SSA_H
+# define SSA_H
+# include <vector>
+# include <ostream>
+# include "assembly.h"
+
+enum Op : unsigned char {
+    OP_CONST, OP_ADDRESS, OP_UNDEF, OP_COPY, OP_PHI,
+    OP_LOAD, OP_STORE, OP_CALL,
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_REM, OP_NEG, OP_EXTEND,
+    OP_EQ, OP_NE, OP_LT, OP_GT, OP_LE, OP_GE,
+    OP_JUMP, OP_BRANCH, OP_RETURN,
+};
+
+struct Value {
+    Op op;
+    unsigned char size;			/* size of a load or store */
+    int vertex;				/* defining vertex, or -1 if removed */
+    int constant;			/* constant, or displacement of address */
+    Operand object;			/* object addressed, or function called */
+    std::vector<int> args;		/* values used */
+};
+
+struct Vertex {
+    bool aligned;			/* vertex starts a loop */
+    bool removed;			/* vertex cannot be reached */
+    std::vector<int> phis, values;	/* values defined, terminator last */
+    std::vector<int> preds, succs;	/* edges of the control-flow graph */
+};
+
+struct Graph {
+    std::vector<Value> values;
+    std::vector<Vertex> vertices;
+    std::vector<int> order;		/* vertices in the order laid out */
+};
+
+bool isPure(Op op);
+bool isCompare(Op op);
+bool isCommutative(Op op);
+bool isTerminator(Op op);
+
+int addValue(Graph &graph, int vertex, Op op, const std::vector<int> &args = {});
+int addPhi(Graph &graph, int vertex);
+int addVertex(Graph &graph);
+
+void addEdge(Graph &graph, int from, int to);
+void removeEdge(Graph &graph, int from, int to);
+void removeValue(Graph &graph, int value);
+void removeVertex(Graph &graph, int vertex);
+void removeUnreachable(Graph &graph);
+void compact(Graph &graph);
+
+void dominators(const Graph &graph, std::vector<int> &idom, std::vector<int> &rpo);
+
+std::ostream &operator <<(std::ostream &ostr, const Graph &graph);
+
+# endif /* SSA_H */
@@ -5,12 +5,29 @@
  *		escaping C-style escape sequences in strings.
  */
 
+# include <cctype>
+# include <cstdio>
 # include <climits>
 # include "string.h"
+# include "scan.h"
 
 using namespace std;
 
 
+/*
+ * Function:	at (private)
+ *
+ * Description:	Return the character at the given index, or a null
+ *		character if we have run off the end.  Unlike a string, a
+ *		view has no terminating null character we can rely on.
+ */
+
+static inline char at(string_view s, unsigned i)
+{
+    return i < s.size() ? s[i] : '\0';
+}
+
+
 /*
  * Function:	parseString
  *
@@ -19,7 +36,7 @@ using namespace std;
  *		an octal or hexadecimal escape sequence.
  */
 
-string parseString(const string &s, bool &invalid, bool &overflow)
+string parseString(string_view s, bool &invalid, bool &overflow)
 {
     unsigned start, val;
     string result;
@@ -32,7 +49,7 @@ string parseString(const string &s, bool &invalid, bool &overflow)
 	if (s[i] == '\\') {
 	    i ++;
 
-	    switch(s[i]) {
+	    switch(at(s, i)) {
 	    case 'a':
 		result += '\a';
 		break;
@@ -73,11 +90,11 @@ string parseString(const string &s, bool &invalid, bool &overflow)
 		start = i;
 
 		while (1) {
-		    if (s[i + 1] >= '0' && s[i + 1] <= '9')
+		    if (at(s, i + 1) >= '0' && at(s, i + 1) <= '9')
 			val = val * 16 + (s[++ i] - '0');
-		    else if (s[i + 1] >= 'a' && s[i + 1] <= 'f')
+		    else if (at(s, i + 1) >= 'a' && at(s, i + 1) <= 'f')
 			val = val * 16 + (s[++ i] - 'a' + 10);
-		    else if (s[i + 1] >= 'A' && s[i + 1] <= 'F')
+		    else if (at(s, i + 1) >= 'A' && at(s, i + 1) <= 'F')
 			val = val * 16 + (s[++ i] - 'A' + 10);
 		    else
 			break;
@@ -96,10 +113,10 @@ string parseString(const string &s, bool &invalid, bool &overflow)
 	    case '4': case '5': case '6': case '7':
 		val = s[i] - '0';
 
-		if (s[i + 1] >= '0' && s[i + 1] <= '7')
+		if (at(s, i + 1) >= '0' && at(s, i + 1) <= '7')
 		    val = val * 8 + (s[++ i] - '0');
 
-		if (s[i + 1] >= '0' && s[i + 1] <= '7')
+		if (at(s, i + 1) >= '0' && at(s, i + 1) <= '7')
 		    val = val * 8 + (s[++ i] - '0');
 
 		if (val > UCHAR_MAX)
@@ -110,12 +127,15 @@ string parseString(const string &s, bool &invalid, bool &overflow)
 
 	    default:
 		invalid = true;
-		result += s[i];
+		result += at(s, i);
 		break;
 	    }
 
-	} else
-	    result += s[i];
+	} else {
+	    const char *next = findBackslash(&s[i], s.data() + s.size());
+	    result.append(&s[i], next);
+	    i = next - s.data() - 1;
+	}
     }
 
     return result;
@@ -129,7 +149,7 @@ string parseString(const string &s, bool &invalid, bool &overflow)
  *		invalid escape sequence is silently ignored.
  */
 
-string parseString(const string &s)
+string parseString(string_view s)
 {
     bool invalid, overflow;
     return parseString(s, invalid, overflow);
@@ -140,7 +160,10 @@ string parseString(const string &s)
  * Function:	escapeString
  *
  * Description:	Return a copy of the given string but with any unprintable
- *		character replaced with an octal escape sequence.
+ *		character replaced with an octal escape sequence, and with
+ *		any quote or backslash escaped, so that the result may be
+ *		written between quotes both in C and in an assembler
+ *		directive.
  */
 
 string escapeString(const string &s)
@@ -149,12 +172,15 @@ string escapeString(const string &s)
     string result;
 
 
-    for (unsigned i = 0; i < s.size(); i ++)
-	if (!isprint(s[i])) {
-	    sprintf(buf, "\\%03o", (unsigned char) s[i]);
+    for (unsigned char c : s)
+	if (!isprint(c)) {
+	    sprintf(buf, "\\%03o", c);
 	    result += buf;
+	} else if (c == '"' || c == '\\') {
+	    result += '\\';
+	    result += c;
 	} else
-	    result += s[i];
+	    result += c;
 
     return result;
 }
@@ -8,9 +8,10 @@
 # ifndef STRING_H
 # define STRING_H
 # include <string>
+# include <string_view>
 
-std::string parseString(const std::string &s);
-std::string parseString(const std::string &s, bool &invalid, bool &overflow);
+std::string parseString(std::string_view s);
+std::string parseString(std::string_view s, bool &invalid, bool &overflow);
 std::string escapeString(const std::string &s);
 
 # endif /* STRING_H */
@@ -0,0 +1,128 @@
+/*
+ * Loads, stores, and addresses of array elements and structure fields,
+ * which are folded into memory operands of the form disp(base,index,scale)
+ * and into lea, for globals, locals, parameters, and pointers.
+ */
+
+int printf();
+
+struct inner { char c; int v[4]; };
+struct outer { int a; struct inner in; int b[3]; char s[5]; };
+
+int g[16];
+char text[16];
+struct outer go;
+struct inner table[6];
+
+int sum(int *p, int n)
+{
+    int i, s;
+
+    s = 0;
+
+    for (i = 0; i < n; i = i + 1)
+	s = s + p[i];
+
+    return s;
+}
+
+int fill(struct outer *p, int k)
+{
+    int i;
+
+    p->a = k;
+    p->in.c = 'a' + k;
+
+    for (i = 0; i < 4; i = i + 1)
+	p->in.v[i] = k * 10 + i;
+
+    for (i = 0; i < 3; i = i + 1)
+	p->b[2 - i] = k - i;
+
+    for (i = 0; i < 4; i = i + 1)
+	p->s[i] = 'w' + i;
+
+    p->s[4] = 0;
+}
+
+int show(struct outer *p)
+{
+    printf("%d %c %d %d %d %d ", p->a, p->in.c, p->in.v[0], p->in.v[1], p->in.v[2], p->in.v[3]);
+    printf("%d %d %d %s\n", p->b[0], p->b[1], p->b[2], p->s);
+}
+
+int main(void)
+{
+    int a[12], i, j, k, *p, *q;
+    char c[8], *s;
+    struct outer lo;
+    struct inner *t;
+
+    for (i = 0; i < 16; i = i + 1)
+	g[i] = i * i - 7;
+
+    for (i = 0; i < 12; i = i + 1)
+	a[i] = g[i + 2] * 3 + g[15 - i];
+
+    printf("%d %d %d\n", sum(g, 16), sum(a, 12), sum(&a[4], 5));
+
+    for (i = 0; i < 12; i = i + 1)
+	printf("%d ", a[i]);
+
+    printf("\n");
+
+    j = 3;
+    k = 2;
+    a[j * 2 + 1] = 100;
+    a[j + k] = a[j - k] + a[j * k];
+    g[j * 4 - 1] = a[11 - j];
+    printf("%d %d %d %d\n", a[7], a[5], g[11], a[j + k - 1]);
+
+    p = &a[3];
+    q = &g[j];
+    printf("%d %d %d %d %d\n", *p, p[2], *(p + 4), p[-1], q[k]);
+
+    p[1] = 55;
+    *(q + 5) = 66;
+    printf("%d %d %d\n", a[4], g[8], p - a);
+
+    for (i = 0; i < 7; i = i + 1)
+	c[i] = 'A' + i * 2;
+
+    c[7] = 0;
+    text[0] = c[j];
+    text[1] = c[j + k];
+    text[2] = c[6 - j];
+    text[3] = 0;
+    s = &c[k];
+    printf("%s %s %c %c %d\n", c, text, s[1], *(s + 3), c[j] + c[k]);
+
+    fill(&go, 4);
+    fill(&lo, 7);
+    show(&go);
+    show(&lo);
+
+    lo.in.v[j] = go.b[k] + lo.b[k - 1];
+    go.s[j] = lo.in.c;
+    p = &lo.in.v[1];
+    printf("%d %s %d %d\n", lo.in.v[3], go.s, p[1], *p);
+
+    for (i = 0; i < 6; i = i + 1) {
+	table[i].c = 'p' + i;
+
+	for (j = 0; j < 4; j = j + 1)
+	    table[i].v[j] = i * 100 + j;
+    }
+
+    t = &table[2];
+    printf("%c %d %d %d\n", table[4].c, table[3].v[2], t->v[3], t[1].v[1]);
+
+    k = 0;
+
+    for (i = 0; i < 6; i = i + 1)
+	for (j = 0; j < 4; j = j + 1)
+	    k = k + table[i].v[j] * (j + 1);
+
+    printf("%d %d\n", k, &table[5].v[2] - &table[1].v[0]);
+    return 0;
+}
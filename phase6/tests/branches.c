@@ -0,0 +1,111 @@
+/*
+ * Conditions of if, while, and for statements, which branch directly on
+ * each relational, equality, and logical operator, checked against the
+ * values of the same conditions, including the order in which && and ||
+ * evaluate their operands and which of them they skip.
+ */
+
+int printf();
+
+int trace;
+
+int t(int id, int value)
+{
+    trace = trace * 10 + id;
+    return value;
+}
+
+int compare(int a, int b)
+{
+    int n;
+
+    n = 0;
+
+    if (a < b) n = n + 1;
+    if (a > b) n = n + 2;
+    if (a <= b) n = n + 4;
+    if (a >= b) n = n + 8;
+    if (a == b) n = n + 16;
+    if (a != b) n = n + 32;
+    if (!(a < b)) n = n + 64;
+    if (!(a == b)) n = n + 128;
+    if (!a) n = n + 256;
+    if (a) n = n + 512;
+
+    printf("%d %d: %d %d", a, b, n, (a < b) + (a > b) * 2 + (a <= b) * 4);
+    printf(" %d %d %d\n", (a >= b) * 8 + (a == b) * 16, (a != b) * 32, !a);
+}
+
+int logical(int a, int b, int c)
+{
+    int n;
+
+    n = 0;
+
+    trace = 0;
+    if (t(1, a) && t(2, b)) n = n + 1;
+    printf("%d ", trace);
+
+    trace = 0;
+    if (t(1, a) || t(2, b)) n = n + 2;
+    printf("%d ", trace);
+
+    trace = 0;
+    if (t(1, a) && t(2, b) || t(3, c)) n = n + 4;
+    printf("%d ", trace);
+
+    trace = 0;
+    if (t(1, a) || t(2, b) && t(3, c)) n = n + 8;
+    printf("%d ", trace);
+
+    trace = 0;
+    if (!(t(1, a) && !t(2, b)) && (t(3, c) || !t(4, a))) n = n + 16;
+    printf("%d ", trace);
+
+    trace = 0;
+    if (!!t(1, a) == !t(2, b)) n = n + 32;
+    printf("%d ", trace);
+
+    printf("%d %d %d\n", n, a && b || c, !(a || b) && c);
+}
+
+int main(void)
+{
+    int i, j, n, values[5];
+
+    values[0] = -2147483647 - 1;
+    values[1] = -1;
+    values[2] = 0;
+    values[3] = 1;
+    values[4] = 2147483647;
+
+    for (i = 0; i < 5; i = i + 1)
+	for (j = 0; j < 5; j = j + 1)
+	    compare(values[i], values[j]);
+
+    for (i = 0; i < 8; i = i + 1)
+	logical(i / 4 % 2, i / 2 % 2, i % 2);
+
+    n = 0;
+    i = 10;
+
+    while (i > 0 && i != 3) {
+	n = n + i;
+	i = i - 1;
+    }
+
+    for (j = 0; j <= 20 || j == 25; j = j + 5)
+	n = n * 2 + j;
+
+    i = 0;
+
+    while (!(i >= 6)) {
+	if (i % 2 == 0 || i == 5)
+	    n = n + 1;
+
+	i = i + 1;
+    }
+
+    printf("%d %d %d\n", n, i, j);
+    return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * Multiplication, division, and remainder by constants, which are lowered
+ * to shifts, lea, and multiplies by magic numbers, checked against the
+ * same operations by variables, which always use imull and idivl.
+ */
+
+int printf();
+
+int values[24], count;
+
+int add(int x)
+{
+    values[count] = x;
+    count = count + 1;
+}
+
+int check(int x, int d, int q, int r)
+{
+    if (q != x / d || r != x % d)
+	printf("%d / %d: %d %d, not %d %d\n", x, d, q, r, x / d, x % d);
+
+    printf("%d %d %d %d\n", x, d, q, r);
+}
+
+int product(int x, int m, int p)
+{
+    if (p != x * m)
+	printf("%d * %d: %d, not %d\n", x, m, p, x * m);
+
+    printf("%d %d %d\n", x, m, p);
+}
+
+int divide(int x)
+{
+    check(x, 1, x / 1, x % 1);
+    check(x, 2, x / 2, x % 2);
+    check(x, 3, x / 3, x % 3);
+    check(x, 4, x / 4, x % 4);
+    check(x, 5, x / 5, x % 5);
+    check(x, 6, x / 6, x % 6);
+    check(x, 7, x / 7, x % 7);
+    check(x, 8, x / 8, x % 8);
+    check(x, 9, x / 9, x % 9);
+    check(x, 10, x / 10, x % 10);
+    check(x, 11, x / 11, x % 11);
+    check(x, 12, x / 12, x % 12);
+    check(x, 13, x / 13, x % 13);
+    check(x, 16, x / 16, x % 16);
+    check(x, 25, x / 25, x % 25);
+    check(x, 31, x / 31, x % 31);
+    check(x, 100, x / 100, x % 100);
+    check(x, 125, x / 125, x % 125);
+    check(x, 641, x / 641, x % 641);
+    check(x, 1000, x / 1000, x % 1000);
+    check(x, 1024, x / 1024, x % 1024);
+    check(x, 65536, x / 65536, x % 65536);
+    check(x, 1000000007, x / 1000000007, x % 1000000007);
+    check(x, 1073741824, x / 1073741824, x % 1073741824);
+    check(x, 2147483647, x / 2147483647, x % 2147483647);
+
+    check(x, -2, x / -2, x % -2);
+    check(x, -3, x / -3, x % -3);
+    check(x, -7, x / -7, x % -7);
+    check(x, -8, x / -8, x % -8);
+    check(x, -1000, x / -1000, x % -1000);
+    check(x, -65536, x / -65536, x % -65536);
+}
+
+int multiply(int x)
+{
+    product(x, 0, x * 0);
+    product(x, 1, x * 1);
+    product(x, 2, x * 2);
+    product(x, 3, x * 3);
+    product(x, 5, x * 5);
+    product(x, 6, x * 6);
+    product(x, 7, x * 7);
+    product(x, 9, x * 9);
+    product(x, 10, x * 10);
+    product(x, 12, x * 12);
+    product(x, 15, x * 15);
+    product(x, 24, x * 24);
+    product(x, 25, x * 25);
+    product(x, 45, x * 45);
+    product(x, 81, x * 81);
+    product(x, 100, x * 100);
+    product(x, 1000, x * 1000);
+    product(x, -1, x * -1);
+    product(x, -3, x * -3);
+    product(x, -8, x * -8);
+}
+
+int main(void)
+{
+    int i;
+
+    add(0);
+    add(1);
+    add(-1);
+    add(7);
+    add(-7);
+    add(8);
+    add(-8);
+    add(99);
+    add(-101);
+    add(65535);
+    add(-65536);
+    add(123456789);
+    add(-123456789);
+    add(1073741823);
+    add(-1073741824);
+    add(2147483647);
+    add(-2147483647);
+    add(-2147483647 - 1);
+
+    for (i = 0; i < count; i = i + 1)
+	divide(values[i]);
+
+    for (i = 0; i < count; i = i + 1)
+	if (values[i] < 1000000 && values[i] > -1000000)
+	    multiply(values[i]);
+
+    return 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * Expressions the checker folds or simplifies as it builds them, checked
+ * against the same expressions on variables, including overflow, which
+ * wraps at 32 bits, and identities whose operands have side effects.
+ */
+
+int printf();
+
+int calls;
+
+int f(int x)
+{
+    calls = calls + 1;
+    return x;
+}
+
+int main(void)
+{
+    int x, y, zero, one, big;
+
+    x = 37;
+    y = -5;
+    zero = 0;
+    one = 1;
+    big = 2147483647;
+
+    printf("%d %d %d %d\n", 3 + 4 * 5, (3 + 4) * 5, 100 / 7, 100 % 7);
+    printf("%d %d %d %d\n", -17 / 4, -17 % 4, 17 / -4, 17 % -4);
+    printf("%d %d %d\n", 2147483647 + 1, -2147483647 - 2, 65536 * 65536);
+    printf("%d %d %d\n", big + one, -big - 2, 65536 * (65536 + zero));
+    printf("%d %d %d\n", 46341 * 46341, -(-2147483647 - 1), (-2147483647 - 1) / 2);
+    printf("%d %d %d %d\n", 3 < 4, 4 < 3, 3 <= 3, 4 >= 5);
+    printf("%d %d %d %d\n", 3 == 3, 3 != 3, -1 < 0, -1 > 2147483647);
+    printf("%d %d %d %d\n", !0, !7, !!7, !!0);
+    printf("%d %d %d %d\n", 1 && 2, 1 && 0, 0 || 0, 0 || 3);
+    printf("%d %d %d\n", -(5), -(-5), -(3 - 8));
+
+    printf("%d %d %d %d\n", x * 1, 1 * x, x + 0, 0 + x);
+    printf("%d %d %d %d\n", x - 0, 0 - x, x / 1, x % 1);
+    printf("%d %d %d %d\n", x * 0, 0 * x, !!x, !!zero);
+    printf("%d %d %d\n", -(-x), x - x, x * -1);
+    printf("%d %d %d %d\n", x + 2 + 3, 2 + x + 3, x * 2 * 3, y * 4 + 8);
+
+    calls = 0;
+    printf("%d %d %d\n", f(x) * 0, 0 * f(y), f(x) * 1 + f(y) * 0);
+    printf("%d\n", calls);
+
+    calls = 0;
+    printf("%d %d %d\n", f(x) + 0, !!f(zero), 0 && f(x));
+    printf("%d %d\n", 1 || f(x), f(1) && f(2));
+    printf("%d\n", calls);
+
+    if (3 > 2)
+	printf("taken\n");
+
+    if (2 > 3)
+	printf("not taken\n");
+
+    while (0)
+	printf("never\n");
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * While and for loops, which are rotated to put the test at the bottom, run
+ * zero, one, and many times, with conditions that have side effects, so
+ * that the test must be evaluated exactly once on entry whether the loop
+ * jumps to it or, with -d, is guarded by a copy of it, and with conditions
+ * both small enough to copy and too large.
+ */
+
+int printf();
+
+int tests;
+
+int below(int i, int n)
+{
+    tests = tests + 1;
+    return i < n;
+}
+
+int count(int n)
+{
+    int i, s;
+
+    s = 0;
+    i = 0;
+
+    while (i < n) {
+	s = s + i;
+	i = i + 1;
+    }
+
+    return s;
+}
+
+int main(void)
+{
+    int i, j, n, s;
+
+    printf("%d %d %d %d\n", count(-3), count(0), count(1), count(100));
+
+    for (n = 0; n < 4; n = n + 1) {
+	tests = 0;
+	s = 0;
+
+	for (i = 0; below(i, n); i = i + 1)
+	    s = s + 10;
+
+	printf("%d %d %d ", n, s, tests);
+
+	tests = 0;
+	i = n;
+
+	while (below(0, i))
+	    i = i - 1;
+
+	printf("%d %d\n", i, tests);
+    }
+
+    s = 0;
+
+    for (i = 0; i < 10; i = i + 1)
+	for (j = i; j < 10; j = j + 3)
+	    s = s * 3 + i - j;
+
+    printf("%d\n", s);
+
+    s = 0;
+    i = 0;
+
+    while (i < 5) {
+	j = 0;
+
+	while (j < i && j != 3)
+	    j = j + 1;
+
+	s = s + j;
+	i = i + 1;
+    }
+
+    n = 0;
+
+    for (i = 0; i < 20 && (i != 3 || s > 0) && i * 2 - s != 17; i = i + 1)
+	n = n + i;
+
+    printf("%d %d\n", n, i);
+
+    for (i = 100; i < 0; i = i + 1)
+	s = 0;
+
+    while (0)
+	s = 0;
+
+    printf("%d %d\n", s, i);
+    return 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * Loops whose variables are carried around the back edge in swapped or
+ * rotated order, or whose old value is still wanted after the loop exits,
+ * so that the copies for the phis at the loop header must neither clobber
+ * each other nor a value that the exit still reads.
+ */
+
+int printf();
+
+int fibonacci(int n)
+{
+    int a, b, t, i;
+
+    a = 0;
+    b = 1;
+
+    for (i = 0; i < n; i = i + 1) {
+	t = a + b;
+	a = b;
+	b = t;
+    }
+
+    return a;
+}
+
+int swap(int n)
+{
+    int a, b, t, i;
+
+    a = 1;
+    b = 2;
+
+    for (i = 0; i < n; i = i + 1) {
+	t = a;
+	a = b;
+	b = t;
+    }
+
+    return a * 10 + b;
+}
+
+int rotate(int n)
+{
+    int a, b, c, t, i;
+
+    a = 1;
+    b = 2;
+    c = 3;
+    i = 0;
+
+    while (i < n) {
+	t = a;
+	a = b;
+	b = c;
+	c = t;
+	i = i + 1;
+    }
+
+    return a * 100 + b * 10 + c;
+}
+
+int lost(int n)
+{
+    int x, y, i;
+
+    x = 0;
+    y = 0;
+
+    for (i = 0; i < n; i = i + 1) {
+	y = x;
+	x = x + 1;
+    }
+
+    return y * 100 + x;
+}
+
+int main(void)
+{
+    int n;
+
+    for (n = 0; n < 12; n = n + 1)
+	printf("%d %d %d %d %d\n", n, fibonacci(n), swap(n), rotate(n), lost(n));
+
+    return 0;
+}
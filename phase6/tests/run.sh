@@ -0,0 +1,119 @@
+#!/bin/sh
+#
+# File:		run.sh
+#
+# Description:	Run the regression tests.  Each program in this directory
+#		is compiled with the given options, assembled, linked with
+#		the freestanding runtime, and run, and its output must match
+#		the expected output kept beside it.  The expected output
+#		was made by compiling the same programs with gcc -m32.
+#		Given no options, the tests are run at each optimization
+#		level in turn, and then through a compile server.
+#
+#		Given "--server", a server is started with the options that
+#		follow, and each program is compiled by a client instead,
+#		which must produce the same assembly as compiling it
+#		directly.  A syntax error must also fail through the server,
+#		and the client must refuse any options that tune the code.
+#
+#		usage: tests/run.sh [--server] [scc options ...]
+#
+
+if [ $# -eq 0 ]; then
+    status=0
+
+    for level in 0 1 2; do
+	"$0" -O$level || status=1
+    done
+
+    "$0" --server || status=1
+    exit $status
+fi
+
+dir=$(cd "$(dirname "$0")" && pwd)
+scc=${SCC:-$dir/../scc}
+cc=${CC:-gcc}
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' 0
+label="$*"
+socket=
+
+if [ "$1" = --server ]; then
+    shift
+    socket=$work/socket
+    "$scc" --server="$socket" "$@" &
+    server=$!
+    trap 'kill $server; rm -rf "$work"' 0
+
+    for i in 1 2 3 4 5 6 7 8 9 10; do
+	[ -S "$socket" ] && break
+	sleep 0.2
+    done
+fi
+
+compile() {
+    test=$1
+    name=$2
+    shift 2
+
+    if [ -z "$socket" ]; then
+	"$scc" "$@" < "$test" > "$work/$name.s"
+	return
+    fi
+
+    "$scc" --client="$socket" < "$test" > "$work/$name.s" &&
+	"$scc" "$@" < "$test" > "$work/$name.direct.s" || return
+
+    cmp -s "$work/$name.s" "$work/$name.direct.s" ||
+	{ echo "differs from compiling directly" >&2; return 1; }
+}
+
+$cc -m32 -O -ffreestanding -fno-builtin -fno-pic -fno-stack-protector \
+    -c "$dir/runtime.c" -o "$work/runtime.o" || exit 1
+
+passed=0
+failed=0
+
+for test in "$dir"/*.c; do
+    name=$(basename "$test" .c)
+    [ "$name" = runtime ] && continue
+
+    if compile "$test" "$name" "$@" 2> "$work/$name.err" &&
+	    as --32 "$work/$name.s" -o "$work/$name.o" 2>> "$work/$name.err" &&
+	    ld -m elf_i386 "$work/$name.o" "$work/runtime.o" \
+		-o "$work/$name" 2>> "$work/$name.err" &&
+	    timeout 10 "$work/$name" > "$work/$name.out" 2>> "$work/$name.err" &&
+	    cmp -s "$work/$name.out" "$dir/$name.out"; then
+	passed=$((passed + 1))
+    else
+	failed=$((failed + 1))
+	echo "FAILED: $name $label"
+	cat "$work/$name.err"
+	[ -f "$work/$name.out" ] && diff "$dir/$name.out" "$work/$name.out" | head -10
+    fi
+done
+
+if [ -n "$socket" ]; then
+    echo 'int f( {' > "$work/syntax.c"
+
+    "$scc" --client="$socket" < "$work/syntax.c" > /dev/null 2> "$work/syntax.err"
+
+    if [ $? -eq 1 ] && [ -s "$work/syntax.err" ]; then
+	passed=$((passed + 1))
+    else
+	failed=$((failed + 1))
+	echo "FAILED: syntax error through the server $label"
+    fi
+
+    "$scc" --client="$socket" -O2 < "$work/syntax.c" > /dev/null 2> "$work/tuned.err"
+
+    if [ $? -eq 1 ] && grep -q 'takes only' "$work/tuned.err"; then
+	passed=$((passed + 1))
+    else
+	failed=$((failed + 1))
+	echo "FAILED: client given tuning options $label"
+    fi
+fi
+
+echo "tests: $passed passed, $failed failed ${label:+($label)}"
+[ $failed -eq 0 ]
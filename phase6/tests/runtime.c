@@ -0,0 +1,141 @@
+/*
+ * File:	runtime.c
+ *
+ * Description:	This file contains a small freestanding runtime for the
+ *		regression tests, so that programs compiled for the i386 can
+ *		be linked and run without a 32-bit C library.  It provides
+ *		just what the tests use: printf with %d, %c, %s, and %%,
+ *		putchar, puts, malloc, and exit, with output buffered and
+ *		written using system calls.
+ */
+
+static char buffer[65536];
+static int length;
+
+
+static int syscall3(int number, int a, int b, int c)
+{
+    int result;
+
+
+    __asm__ volatile ("int $0x80" : "=a" (result)
+	: "a" (number), "b" (a), "c" (b), "d" (c) : "memory");
+
+    return result;
+}
+
+
+static void flush(void)
+{
+    syscall3(4, 1, (int) buffer, length);
+    length = 0;
+}
+
+
+static void output(int c)
+{
+    if (length == sizeof(buffer))
+	flush();
+
+    buffer[length ++] = c;
+}
+
+
+static void number(int value)
+{
+    unsigned magnitude = value < 0 ? -(unsigned) value : value;
+    char digits[12];
+    int i = 0;
+
+
+    if (value < 0)
+	output('-');
+
+    do {
+	digits[i ++] = '0' + magnitude % 10;
+	magnitude /= 10;
+    } while (magnitude != 0);
+
+    while (i > 0)
+	output(digits[-- i]);
+}
+
+
+int putchar(int c)
+{
+    output(c);
+    return c;
+}
+
+
+int puts(const char *s)
+{
+    while (*s != '\0')
+	output(*s ++);
+
+    output('\n');
+    return 0;
+}
+
+
+int printf(const char *format, ...)
+{
+    int *arg = (int *) &format + 1;
+    const char *s;
+
+
+    for (; *format != '\0'; format ++) {
+	if (*format != '%') {
+	    output(*format);
+	    continue;
+	}
+
+	switch (*++ format) {
+	case 'd':
+	    number(*arg ++);
+	    break;
+
+	case 'c':
+	    output(*arg ++);
+	    break;
+
+	case 's':
+	    for (s = (const char *) *arg ++; *s != '\0'; s ++)
+		output(*s);
+	    break;
+
+	default:
+	    output(*format);
+	    break;
+	}
+    }
+
+    return 0;
+}
+
+
+void *malloc(int size)
+{
+    static char heap[1 << 20];
+    static int used;
+    void *p = heap + used;
+
+
+    used += (size + 7) & ~7;
+    return p;
+}
+
+
+void exit(int status)
+{
+    flush();
+    syscall3(1, status, 0, 0);
+}
+
+
+int main(void);
+
+void _start(void)
+{
+    exit(main());
+}
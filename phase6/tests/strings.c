@@ -0,0 +1,45 @@
+/*
+ * String literals holding characters that must be escaped when they are
+ * written to the assembly file, and character constants.
+ */
+
+int printf();
+
+int length(char *p)
+{
+    int n;
+
+    n = 0;
+
+    while (*p) {
+	n = n + 1;
+	p = p + 1;
+    }
+
+    return n;
+}
+
+int codes(char *p)
+{
+    while (*p) {
+	printf("%d ", *p);
+	p = p + 1;
+    }
+
+    printf("\n");
+}
+
+int main(void)
+{
+    char *s, c;
+
+    s = "tab\there \"quoted\" back\\slash\n";
+    printf("%d %s", length(s), s);
+    codes(s);
+    codes("\\\"\t\n");
+    codes("ends in a backslash\\");
+    c = '"';
+    printf("%c%c%c %d %d\n", c, '\\', '\'', '\t', '\n');
+    printf("%s|%s|\n", "", "%%");
+    return 0;
+}
@@ -0,0 +1,219 @@
+/*
+ * File:	timing.cpp
+ *
+ * Description:	This file contains the timing of the passes over the code
+ *		of each function.  Starting the timer for a function marks
+ *		the time, and stopping it for a pass charges that pass with
+ *		the time since the last mark and marks the time again.  The
+ *		time of each pass is kept both for the current function and
+ *		in total, in the order in which the passes were first run.
+ *
+ *		The clock is only read when passes are being timed, so the
+ *		calls cost nothing otherwise.
+ *
+ *		The passes over a function may run on more than one thread,
+ *		so the mark and the times for the current function belong to
+ *		each thread, and are saved on one and restored on another as
+ *		the function moves between them.  The names and total times
+ *		of the passes are shared, under a lock.  The times of the
+ *		functions in a translation unit may also be added up, so
+ *		that each unit can be reported as a whole.
+ *
+ *		Each report is written as a single line all at once, since
+ *		other threads may be reporting at the same time.
+ */
+
+# include <mutex>
+# include <chrono>
+# include <cstdio>
+# include <sstream>
+# include <vector>
+# include <cstring>
+# include "timing.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Pass {
+    const char *name;
+    double total;
+};
+
+bool timePasses = false;
+
+static thread_local Clock::time_point mark;
+static thread_local vector<double> current;
+static vector<Pass> passes;
+static mutex passLock;
+
+
+/*
+ * Function:	startTiming
+ *
+ * Description:	Start timing the passes over a function.
+ */
+
+void startTiming()
+{
+    if (!timePasses)
+	return;
+
+    current.clear();
+    mark = Clock::now();
+}
+
+
+/*
+ * Function:	stopTiming
+ *
+ * Description:	Charge a pass with the time since the last mark.
+ */
+
+void stopTiming(const char *name)
+{
+    Clock::time_point now;
+    unsigned i;
+
+
+    if (!timePasses)
+	return;
+
+    now = Clock::now();
+    double ms = chrono::duration<double, milli>(now - mark).count();
+    lock_guard<mutex> guard(passLock);
+
+    for (i = 0; i < passes.size(); i ++)
+	if (strcmp(passes[i].name, name) == 0)
+	    break;
+
+    if (i == passes.size())
+	passes.push_back({name, 0});
+
+    if (i >= current.size())
+	current.resize(i + 1);
+
+    current[i] += ms;
+    passes[i].total += ms;
+    mark = now;
+}
+
+
+/*
+ * Function:	saveTiming
+ *
+ * Description:	Save the times of the passes over the current function on
+ *		this thread.
+ */
+
+void saveTiming(vector<double> &times)
+{
+    if (timePasses)
+	times = current;
+}
+
+
+/*
+ * Function:	restoreTiming
+ *
+ * Description:	Continue timing a function on this thread with its saved
+ *		times, marking the time anew.
+ */
+
+void restoreTiming(const vector<double> &times)
+{
+    if (!timePasses)
+	return;
+
+    current = times;
+    mark = Clock::now();
+}
+
+
+/*
+ * Function:	addTiming
+ *
+ * Description:	Add the times of the passes over the current function on
+ *		this thread to the given totals.
+ */
+
+void addTiming(vector<double> &totals)
+{
+    if (!timePasses)
+	return;
+
+    if (totals.size() < current.size())
+	totals.resize(current.size());
+
+    for (unsigned i = 0; i < current.size(); i ++)
+	totals[i] += current[i];
+}
+
+
+/*
+ * Function:	write (private)
+ *
+ * Description:	Write the given label followed by the time of each pass in
+ *		milliseconds, or the total time if no times are given.
+ */
+
+static void write(ostream &ostr, const string &label, const vector<double> *times)
+{
+    lock_guard<mutex> guard(passLock);
+    ostringstream line;
+    char buf[32];
+    double ms;
+
+
+    line << label << ":";
+
+    for (unsigned i = 0; i < passes.size(); i ++) {
+	ms = !times ? passes[i].total : i < times->size() ? (*times)[i] : 0;
+	snprintf(buf, sizeof(buf), "%.3f", ms);
+	line << (i > 0 ? ", " : " ") << passes[i].name << " " << buf;
+    }
+
+    line << " ms\n";
+    ostr << line.str() << flush;
+}
+
+
+/*
+ * Function:	reportTiming
+ *
+ * Description:	Write the time of each pass over the current function on
+ *		this thread to the given stream.
+ */
+
+void reportTiming(ostream &ostr, const string &label)
+{
+    if (timePasses)
+	write(ostr, label, &current);
+}
+
+
+/*
+ * Function:	reportTiming
+ *
+ * Description:	Write the given times of the passes, such as those added up
+ *		over a translation unit, to the given stream.
+ */
+
+void reportTiming(ostream &ostr, const string &label, const vector<double> &times)
+{
+    if (timePasses)
+	write(ostr, label, &times);
+}
+
+
+/*
+ * Function:	timingStatistics
+ *
+ * Description:	Write the total time of each pass over all functions to
+ *		the given stream.
+ */
+
+void timingStatistics(ostream &ostr)
+{
+    write(ostr, "passes", nullptr);
+}
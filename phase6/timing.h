@@ -0,0 +1,27 @@
+/*
+ * File:	timing.h
+ *
+ * Description:	This file contains the function declarations for timing
+ *		the passes over the code of each function, and over each
+ *		translation unit.
+ */
+
+# ifndef TIMING_H
+# define TIMING_H
+# include <string>
+# include <vector>
+# include <ostream>
+
+extern bool timePasses;
+
+void startTiming();
+void stopTiming(const char *pass);
+void saveTiming(std::vector<double> &times);
+void restoreTiming(const std::vector<double> &times);
+void addTiming(std::vector<double> &totals);
+void reportTiming(std::ostream &ostr, const std::string &label);
+void reportTiming(std::ostream &ostr, const std::string &label,
+	const std::vector<double> &times);
+void timingStatistics(std::ostream &ostr);
+
+# endif /* TIMING_H */
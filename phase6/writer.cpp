@@ -44,7 +44,7 @@ static ostream &operator <<(ostream &ostr, const Node *node)
 
 void String::write(ostream &ostr) const
 {
-    ostr << "\"" << escapeString(_value) << "\"";
+    ostr << "\"" << escapeString(_value.str()) << "\"";
 }
 
 void Identifier::write(ostream &ostr) const